@@ -0,0 +1,474 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "framing_bench.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/*
+ * Benchmark comparativo das tres implementacoes do protocolo.
+ * Compilar com:
+ *   gcc -O2 -I ../Protothreads/pt-1.4 bench_framing.c bench_fsm.c \
+ *       bench_fsm_ponteiro.c bench_protothreads.c -o bench_framing
+ * Executar:
+ *   ./bench_framing            # conferencia + benchmark completo, CSV na saida
+ *   ./bench_framing rapido     # menos bytes por medicao
+ *
+ * Cargas de trabalho, para cada tamanho de dados e taxa de erro por byte:
+ *  - encode:    quadros -> bytes na linha
+ *  - decode:    bytes na linha (com bits invertidos) -> quadros
+ *  - roundtrip: encode, erros e decode de um quadro por vez
+ *
+ * Cada medicao repete a carga ate BENCH_BYTES bytes na linha e fica com a
+ * menor de BENCH_REPETICOES execucoes. O fluxo e os erros vem de um gerador
+ * com semente fixa e o processo fica preso a uma CPU, para que duas
+ * execucoes na mesma maquina sejam comparaveis. Nada e impresso durante
+ * a medicao: os resultados vao para uma tabela e sao impressos no fim.
+ *
+ * Saida CSV (linhas com '#' sao comentarios):
+ *   impl,workload,payload,error_rate,frames,frames_ok,wire_bytes,
+ *   ns_per_byte,frames_per_s,instr_per_byte,code_bytes,status
+ * instr_per_byte fica "nan" sem contadores de desempenho (perf_event_open);
+ * code_bytes soma os simbolos do caminho de dados no proprio executavel.
+ */
+
+#define BENCH_BYTES        (1u << 20)
+#define BENCH_BYTES_RAPIDO (1u << 16)
+#define BENCH_REPETICOES   5
+#define QUADRO_MAX         (255 + 4)
+
+static const FramingImpl* const impls[] = {
+    &framing_fsm,
+    &framing_fsm_bloco,
+    &framing_fsm_ponteiro,
+    &framing_protothreads,
+};
+
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+// Tamanho de dados de cada linha; MIX alterna 1..255 quadro a quadro
+#define MIX (-1)
+static const int payloads[] = {0, 1, 8, 32, 64, 128, 255, MIX};
+static const double error_rates[] = {0.0, 0.001, 0.01};
+
+typedef enum {
+    WORK_ENCODE,
+    WORK_DECODE,
+    WORK_ROUNDTRIP
+} Workload;
+
+static const char* const workload_names[] = {"encode", "decode", "roundtrip"};
+
+typedef struct {
+    const FramingImpl* impl;
+    Workload workload;
+    int payload;
+    double error_rate;
+    uint32_t frames;
+    uint32_t frames_ok;
+    size_t wire_bytes;
+    double seconds;
+    double instructions;         // < 0: sem contador
+    const char* status;
+} Result;
+
+/**********************
+ * GERADOR E CARGA
+ **********************/
+static uint32_t semente;
+
+static uint32_t aleatorio32(void) {
+    semente ^= semente << 13;
+    semente ^= semente >> 17;
+    semente ^= semente << 5;
+    return semente;
+}
+
+static uint8_t padrao[QUADRO_MAX + 64];
+
+static inline uint16_t frame_length(int payload, uint32_t frame) {
+    return (payload == MIX) ? (uint16_t)(1 + frame % 255) : (uint16_t)payload;
+}
+
+// Dados do quadro 'frame': janela deslizante sobre o padrao
+static inline const uint8_t* frame_data(uint32_t frame) {
+    return &padrao[frame & 63];
+}
+
+// Bit invertido na linha: posicao no fluxo e mascara
+typedef struct {
+    size_t pos;
+    uint8_t mask;
+} Flip;
+
+static uint8_t* reference;       // fluxo de referencia, gerado por fsm_switch
+static uint8_t* corrupted;
+static uint8_t* scratch;
+static Flip* flips;
+static size_t num_flips;
+
+// Quadros necessarios para BENCH_BYTES na linha, e o fluxo de referencia
+static uint32_t build_reference(int payload, size_t target, size_t* wire) {
+    ByteSink sink = {reference, target + QUADRO_MAX, 0};
+    uint32_t frames = 0;
+
+    framing_fsm.reset();
+    while (sink.length < target) {
+        framing_fsm.encode(frame_data(frames), frame_length(payload, frames), &sink);
+        frames++;
+    }
+    *wire = sink.length;
+    return frames;
+}
+
+static void build_flips(size_t wire, double rate) {
+    uint32_t limite = (uint32_t)(rate * 4294967296.0);
+
+    semente = 0x2545F491u;
+    num_flips = 0;
+    for (size_t pos = 0; rate > 0 && pos < wire; pos++) {
+        if (aleatorio32() < limite) {
+            flips[num_flips].pos = pos;
+            flips[num_flips].mask = (uint8_t)(1u << (aleatorio32() & 7));
+            num_flips++;
+        }
+    }
+
+    memcpy(corrupted, reference, wire);
+    for (size_t i = 0; i < num_flips; i++) {
+        corrupted[flips[i].pos] ^= flips[i].mask;
+    }
+}
+
+/**********************
+ * CONTADORES E TEMPO
+ **********************/
+static int perf_fd = -1;
+
+static void perf_open(void) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static inline uint64_t perf_read(void) {
+    uint64_t count = 0;
+#if defined(__linux__)
+    if (perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+    }
+#endif
+    return count;
+}
+
+static inline double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void pin_cpu(void) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(sched_getcpu() >= 0 ? sched_getcpu() : 0, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+/*
+ * Tamanho de codigo: soma de st_size dos simbolos listados pela
+ * implementacao, lidos da tabela de simbolos do proprio executavel.
+ * Retorna 0 se o executavel nao tem tabela (strip) ou fora do Linux.
+ */
+static size_t code_size(const char* const* symbols) {
+    size_t total = 0;
+#if defined(__linux__)
+    int fd = open("/proc/self/exe", O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        return 0;
+    }
+    const uint8_t* image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return 0;
+    }
+
+    const ElfW(Ehdr)* ehdr = (const ElfW(Ehdr)*)image;
+    const ElfW(Shdr)* shdr = (const ElfW(Shdr)*)(image + ehdr->e_shoff);
+    for (int s = 0; s < ehdr->e_shnum; s++) {
+        if (shdr[s].sh_type != SHT_SYMTAB) {
+            continue;
+        }
+        const ElfW(Sym)* syms = (const ElfW(Sym)*)(image + shdr[s].sh_offset);
+        const char* names = (const char*)(image + shdr[shdr[s].sh_link].sh_offset);
+        size_t count = shdr[s].sh_size / sizeof(ElfW(Sym));
+
+        for (const char* const* name = symbols; *name != NULL; name++) {
+            for (size_t i = 0; i < count; i++) {
+                if (syms[i].st_size > 0 && strcmp(names + syms[i].st_name, *name) == 0) {
+                    total += syms[i].st_size;
+                    break;
+                }
+            }
+        }
+    }
+    munmap((void*)image, (size_t)st.st_size);
+#else
+    (void)symbols;
+#endif
+    return total;
+}
+
+/**********************
+ * CARGAS DE TRABALHO
+ **********************/
+static uint32_t run_encode(const FramingImpl* impl, int payload, uint32_t frames, size_t* wire) {
+    ByteSink sink = {scratch, BENCH_BYTES + QUADRO_MAX, 0};
+    for (uint32_t f = 0; f < frames; f++) {
+        impl->encode(frame_data(f), frame_length(payload, f), &sink);
+    }
+    *wire = sink.length;
+    return frames;
+}
+
+static uint32_t run_decode(const FramingImpl* impl, size_t wire, DecodeStats* stats) {
+    ByteSource source = {corrupted, wire, 0};
+    impl->decode(&source, stats);
+    return stats->frames;
+}
+
+static uint32_t run_roundtrip(const FramingImpl* impl, int payload, uint32_t frames, DecodeStats* stats,
+                              size_t* wire) {
+    uint8_t frame[QUADRO_MAX];
+    size_t pos = 0;
+    size_t flip = 0;
+
+    for (uint32_t f = 0; f < frames; f++) {
+        ByteSink sink = {frame, sizeof(frame), 0};
+        impl->encode(frame_data(f), frame_length(payload, f), &sink);
+
+        // Erros nas mesmas posicoes do fluxo de referencia
+        while (flip < num_flips && flips[flip].pos < pos + sink.length) {
+            frame[flips[flip].pos - pos] ^= flips[flip].mask;
+            flip++;
+        }
+        pos += sink.length;
+
+        ByteSource source = {frame, sink.length, 0};
+        impl->decode(&source, stats);
+    }
+    *wire = pos;
+    return stats->frames;
+}
+
+static void measure(Result* result, uint32_t frames, size_t reference_wire, const DecodeStats* expected) {
+    const FramingImpl* impl = result->impl;
+    double best = 0;
+    double best_instr = -1;
+
+    result->status = "ok";
+    if (!impl->empty_frames && result->payload == 0 && result->workload != WORK_DECODE) {
+        result->status = "sem_suporte";
+        return;
+    }
+
+    // Uma execucao de aquecimento e BENCH_REPETICOES medidas
+    for (int rep = 0; rep <= BENCH_REPETICOES; rep++) {
+        DecodeStats stats = {0, 0, 0};
+        size_t wire = reference_wire;
+
+        impl->reset();
+        uint64_t instr_start = perf_read();
+        double start = now_seconds();
+        switch (result->workload) {
+            case WORK_ENCODE:
+                result->frames_ok = run_encode(impl, result->payload, frames, &wire);
+                break;
+            case WORK_DECODE:
+                result->frames_ok = run_decode(impl, reference_wire, &stats);
+                break;
+            case WORK_ROUNDTRIP:
+                result->frames_ok = run_roundtrip(impl, result->payload, frames, &stats, &wire);
+                break;
+        }
+        double seconds = now_seconds() - start;
+        uint64_t instr = perf_read() - instr_start;
+
+        result->wire_bytes = wire;
+        if (rep > 0 && (best == 0 || seconds < best)) {
+            best = seconds;
+        }
+        if (rep > 0 && perf_fd >= 0 && (best_instr < 0 || instr < best_instr)) {
+            best_instr = (double)instr;
+        }
+
+        // Sem erros, tudo tem que chegar igual
+        if (result->workload == WORK_ENCODE) {
+            if (wire != reference_wire || memcmp(scratch, reference, wire) != 0) {
+                result->status = "erro";
+            }
+        } else if (result->error_rate == 0 &&
+                   (stats.frames != expected->frames || stats.bytes != expected->bytes ||
+                    stats.digest != expected->digest)) {
+            result->status = "erro";
+        }
+    }
+
+    result->frames = frames;
+    result->seconds = best;
+    result->instructions = best_instr;
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+// Todas as implementacoes geram o mesmo fluxo e decodificam o das outras
+static void self_check(void) {
+    static uint8_t streams[NUM_IMPLS][64 * QUADRO_MAX];
+    size_t lengths[NUM_IMPLS];
+
+    for (size_t i = 0; i < NUM_IMPLS; i++) {
+        ByteSink sink = {streams[i], sizeof(streams[i]), 0};
+        impls[i]->reset();
+        for (uint32_t f = 0; f < 64; f++) {
+            uint16_t length = frame_length(MIX, f * 4);
+            impls[i]->encode(frame_data(f), length, &sink);
+        }
+        lengths[i] = sink.length;
+        assert(lengths[i] == lengths[0] && memcmp(streams[i], streams[0], lengths[0]) == 0);
+    }
+
+    for (size_t i = 0; i < NUM_IMPLS; i++) {
+        DecodeStats stats = {0, 0, 0};
+        DecodeStats split = {0, 0, 0};
+        ByteSource whole = {streams[0], lengths[0], 0};
+        impls[i]->reset();
+        impls[i]->decode(&whole, &stats);
+        assert(stats.frames == 64);
+
+        // Em pedacos de 7 bytes o resultado e o mesmo
+        impls[i]->reset();
+        for (size_t pos = 0; pos < lengths[0]; pos += 7) {
+            ByteSource piece = {&streams[0][pos], lengths[0] - pos < 7 ? lengths[0] - pos : 7, 0};
+            impls[i]->decode(&piece, &split);
+        }
+        assert(split.frames == 64 && split.digest == stats.digest);
+    }
+
+    fprintf(stderr, "Conferencia: %zu implementacoes geram e recebem o mesmo fluxo ✓\n", NUM_IMPLS);
+}
+
+/**********************
+ * FUNCIONAMENTO
+ **********************/
+int main(int argc, char** argv) {
+    size_t target = (argc > 1 && strcmp(argv[1], "rapido") == 0) ? BENCH_BYTES_RAPIDO : BENCH_BYTES;
+    size_t num_results = NUM_IMPLS * 3 * (sizeof(payloads) / sizeof(payloads[0])) *
+                         (sizeof(error_rates) / sizeof(error_rates[0]));
+    Result* results = calloc(num_results, sizeof(Result));
+    reference = malloc(BENCH_BYTES + QUADRO_MAX);
+    corrupted = malloc(BENCH_BYTES + QUADRO_MAX);
+    scratch = malloc(BENCH_BYTES + QUADRO_MAX);
+    flips = malloc((BENCH_BYTES + QUADRO_MAX) * sizeof(Flip));
+    assert(results && reference && corrupted && scratch && flips);
+
+    for (size_t i = 0; i < sizeof(padrao); i++) {
+        padrao[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    self_check();
+    pin_cpu();
+    perf_open();
+
+    size_t n = 0;
+    for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++) {
+        size_t wire;
+        uint32_t frames = build_reference(payloads[p], target, &wire);
+
+        // Resultado esperado sem erros, pelo receptor de referencia
+        DecodeStats expected = {0, 0, 0};
+        build_flips(wire, 0);
+        framing_fsm.reset();
+        run_decode(&framing_fsm, wire, &expected);
+        assert(expected.frames == frames);
+
+        for (size_t e = 0; e < sizeof(error_rates) / sizeof(error_rates[0]); e++) {
+            build_flips(wire, error_rates[e]);
+            for (int w = WORK_ENCODE; w <= WORK_ROUNDTRIP; w++) {
+                // Encode nao depende da taxa de erro: so uma vez
+                if (w == WORK_ENCODE && e > 0) {
+                    continue;
+                }
+                for (size_t i = 0; i < NUM_IMPLS; i++) {
+                    Result* result = &results[n++];
+                    result->impl = impls[i];
+                    result->workload = (Workload)w;
+                    result->payload = payloads[p];
+                    result->error_rate = error_rates[e];
+                    measure(result, frames, wire, &expected);
+                }
+            }
+        }
+    }
+
+    printf("# bench_framing: %zu bytes por medicao, menor de %d, compilador %s\n",
+           target, BENCH_REPETICOES, __VERSION__);
+    printf("# contador de instrucoes: %s\n", perf_fd >= 0 ? "perf_event_open" : "indisponivel");
+    printf("impl,workload,payload,error_rate,frames,frames_ok,wire_bytes,"
+           "ns_per_byte,frames_per_s,instr_per_byte,code_bytes,status\n");
+    for (size_t i = 0; i < n; i++) {
+        Result* r = &results[i];
+        char payload[8];
+        if (r->payload == MIX) {
+            snprintf(payload, sizeof(payload), "1-255");
+        } else {
+            snprintf(payload, sizeof(payload), "%d", r->payload);
+        }
+
+        if (strcmp(r->status, "sem_suporte") == 0) {
+            printf("%s,%s,%s,%.3f,0,0,0,nan,nan,nan,%zu,%s\n", r->impl->name,
+                   workload_names[r->workload], payload, r->error_rate,
+                   code_size(r->impl->symbols), r->status);
+            continue;
+        }
+
+        printf("%s,%s,%s,%.3f,%u,%u,%zu,%.3f,%.0f,", r->impl->name, workload_names[r->workload],
+               payload, r->error_rate, r->frames, r->frames_ok, r->wire_bytes,
+               r->seconds * 1e9 / r->wire_bytes, r->frames / r->seconds);
+        if (r->instructions >= 0) {
+            printf("%.2f,", r->instructions / r->wire_bytes);
+        } else {
+            printf("nan,");
+        }
+        printf("%zu,%s\n", code_size(r->impl->symbols), r->status);
+    }
+
+    free(results);
+    free(reference);
+    free(corrupted);
+    free(scratch);
+    free(flips);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Adaptador da FSM com switch (fsm.c) para o benchmark.
+ * O main() original fica renomeado e nao e chamado.
+ */
+#define main fsm_main
+#include "../FSM - switch/fsm.c"
+#undef main
+
+#include "framing_bench.h"
+
+static Protocol bench_tx;
+static Protocol bench_rx;
+
+static void fsm_reset(void) {
+    protocol_init(&bench_tx);
+    protocol_init(&bench_rx);
+    protocol_set_resync(&bench_rx, true);
+}
+
+static void fsm_encode(const uint8_t* data, uint16_t length, ByteSink* out) {
+    uint8_t byte;
+    protocol_tx_begin(&bench_tx, data, length);
+    while (!protocol_tx_byte(&bench_tx, &byte)) {
+        sink_put(out, byte);
+    }
+    sink_put(out, byte);
+}
+
+// Byte a byte, como na interrupcao da UART
+static void fsm_decode(ByteSource* in, DecodeStats* stats) {
+    uint8_t byte;
+    while (source_get(in, &byte)) {
+        if (protocol_rx_byte(&bench_rx, byte)) {
+            decode_stats_add(stats, bench_rx.rx_buffer, bench_rx.rx_received_bytes);
+            protocol_rx_reset(&bench_rx);
+        }
+    }
+}
+
+// Em bloco: memchr na busca do STX e memcpy + verificacao sobre os dados
+static void fsm_decode_bloco(ByteSource* in, DecodeStats* stats) {
+    const uint8_t* span;
+    size_t length;
+    size_t consumed;
+    
+    while ((length = source_span(in, &span)) > 0) {
+        bool done = protocol_rx_buffer(&bench_rx, span, length, &consumed);
+        source_consume(in, consumed);
+        if (done) {
+            decode_stats_add(stats, bench_rx.rx_buffer, bench_rx.rx_received_bytes);
+        }
+    }
+}
+
+static const char* const fsm_symbols[] = {
+    "protocol_init", "protocol_rx_reset", "protocol_rx_fail", "protocol_rx_hunt",
+    "protocol_rx_replay", "protocol_rx_begin_data", "protocol_rx_varint",
+    "protocol_rx_step", "protocol_rx_byte", "protocol_tx_max", "encode_varint",
+    "protocol_tx_begin", "protocol_tx_byte", NULL
+};
+
+static const char* const fsm_bloco_symbols[] = {
+    "protocol_init", "protocol_rx_reset", "protocol_rx_fail", "protocol_rx_hunt",
+    "protocol_rx_replay", "protocol_rx_begin_data", "protocol_rx_varint",
+    "protocol_rx_step", "protocol_rx_buffer", "protocol_tx_max", "encode_varint",
+    "protocol_tx_begin", "protocol_tx_byte", NULL
+};
+
+const FramingImpl framing_fsm = {
+    "fsm_switch", fsm_symbols, true, fsm_reset, fsm_encode, fsm_decode
+};
+
+const FramingImpl framing_fsm_bloco = {
+    "fsm_switch_bloco", fsm_bloco_symbols, true, fsm_reset, fsm_encode, fsm_decode_bloco
+};
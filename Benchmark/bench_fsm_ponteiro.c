@@ -0,0 +1,58 @@
+/*
+ * Adaptador da FSM com tabelas de ponteiros de funcao (fsm_ponteiro.c)
+ * para o benchmark. O main() original fica renomeado e nao e chamado.
+ */
+#define main fsm_ponteiro_main
+#include "../FSM-Ponteiros de Função/fsm_ponteiro.c"
+#undef main
+
+#include "framing_bench.h"
+
+static ChannelBuffers bench_buffers[2];
+static FsmContext bench_tx;
+static FsmContext bench_rx;
+
+static void ponteiro_reset(void) {
+    initContext(&bench_tx, &bench_buffers[0]);
+    initContext(&bench_rx, &bench_buffers[1]);
+    bench_rx.rx_resync = 1;
+}
+
+static void ponteiro_encode(const uint8_t* data, uint16_t length, ByteSink* out) {
+    prepareTxPacket(&bench_tx, data, length);
+    while (bench_tx.tx_state != TX_COMPLETE) {
+        sink_put(out, getTxByte(&bench_tx));
+        advanceTxState(&bench_tx);
+    }
+}
+
+static void ponteiro_decode(ByteSource* in, DecodeStats* stats) {
+    uint8_t byte;
+    while (source_get(in, &byte)) {
+        processRxByte(&bench_rx, byte);
+        // Os bytes reprocessados depois de um erro podem completar mais de um pacote
+        while (bench_rx.rx_state == RX_PACKET_COMPLETE) {
+            decode_stats_add(stats, bench_rx.rx_packet->dados, bench_rx.rx_packet->qtd);
+            resetRx(&bench_rx);
+            if (bench_rx.rx_replayLen > 0) {
+                rx_runReplay(&bench_rx);
+            }
+        }
+    }
+}
+
+static const char* const ponteiro_symbols[] = {
+    "initContext", "resetFSM", "resetRx", "txMax", "encodeVarint",
+    "rx_waitSTX", "rx_beginData", "rx_varintByte", "rx_waitQTD", "rx_waitLEN",
+    "rx_waitMAX", "rx_waitDADOS", "rx_waitCHK", "rx_waitETX", "rx_packetComplete",
+    "rx_errorState", "rx_frameError", "rx_runReplay", "processRxByte",
+    "prepareTxPacket", "tx_idle", "tx_sendSTX", "tx_sendQTD", "tx_sendLEN",
+    "tx_sendDADOS", "tx_sendCHK", "tx_sendETX", "tx_complete", "tx_errorState",
+    "tx_getIdle", "tx_getSTX", "tx_getQTD", "tx_getLEN", "tx_getDADOS",
+    "tx_getCHK", "tx_getETX", "tx_getComplete", "tx_getError",
+    "getTxByte", "advanceTxState", "rx_fsm", "tx_fsm", "tx_byte_funcs", NULL
+};
+
+const FramingImpl framing_fsm_ponteiro = {
+    "fsm_ponteiro", ponteiro_symbols, true, ponteiro_reset, ponteiro_encode, ponteiro_decode
+};
@@ -0,0 +1,74 @@
+/*
+ * Adaptador das protothreads (protothreads.c) para o benchmark, no modo
+ * pare-e-espere original sobre o enlace simulado sem latencia nem erros.
+ * Os nomes que coincidem com fsm.c e o main() original sao renomeados.
+ *
+ *  - encode: a resposta ACK ja fica na fila antes do quadro, para que o
+ *            transmissor nao espere; a linha envia um byte por marca
+ *  - decode: os bytes entram no enlace de dados e as respostas do
+ *            receptor sao descartadas
+ */
+#define main protothreads_main
+#define run_all_tests protothreads_run_all_tests
+#define test_ext_frames protothreads_test_ext_frames
+#define calculate_checksum protothreads_calculate_checksum
+#define encode_varint protothreads_encode_varint
+#include "../Protothreads/protothreads.c"
+#undef main
+
+#include "framing_bench.h"
+
+// Chamadas por ponteiro: as protothreads ficam fora de linha, como no escalonador
+static char (* volatile bench_pt_tx)(struct pt *pt) = protothread_tx;
+static char (* volatile bench_pt_rx)(struct pt *pt) = protothread_rx;
+static DecodeStats* bench_stats;
+
+static void protothreads_entrega(const Packet *pkt) {
+    decode_stats_add(bench_stats, pkt->data, pkt->size);
+}
+
+static void protothreads_reset(void) {
+    simulacao_inicia(0, 0);
+    arq_reinicia(0, ARQ_GO_BACK_N, 0);
+    rx_entrega = protothreads_entrega;
+}
+
+// Quadro sem dados nao existe aqui: tx_packet.size == 0 indica transmissor livre
+static void protothreads_encode(const uint8_t* data, uint16_t length, ByteSink* out) {
+    memcpy(tx_packet.data, data, length);
+    tx_packet.size = length;
+    link_envia(&ack_link, ACK);
+    while (tx_packet.size > 0) {
+        bench_pt_tx(&pt_tx);
+        while (link_disponivel(&data_link)) {
+            sink_put(out, link_recebe(&data_link));
+        }
+        agora++;
+    }
+}
+
+static void protothreads_decode(ByteSource* in, DecodeStats* stats) {
+    uint8_t byte;
+    bench_stats = stats;
+    
+    while (in->pos < in->length || link_disponivel(&data_link)) {
+        while (data_link.head - data_link.tail < LINK_SIZE && source_get(in, &byte)) {
+            link_envia(&data_link, byte);
+        }
+        bench_pt_rx(&pt_rx);
+        agora++;
+        ack_link.tail = ack_link.head;
+    }
+}
+
+static const char* const protothreads_symbols[] = {
+    "protothread_tx", "protothread_rx", "packet_header", "protothreads_calculate_checksum",
+    "protothreads_encode_varint", "announce_checksum", "is_valid_packet_size", "tx_max",
+    "entrega", "aleatorio", "link_pode_enviar", "link_envia", "link_disponivel",
+    "link_recebe", NULL
+};
+
+const FramingImpl framing_protothreads = {
+    "protothreads", protothreads_symbols, false, protothreads_reset, protothreads_encode,
+    protothreads_decode
+};
@@ -0,0 +1,165 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Conferencia e custo do tempo de processador por tarefa do rtos
+ * (cfg_CONTA_TEMPO_CPU): acumulo em TrocaContextoDasTarefas,
+ * EstatisticasTarefas e CargaCPU.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_cpu.c -o bench_rtos_cpu
+ *   gcc -O2 -Dcfg_CONTA_TEMPO_CPU=0 -I ../rtos/as_sam_d21/src bench_rtos_cpu.c -o bench_rtos_cpu_sem
+ * Executar:
+ *   ./bench_rtos_cpu           # conferencia + custo, CSV na saida
+ *   ./bench_rtos_cpu_sem       # so o custo, para comparar
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h;
+ * o contador livre e uma variavel volatil (como o registrador do SysTick),
+ * que a conferencia avanca a mao. A medida alterna duas tarefas a cada
+ * TrocaContextoDasTarefas, o pior caso para o acumulo.
+ */
+
+#define BENCH_TROCAS 200000
+
+#define NUMERO_DE_TAREFAS 4
+
+static volatile uint32_t relogio;
+#define LE_CONTADOR_LIVRE()        relogio
+
+#include "rtos_porta_pc.h"
+
+static void tarefa_vazia(void) {
+}
+
+static uint32_t pilha_a[40];
+static uint32_t pilha_b[40];
+static uint32_t pilha_ociosa[40];
+
+#define TAREFA_A       1
+#define TAREFA_B       2
+#define TAREFA_OCIOSA  3
+
+static void reinicia(void) {
+    ReiniciaMultitarefas();
+    relogio = 0;
+
+    CriaTarefa(tarefa_vazia, "A", pilha_a, 40, 1);
+    CriaTarefa(tarefa_vazia, "B", pilha_b, 40, 2);
+    CriaTarefa(tarefa_vazia, "ociosa", pilha_ociosa, 40, 0);
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+#if cfg_CONTA_TEMPO_CPU
+static void self_check(void) {
+    estatistica_tarefa_t e[NUMERO_DE_TAREFAS];
+
+    reinicia();
+    relogio = 1000;
+    IniciaMultitarefas();
+    assert(tarefa_atual == TAREFA_B && TCB[TAREFA_B].execucoes == 1);
+
+    // B cede depois de 300 ciclos
+    relogio = 1300;
+    TarefaSuspende(TAREFA_B);
+    TrocaContextoDasTarefas();
+    assert(tarefa_atual == TAREFA_A);
+    assert(TCB[TAREFA_B].ciclos == 300 && TCB[TAREFA_B].maior_execucao == 300);
+
+    // PendSV que mantem A: a execucao de A continua
+    relogio = 1400;
+    TrocaContextoDasTarefas();
+    assert(TCB[TAREFA_A].execucoes == 1 && TCB[TAREFA_A].ciclos == 0);
+
+    relogio = 1500;
+    TarefaSuspende(TAREFA_A);
+    TrocaContextoDasTarefas();
+    assert(tarefa_atual == TAREFA_OCIOSA);
+    assert(TCB[TAREFA_A].ciclos == 200 && TCB[TAREFA_A].maior_execucao == 200);
+
+    // A copia inclui a execucao em andamento da ociosa
+    relogio = 2500;
+    assert(EstatisticasTarefas(e, NUMERO_DE_TAREFAS) == 3);
+    assert(strcmp(e[2].nome, "ociosa") == 0 && e[2].prioridade == 0);
+    assert(e[2].ciclos == 1000 && e[2].execucoes == 1 && e[2].maior_execucao == 1000);
+    assert(EstatisticasTarefas(e, 2) == 2);
+
+    // 1000 de 1500 ciclos na ociosa: 33,4 %
+    assert(CargaCPU() == 334);
+
+    // B volta e roda 100 ciclos sem a ociosa: 100 %
+    TarefaContinua(TAREFA_B);
+    TrocaContextoDasTarefas();
+    assert(TCB[TAREFA_OCIOSA].ciclos == 1000 && TCB[TAREFA_B].execucoes == 2);
+    relogio = 2600;
+    assert(CargaCPU() == 1000);
+
+    // O contador livre da a volta
+    relogio = 0xFFFFFF00u;
+    CargaCPU();
+    TarefaSuspende(TAREFA_B);
+    TrocaContextoDasTarefas();
+    relogio = 0x00000100u;
+    assert(CargaCPU() == 0);
+    assert(TCB[TAREFA_B].maior_execucao == 0xFFFFFF00u - 2500);
+
+    printf("# conferencia do tempo de processador OK\n");
+}
+#endif
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+int main(void) {
+#if cfg_CONTA_TEMPO_CPU
+    self_check();
+#endif
+
+    reinicia();
+    IniciaMultitarefas();
+
+    uint64_t menor = UINT64_MAX, soma = 0;
+    for (uint32_t i = 0; i < BENCH_TROCAS; i++) {
+        // alterna A e B: toda troca fecha uma execucao
+        if (tarefa_atual == TAREFA_B) {
+            TarefaSuspende(TAREFA_B);
+        } else {
+            TarefaContinua(TAREFA_B);
+        }
+        relogio += 50;
+
+        uint64_t inicio = agora();
+        TrocaContextoDasTarefas();
+        uint64_t custo = agora() - inicio;
+        soma += custo;
+        menor = custo < menor ? custo : menor;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("cfg_CONTA_TEMPO_CPU,trocas,troca_min_ciclos,troca_media_ciclos\n");
+#else
+    printf("cfg_CONTA_TEMPO_CPU,trocas,troca_min_ns,troca_media_ns\n");
+#endif
+    printf("%d,%u,%llu,%.1f\n", cfg_CONTA_TEMPO_CPU, BENCH_TROCAS, (unsigned long long)menor,
+           (double)soma / BENCH_TROCAS);
+    return 0;
+}
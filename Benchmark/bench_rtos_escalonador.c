@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Benchmark do escalonador do rtos (escalonador(), chamado a cada PendSV)
+ * com 4, 16 e 32 niveis de prioridade.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_escalonador.c -o bench_rtos_escalonador
+ * Executar:
+ *   ./bench_rtos_escalonador   # conferencia + benchmark, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h
+ * com PRIORIDADE_MAXIMA 31. Compara o mapa de bits das prontas com a
+ * varredura antiga, reproduzida em escalonador_varredura(), que percorre de
+ * 'maxima' ate 0 o vetor com a tarefa de cada prioridade (o Prioridades[]
+ * de antes das filas de prontas, aqui prioridades_antigas[]). Cada nivel
+ * tem uma tarefa. Casos:
+ *  - ociosa: so a ociosa pronta (pior caso da varredura)
+ *  - meio:   pronta a tarefa de prioridade maxima/2
+ *  - maxima: pronta a tarefa de maior prioridade (melhor caso)
+ *
+ * Uma chamada custa poucos ciclos, abaixo da resolucao do TSC, entao cada
+ * medida e um lote de BENCH_LOTE chamadas dividido pelo lote; fica a menor
+ * de BENCH_REPETICOES. Sem TSC, o tempo vem em ns.
+ */
+
+#define BENCH_REPETICOES 200
+#define BENCH_LOTE       1000
+#define MAX_PRIORIDADES  32
+
+#define PRIORIDADE_MAXIMA (MAX_PRIORIDADES - 1)
+#define NUMERO_DE_TAREFAS MAX_PRIORIDADES
+#include "rtos_porta_pc.h"
+
+static uint32_t pilhas[MAX_PRIORIDADES][TAM_MINIMO_PILHA];
+static uint8_t prioridades_antigas[MAX_PRIORIDADES];
+
+static void tarefa_vazia(void) {
+}
+
+/* Zera o estado do rtos e cria a ociosa e uma tarefa por prioridade de 1
+   ate 'maxima', todas em espera menos a de prioridade 'pronta' */
+static void reinicia(prioridade_t maxima, prioridade_t pronta) {
+    ReiniciaMultitarefas();
+    memset(prioridades_antigas, 0, sizeof(prioridades_antigas));
+    prioridades_antigas[0] = CriaTarefa(tarefa_vazia, "ociosa", pilhas[0], TAM_MINIMO_PILHA, 0);
+    assert(prioridades_antigas[0] != 0);
+    for (prioridade_t p = 1; p <= maxima; p++) {
+        uint8_t tarefa = CriaTarefa(tarefa_vazia, "t", pilhas[p], TAM_MINIMO_PILHA, p);
+        assert(tarefa != 0);
+        prioridades_antigas[p] = tarefa;
+        if (p != pronta) {
+            tarefa_bloqueada(tarefa);
+        }
+    }
+}
+
+/* Escalonador antigo: procura da prioridade 'maxima' para baixo a primeira
+   tarefa pronta; se nenhuma estiver, escolhe a ociosa */
+static uint8_t escalonador_varredura(prioridade_t maxima) {
+    prioridade_t prioridade;
+    for (prioridade = maxima; prioridade > 0; prioridade--) {
+        uint8_t tarefa = prioridades_antigas[prioridade];
+        if (tarefa != 0 && TCB[tarefa].estado == PRONTA) {
+            return tarefa;
+        }
+    }
+    return prioridades_antigas[0];
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+typedef enum { CASO_OCIOSA, CASO_MEIO, CASO_MAXIMA, NUM_CASOS } Caso;
+static const char* const nomes_casos[NUM_CASOS] = {"ociosa", "meio", "maxima"};
+
+static prioridade_t pronta_do_caso(Caso caso, prioridade_t maxima) {
+    switch (caso) {
+    case CASO_MEIO:   return (prioridade_t)(maxima / 2);
+    case CASO_MAXIMA: return maxima;
+    default:          return 0;
+    }
+}
+
+static volatile uint8_t escolhida;
+
+/* Menor custo medio de uma chamada, em decimos de ciclo (ou de ns) */
+static uint64_t mede(Caso caso, prioridade_t maxima, bool varredura) {
+    uint64_t menor = UINT64_MAX;
+
+    reinicia(maxima, pronta_do_caso(caso, maxima));
+    for (int r = 0; r < BENCH_REPETICOES; r++) {
+        uint64_t inicio = agora();
+        for (int i = 0; i < BENCH_LOTE; i++) {
+            // O mapa e o TCB podem mudar a cada PendSV: nada sai do laco
+            __asm__ volatile("" ::: "memory");
+            escolhida = varredura ? escalonador_varredura(maxima) : escalonador();
+        }
+        uint64_t custo = agora() - inicio;
+
+        if (custo < menor) {
+            menor = custo;
+        }
+    }
+    return menor * 10 / BENCH_LOTE;
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static void self_check(void) {
+    static const prioridade_t maximas[] = {3, 15, 31};
+
+    // O mapa escolhe a mesma tarefa que a varredura com qualquer uma pronta
+    for (size_t m = 0; m < sizeof(maximas) / sizeof(maximas[0]); m++) {
+        for (prioridade_t pronta = 0; pronta <= maximas[m]; pronta++) {
+            reinicia(maximas[m], pronta);
+            uint8_t esperada = prioridades_antigas[pronta];
+            assert(escalonador_varredura(maximas[m]) == esperada);
+            assert(escalonador() == esperada);
+        }
+    }
+
+    // Com varias prontas, ganha a de maior prioridade
+    reinicia(31, 0);
+    tarefa_pronta(prioridades_antigas[7]);
+    tarefa_pronta(prioridades_antigas[20]);
+    assert(escalonador() == prioridades_antigas[20] && escalonador_varredura(31) == prioridades_antigas[20]);
+    tarefa_bloqueada(prioridades_antigas[20]);
+    assert(escalonador() == prioridades_antigas[7] && escalonador_varredura(31) == prioridades_antigas[7]);
+
+    // CriaTarefa recusa prioridade fora do limite e tarefas demais
+    reinicia(31, 0);
+    assert(CriaTarefa(tarefa_vazia, "t", pilhas[0], TAM_MINIMO_PILHA, 1) == 0);
+    ReiniciaMultitarefas();
+    assert(CriaTarefa(tarefa_vazia, "t", pilhas[0], TAM_MINIMO_PILHA, PRIORIDADE_MAXIMA + 1) == 0);
+    assert(CriaTarefa(tarefa_vazia, "t", pilhas[0], TAM_MINIMO_PILHA - 1, 1) == 0);
+    assert(numero_tarefas == 0);
+
+    printf("# conferencia do escalonador OK\n");
+}
+
+int main(void) {
+    static const prioridade_t maximas[] = {3, 15, 31};
+
+    self_check();
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("prioridades,caso,varredura_decimos_ciclo,mapa_decimos_ciclo\n");
+#else
+    printf("prioridades,caso,varredura_decimos_ns,mapa_decimos_ns\n");
+#endif
+    for (size_t i = 0; i < sizeof(maximas) / sizeof(maximas[0]); i++) {
+        for (int caso = 0; caso < NUM_CASOS; caso++) {
+            uint64_t antigo = mede((Caso)caso, maximas[i], true);
+            uint64_t novo = mede((Caso)caso, maximas[i], false);
+            printf("%d,%s,%llu,%llu\n", maximas[i] + 1, nomes_casos[caso],
+                   (unsigned long long)antigo, (unsigned long long)novo);
+        }
+    }
+    return 0;
+}
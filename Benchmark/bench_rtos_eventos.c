@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Simulacao no PC de uma tarefa que espera varias condicoes ("quadro
+ * recebido OU tempo OU desligar") sinalizadas por interrupcoes: com
+ * variaveis consultadas a cada TarefaEspera(periodo) e com um grupo de
+ * eventos (EventosAguarda com EVENTOS_QUALQUER | EVENTOS_LIMPA).
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_eventos.c -o bench_rtos_eventos
+ * Executar:
+ *   ./bench_rtos_eventos       # conferencia + latencia, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido por rtos_porta_pc.h, com o PendSV
+ * feito por swapcontext() (PORTA_PC_TROCA) e o tempo em marcas. As
+ * interrupcoes chegam entre duas marcas em instantes sorteados com semente
+ * fixa. Colunas: latencia media e maxima em marcas (da interrupcao ate a
+ * tarefa tratar o evento) e quantas vezes a tarefa acordou.
+ */
+
+#define MARCAS_SIMULADAS  100000
+#define INTERVALO_MEDIO   40
+
+#define NUMERO_DE_TAREFAS 5
+#define PORTA_PC_TROCA    1
+#include "rtos_porta_pc.h"
+
+/**********************
+ * INTERRUPCOES E TEMPO
+ **********************/
+#define EVENTO_QUADRO    (1UL << 0)
+#define EVENTO_TEMPO     (1UL << 1)
+#define EVENTO_DESLIGA   (1UL << 2)
+#define NUM_FONTES       3
+
+static bool com_eventos;
+static tick_t periodo_consulta;
+static eventos_t grupo;
+static volatile uint32_t pendentes;           // variaveis consultadas pela tarefa
+static uint32_t marca_sinal[NUM_FONTES];
+static uint32_t proxima_interrupcao[NUM_FONTES];
+static uint32_t agora;
+static uint32_t estado_sorteio;
+
+static uint64_t soma_latencia;
+static uint32_t maior_latencia;
+static uint32_t tratados;
+static uint32_t despertares;
+
+static uint32_t sorteia(void) {
+    estado_sorteio ^= estado_sorteio << 13;
+    estado_sorteio ^= estado_sorteio >> 17;
+    estado_sorteio ^= estado_sorteio << 5;
+    return estado_sorteio;
+}
+
+/* Rotina de interrupcao da fonte 'f' */
+static void interrupcao(int f) {
+    marca_sinal[f] = agora;
+    if (com_eventos) {
+        EventosSinalizaISR(&grupo, 1UL << f);
+    } else {
+        pendentes |= 1UL << f;
+    }
+}
+
+/* A ociosa faz o tempo andar; as interrupcoes chegam antes da marca */
+static void ociosa(void) {
+    for (;;) {
+        if (agora == MARCAS_SIMULADAS) {
+            volta();
+        }
+        for (int f = 0; f < NUM_FONTES; f++) {
+            // Sem duas interrupcoes da mesma fonte antes do tratamento
+            if (agora >= proxima_interrupcao[f] && !(pendentes & (1UL << f)) && !(grupo.bits & (1UL << f))) {
+                interrupcao(f);
+                proxima_interrupcao[f] = agora + 1 + sorteia() % (2 * INTERVALO_MEDIO);
+            }
+        }
+        agora++;
+        ExecutaMarcaDeTempo();
+        if (escalonador() != tarefa_atual) {
+            pendsv();
+        }
+    }
+}
+
+static void trata(uint32_t bits) {
+    for (int f = 0; f < NUM_FONTES; f++) {
+        if (bits & (1UL << f)) {
+            uint32_t latencia = agora - marca_sinal[f];
+            soma_latencia += latencia;
+            maior_latencia = latencia > maior_latencia ? latencia : maior_latencia;
+            tratados++;
+        }
+    }
+}
+
+static void tarefa(void) {
+    for (;;) {
+        uint32_t bits;
+        if (com_eventos) {
+            bits = EventosAguarda(&grupo, EVENTO_QUADRO | EVENTO_TEMPO | EVENTO_DESLIGA,
+                                  EVENTOS_QUALQUER | EVENTOS_LIMPA, MARCAS_INFINITAS);
+            bits &= EVENTO_QUADRO | EVENTO_TEMPO | EVENTO_DESLIGA;
+        } else {
+            TarefaEspera(periodo_consulta);
+            bits = pendentes;
+            pendentes = 0;
+        }
+        despertares++;
+        trata(bits);
+    }
+}
+
+typedef struct {
+    double latencia_media;
+    uint32_t latencia_maxima;
+    uint32_t tratados;
+    uint32_t despertares;
+} Resultado;
+
+static Resultado executa(bool eventos, tick_t periodo) {
+    reinicia_pc();
+    com_eventos = eventos;
+    periodo_consulta = periodo;
+    grupo = (eventos_t){0, {0}};
+    pendentes = 0;
+    agora = 0;
+    estado_sorteio = 0x2545F491u;
+    soma_latencia = 0;
+    maior_latencia = tratados = despertares = 0;
+    for (int f = 0; f < NUM_FONTES; f++) {
+        proxima_interrupcao[f] = 1 + sorteia() % (2 * INTERVALO_MEDIO);
+    }
+
+    cria(ociosa, 0);
+    cria(tarefa, 1);
+    inicia();
+    return (Resultado){(double)soma_latencia / tratados, maior_latencia, tratados, despertares};
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static uint8_t acordadas;
+
+static void conferencia_todos(void) {
+    // Espera os dois bits; o bit 0 sozinho nao basta
+    uint32_t r = EventosAguarda(&grupo, 0x3, EVENTOS_TODOS | EVENTOS_LIMPA, MARCAS_INFINITAS);
+    assert((r & 0x3) == 0x3);
+    acordadas++;
+    for (;;) {
+        TarefaSuspende(tarefa_atual);
+    }
+}
+
+static void conferencia_qualquer(void) {
+    uint32_t r = EventosAguarda(&grupo, 0x1, EVENTOS_QUALQUER, MARCAS_INFINITAS);
+    assert(r & 0x1);
+    acordadas++;
+    for (;;) {
+        TarefaSuspende(tarefa_atual);
+    }
+}
+
+static void conferencia_principal(void) {
+    // Sem espera: nada sinalizado; com tempo: desiste depois de 3 marcas
+    assert(EventosAguarda(&grupo, 0x4, EVENTOS_QUALQUER, 0) == 0);
+    tick_t antes = contador_marcas;
+    assert(EventosAguarda(&grupo, 0x4, EVENTOS_QUALQUER, 3) == 0);
+    assert((tick_t)(contador_marcas - antes) == 3);
+
+    // As outras duas ja esperam; o bit 0 acorda so a de qualquer
+    EventosSinalizaISR(&grupo, 0x1);
+    assert(acordadas == 1 && grupo.bits == 0x1);
+
+    // O bit 1 acorda a de todos, que limpa os dois
+    EventosSinalizaISR(&grupo, 0x2);
+    assert(acordadas == 2 && grupo.bits == 0 && grupo.espera.primeira == 0);
+
+    // Ja sinalizado: retorna sem esperar e limpa so o que pediu
+    EventosSinaliza(&grupo, 0x5);
+    assert(EventosAguarda(&grupo, 0x4, EVENTOS_QUALQUER | EVENTOS_LIMPA, 0) == 0x5);
+    assert(grupo.bits == 0x1);
+    EventosLimpa(&grupo, 0x1);
+    assert(grupo.bits == 0);
+    volta();
+}
+
+static void conferencia_ociosa(void) {
+    for (;;) {
+        ExecutaMarcaDeTempo();
+        if (escalonador() != tarefa_atual) {
+            pendsv();
+        }
+    }
+}
+
+static void self_check(void) {
+    reinicia_pc();
+    grupo = (eventos_t){0, {0}};
+    cria(conferencia_ociosa, 0);
+    cria(conferencia_principal, 1);
+    cria(conferencia_todos, 2);
+    cria(conferencia_qualquer, 3);
+    inicia();
+    printf("# conferencia dos grupos de eventos OK\n");
+}
+
+int main(void) {
+    static const tick_t periodos[] = {1, 5, 20};
+
+    self_check();
+
+    printf("espera,latencia_media_marcas,latencia_maxima_marcas,eventos,despertares\n");
+    for (size_t p = 0; p < sizeof(periodos) / sizeof(periodos[0]); p++) {
+        Resultado r = executa(false, periodos[p]);
+        printf("consulta_%u,%.2f,%u,%u,%u\n", periodos[p], r.latencia_media, r.latencia_maxima,
+               r.tratados, r.despertares);
+    }
+    Resultado r = executa(true, 0);
+    printf("eventos,%.2f,%u,%u,%u\n", r.latencia_media, r.latencia_maxima, r.tratados, r.despertares);
+    return 0;
+}
@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+/*
+ * Produtor/consumidor no rtos com mensagens de TAM_MENSAGEM bytes: a fila
+ * montada a mao com dois semaforos (como tarefa_12/tarefa_13 faziam) e a
+ * fila de mensagens do kernel (fila_mensagens_t).
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_fila.c -o bench_rtos_fila
+ * Executar:
+ *   ./bench_rtos_fila          # conferencia + benchmark, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido por rtos_porta_pc.h, com o PendSV
+ * feito por swapcontext() (PORTA_PC_TROCA). Modos:
+ *  - semaforos: Vazio/Cheio + vetor global, mensagem montada na pilha e
+ *               copiada para o vetor; o consumidor copia de volta
+ *  - envia:     FilaEnvia()/FilaRecebe(), uma copia em cada lado
+ *  - reserva:   FilaReserva()/FilaConfirma(): o produtor escreve direto
+ *               na posicao da fila; FilaRecebe()
+ *  - varias:    reserva + FilaRecebeVarias() de ate TAM_FILA mensagens
+ * Colunas: mensagens por segundo, PendSVs e vezes que o consumidor
+ * acordou (chamadas de recepcao que retornaram).
+ */
+
+#define BENCH_MENSAGENS   200000
+#define BENCH_REPETICOES  5
+#define TAM_FILA          8
+#define TAM_MENSAGEM      32
+
+#define NUMERO_DE_TAREFAS 4
+#define PORTA_PC_TROCA    1
+#include "rtos_porta_pc.h"
+
+/* A ociosa faz o tempo andar */
+static void ociosa(void) {
+    for (;;) {
+        ExecutaMarcaDeTempo();
+        pendsv();
+    }
+}
+
+/**********************
+ * PRODUTOR E CONSUMIDOR
+ **********************/
+typedef struct {
+    uint32_t sequencia;
+    uint8_t dados[TAM_MENSAGEM - sizeof(uint32_t)];
+} Mensagem;
+
+typedef enum { MODO_SEMAFOROS, MODO_ENVIA, MODO_RESERVA, MODO_VARIAS, NUM_MODOS } Modo;
+static const char* const nomes_modos[NUM_MODOS] = {"semaforos", "envia", "reserva", "varias"};
+
+static Modo modo;
+static fila_mensagens_t fila;
+static Mensagem memoria_fila[TAM_FILA];
+static semaforo_t cheio;
+static semaforo_t vazio;
+static uint8_t inicio_vetor, fim_vetor;
+static uint32_t recebidas;
+static uint32_t despertares;
+
+static void preenche(Mensagem* m, uint32_t sequencia) {
+    m->sequencia = sequencia;
+    memset(m->dados, (uint8_t)sequencia, sizeof(m->dados));
+}
+
+static void confere(const Mensagem* m) {
+    assert(m->sequencia == recebidas);
+    assert(m->dados[sizeof(m->dados) - 1] == (uint8_t)recebidas);
+    if (++recebidas == BENCH_MENSAGENS) {
+        volta();
+    }
+}
+
+static void produtor(void) {
+    for (uint32_t n = 0;; n++) {
+        if (modo == MODO_SEMAFOROS) {
+            Mensagem m;
+            preenche(&m, n);
+            SemaforoAguarda(&vazio);
+            memoria_fila[fim_vetor] = m;
+            fim_vetor = (uint8_t)((fim_vetor + 1) % TAM_FILA);
+            SemaforoLibera(&cheio);
+        } else if (modo == MODO_ENVIA) {
+            Mensagem m;
+            preenche(&m, n);
+            FilaEnvia(&fila, &m, MARCAS_INFINITAS);
+        } else {
+            Mensagem* m = FilaReserva(&fila, MARCAS_INFINITAS);
+            preenche(m, n);
+            FilaConfirma(&fila);
+        }
+    }
+}
+
+static void consumidor(void) {
+    Mensagem m[TAM_FILA];
+    for (;;) {
+        uint8_t n = 1;
+        if (modo == MODO_SEMAFOROS) {
+            SemaforoAguarda(&cheio);
+            m[0] = memoria_fila[inicio_vetor];
+            inicio_vetor = (uint8_t)((inicio_vetor + 1) % TAM_FILA);
+            SemaforoLibera(&vazio);
+        } else if (modo == MODO_VARIAS) {
+            n = FilaRecebeVarias(&fila, m, TAM_FILA, MARCAS_INFINITAS);
+        } else {
+            FilaRecebe(&fila, &m[0], MARCAS_INFINITAS);
+        }
+        despertares++;
+        for (uint8_t i = 0; i < n; i++) {
+            confere(&m[i]);
+        }
+    }
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+typedef struct {
+    const char* nome;
+    prioridade_t produtor;
+    prioridade_t consumidor;
+} Cenario;
+
+static const Cenario cenarios[] = {
+    {"produtor_alto", 2, 1},
+    {"consumidor_alto", 1, 2},
+    {"iguais", 1, 1},
+};
+
+typedef struct {
+    double mensagens_por_s;
+    uint32_t pendsvs;
+    uint32_t despertares;
+} Resultado;
+
+static Resultado executa(const Cenario* cenario, Modo m) {
+    reinicia_pc();
+    modo = m;
+    recebidas = despertares = 0;
+    inicio_vetor = fim_vetor = 0;
+    cheio = (semaforo_t){0, {0}};
+    vazio = (semaforo_t){TAM_FILA, {0}};
+    FilaInicia(&fila, memoria_fila, sizeof(Mensagem), TAM_FILA);
+
+    cria(ociosa, 0);
+    cria(produtor, cenario->produtor);
+    cria(consumidor, cenario->consumidor);
+
+    struct timespec inicio, fim;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    inicia();
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+
+    double s = (double)(fim.tv_sec - inicio.tv_sec) + (double)(fim.tv_nsec - inicio.tv_nsec) * 1e-9;
+    return (Resultado){BENCH_MENSAGENS / s, pendsvs, despertares};
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static uint8_t memoria_conferencia[3];
+static uint8_t recebido;
+
+static void conferencia_a(void) {
+    uint8_t v = 7;
+
+    // Duas reservas confirmadas na ordem em que foram feitas
+    uint8_t* p1 = FilaReserva(&fila, 0);
+    uint8_t* p2 = FilaReserva(&fila, 0);
+    assert(p1 != 0 && p2 != 0 && p1 != p2);
+    *p2 = 2;
+    *p1 = 1;
+    assert(FilaEnviaISR(&fila, &v) == 0);   // passaria a frente da reserva
+    FilaConfirma(&fila);
+    FilaConfirma(&fila);
+    assert(FilaEnviaISR(&fila, &v) == 1);
+    assert(FilaReserva(&fila, 0) == 0 && FilaEnviaISR(&fila, &v) == 0);   // cheia
+
+    // Cheia: espera 3 marcas e desiste
+    tick_t antes = contador_marcas;
+    assert(FilaEnvia(&fila, &v, 3) == 0);
+    assert((tick_t)(contador_marcas - antes) == 3);
+
+    // B acorda na marca 5 e esvazia a fila; o envio que esperava entra
+    TarefaEspera(1);
+    assert(FilaEnvia(&fila, &v, 5) == 1);
+    assert(recebido == 3);
+    volta();
+}
+
+static void conferencia_b(void) {
+    uint8_t m[3];
+    TarefaEspera(2 + 3);
+    assert(FilaRecebeVarias(&fila, m, 3, 0) == 3);
+    assert(m[0] == 1 && m[1] == 2 && m[2] == 7);
+    recebido = 3;
+
+    // Vazia: espera a proxima mensagem, de A
+    assert(FilaRecebe(&fila, m, MARCAS_INFINITAS) == 1 && m[0] == 7);
+    for (;;) {
+        TarefaSuspende(tarefa_atual);
+    }
+}
+
+static void self_check(void) {
+    reinicia_pc();
+    FilaInicia(&fila, memoria_conferencia, 1, sizeof(memoria_conferencia));
+    cria(ociosa, 0);
+    cria(conferencia_a, 1);
+    cria(conferencia_b, 2);
+    inicia();
+    assert(fila.prontas == 0 && fila.reservadas == 0);
+    assert(fila.espera_envio.primeira == 0);
+    printf("# conferencia da fila de mensagens OK\n");
+}
+
+int main(void) {
+    self_check();
+
+    printf("cenario,modo,mensagens_por_s,pendsv,despertares\n");
+    for (size_t c = 0; c < sizeof(cenarios) / sizeof(cenarios[0]); c++) {
+        for (int m = 0; m < NUM_MODOS; m++) {
+            Resultado melhor = {0};
+            for (int r = 0; r < BENCH_REPETICOES; r++) {
+                Resultado resultado = executa(&cenarios[c], (Modo)m);
+                if (resultado.mensagens_por_s > melhor.mensagens_por_s) {
+                    melhor = resultado;
+                }
+            }
+            printf("%s,%s,%.0f,%u,%u\n", cenarios[c].nome, nomes_modos[m],
+                   melhor.mensagens_por_s, melhor.pendsvs, melhor.despertares);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Simulacao no PC da inversao de prioridade no rtos: tempo de bloqueio
+ * da tarefa de maior prioridade com um semaforo binario como trava (sem
+ * heranca) e com mutex_t (heranca de prioridade transitiva).
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_inversao.c -o bench_rtos_inversao
+ * Executar:
+ *   ./bench_rtos_inversao      # conferencia + pior bloqueio, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido por rtos_porta_pc.h, com o PendSV
+ * feito por swapcontext() (PORTA_PC_TROCA). O tempo anda em marcas:
+ * trabalha(n) gasta n marcas da tarefa atual, chamando
+ * ExecutaMarcaDeTempo() a cada uma e trocando de tarefa (preempcao) se
+ * uma de maior prioridade ficou pronta; com todas bloqueadas, a ociosa
+ * faz o tempo andar.
+ *
+ * Cenarios (prioridades entre parenteses):
+ *  - simples: B(1) tem a trava R1 por 10 marcas; A(4) chega na marca
+ *             'atraso' e pede R1; M(3) chega uma marca depois e gasta 50
+ *  - cadeia:  B(1) tem R1 por 10 marcas; I(2) pega R2 e espera R1;
+ *             A(4) pede R2; M(3) chega uma marca depois de A e gasta 50.
+ *             So com heranca transitiva B sobe para 4 passando por I.
+ * O pior bloqueio de A e o maior de todos os atrasos de 2 a 9 marcas.
+ */
+
+#define TRABALHO_B    10
+#define TRABALHO_I    2
+#define TRABALHO_M    50
+
+#define NUMERO_DE_TAREFAS 5
+#define PORTA_PC_TROCA    1
+#include "rtos_porta_pc.h"
+
+/**********************
+ * TEMPO E TRAVAS
+ **********************/
+static uint32_t agora;
+
+static void marca(void) {
+    agora++;
+    ExecutaMarcaDeTempo();
+    if (escalonador() != tarefa_atual) {
+        pendsv();
+    }
+}
+
+static void trabalha(uint32_t marcas) {
+    while (marcas-- > 0) {
+        marca();
+    }
+}
+
+static bool com_mutex;
+static mutex_t mutexes[2];
+static semaforo_t semaforos[2];
+
+static void trava(int r) {
+    if (com_mutex) {
+        MutexAguarda(&mutexes[r]);
+    } else {
+        SemaforoAguarda(&semaforos[r]);
+    }
+}
+
+static void destrava(int r) {
+    if (com_mutex) {
+        MutexLibera(&mutexes[r]);
+    } else {
+        SemaforoLibera(&semaforos[r]);
+    }
+}
+
+/**********************
+ * TAREFAS
+ **********************/
+static bool cadeia;
+static tick_t atraso;
+static uint32_t bloqueio;
+
+static void para(void) {
+    for (;;) {
+        TarefaSuspende(tarefa_atual);
+    }
+}
+
+static void tarefa_b(void) {
+    trava(0);
+    trabalha(TRABALHO_B);
+    destrava(0);
+    para();
+}
+
+static void tarefa_i(void) {
+    TarefaEspera(1);
+    trava(1);
+    trava(0);
+    trabalha(TRABALHO_I);
+    destrava(0);
+    destrava(1);
+    para();
+}
+
+static void tarefa_m(void) {
+    TarefaEspera(atraso + 1);
+    trabalha(TRABALHO_M);
+    para();
+}
+
+static void tarefa_a(void) {
+    TarefaEspera(atraso);
+    uint32_t pedido = agora;
+    trava(cadeia ? 1 : 0);
+    bloqueio = agora - pedido;
+    destrava(cadeia ? 1 : 0);
+    volta();
+}
+
+static void ociosa(void) {
+    for (;;) {
+        marca();
+    }
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static uint32_t executa(bool mutex, bool em_cadeia, tick_t marcas_atraso) {
+    reinicia_pc();
+    agora = 0;
+    memset(mutexes, 0, sizeof(mutexes));
+    semaforos[0] = semaforos[1] = (semaforo_t){1, {0}};
+    com_mutex = mutex;
+    cadeia = em_cadeia;
+    atraso = marcas_atraso;
+
+    cria(ociosa, 0);
+    cria(tarefa_b, 1);
+    if (cadeia) {
+        cria(tarefa_i, 2);
+    }
+    cria(tarefa_m, 3);
+    cria(tarefa_a, 4);
+
+    inicia();
+    return bloqueio;
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static uint8_t tarefa_c;
+static uint8_t tarefa_d;
+
+static void conferencia_c(void) {
+    // Travamento recursivo; heranca desfeita so quando ninguem mais espera
+    MutexAguarda(&mutexes[0]);
+    MutexAguarda(&mutexes[0]);
+    MutexAguarda(&mutexes[1]);
+    assert(mutexes[0].contagem == 2 && TCB[tarefa_c].mutexes == &mutexes[1]);
+    TarefaEspera(2);                       // E(3) pede R0 e D(2) pede R1
+
+    assert(TCB[tarefa_c].prioridade == 3);
+    MutexLibera(&mutexes[0]);
+    assert(mutexes[0].dono == tarefa_c && TCB[tarefa_c].prioridade == 3);
+    MutexLibera(&mutexes[1]);              // D recebe R1 mas nao passa C
+    assert(mutexes[1].dono == tarefa_d && TCB[tarefa_c].prioridade == 3);
+    MutexLibera(&mutexes[0]);              // E recebe R0 e roda, depois D
+    assert(TCB[tarefa_c].prioridade == 1 && TCB[tarefa_c].mutexes == 0);
+    assert(mutexes[0].dono == 0 && mutexes[1].dono == 0);
+    volta();
+}
+
+static void conferencia_d(void) {
+    TarefaEspera(1);
+    MutexAguarda(&mutexes[1]);
+    assert(mutexes[1].dono == tarefa_atual && TCB[tarefa_atual].mutexes == &mutexes[1]);
+    MutexLibera(&mutexes[1]);
+    para();
+}
+
+static void conferencia_e(void) {
+    TarefaEspera(1);
+    MutexAguarda(&mutexes[0]);
+    assert(mutexes[0].dono == tarefa_atual && mutexes[0].espera.primeira == 0);
+    MutexLibera(&mutexes[0]);
+    para();
+}
+
+static void self_check(void) {
+    reinicia_pc();
+    memset(mutexes, 0, sizeof(mutexes));
+
+    cria(ociosa, 0);
+    tarefa_c = cria(conferencia_c, 1);
+    tarefa_d = cria(conferencia_d, 2);
+    cria(conferencia_e, 3);
+    inicia();
+
+    // A cadeia herda de ponta a ponta
+    assert(executa(true, true, 3) < TRABALHO_B + TRABALHO_I);
+    printf("# conferencia do mutex OK\n");
+}
+
+int main(void) {
+    self_check();
+
+    printf("cenario,trava,pior_bloqueio_marcas,melhor_bloqueio_marcas\n");
+    for (int em_cadeia = 0; em_cadeia <= 1; em_cadeia++) {
+        for (int mutex = 0; mutex <= 1; mutex++) {
+            uint32_t pior = 0, melhor = UINT32_MAX;
+            for (tick_t d = 2; d <= 9; d++) {
+                uint32_t b = executa(mutex, em_cadeia, d);
+                pior = b > pior ? b : pior;
+                melhor = b < melhor ? b : melhor;
+            }
+            printf("%s,%s,%u,%u\n", em_cadeia ? "cadeia" : "simples",
+                   mutex ? "mutex" : "semaforo", pior, melhor);
+        }
+    }
+    return 0;
+}
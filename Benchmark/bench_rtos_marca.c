@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Benchmark da marca de tempo do rtos (ExecutaMarcaDeTempo, chamada pelo
+ * SysTick_Handler) com 8, 32 e 64 tarefas.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_marca.c -o bench_rtos_marca
+ * Executar:
+ *   ./bench_rtos_marca         # conferencia + benchmark, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h,
+ * sem troca de contexto de verdade. Compara a fila de tempo em lista
+ * delta com a varredura antiga de todos os TCBs, reproduzida em
+ * marca_varredura(). Casos:
+ *  - ociosa:   nenhuma tarefa esperando tempo
+ *  - espera:   todas esperando, nenhuma desperta nesta marca
+ *  - desperta: todas despertam na mesma marca (pior caso das duas)
+ *  - insercao: TarefaEspera() que entra no fim da fila (custo que saiu
+ *              da interrupcao e foi para a tarefa)
+ *
+ * Cada chamada e medida com o contador de ciclos do PC (TSC) e fica a
+ * menor de BENCH_REPETICOES, que e o custo do caminho sem ruido de cache
+ * e de interrupcoes do sistema. Sem TSC, o tempo vem em ns.
+ */
+
+#define BENCH_REPETICOES 2000
+#define MAX_TAREFAS      64
+
+#define NUMERO_DE_TAREFAS MAX_TAREFAS
+#include "rtos_porta_pc.h"
+
+static uint32_t pilhas[MAX_TAREFAS][TAM_MINIMO_PILHA];
+
+static void tarefa_vazia(void) {
+}
+
+/* Zera o estado do rtos e cria 'n' tarefas prontas */
+static void reinicia(int n) {
+    ReiniciaMultitarefas();
+    for (int i = 0; i < n; i++) {
+        CriaTarefa(tarefa_vazia, "t", pilhas[i], TAM_MINIMO_PILHA, (prioridade_t)(1 + i % PRIORIDADE_MAXIMA));
+    }
+}
+
+static void espera(uint8_t tarefa, tick_t marcas) {
+    tarefa_atual = tarefa;
+    TarefaEspera(marcas);
+}
+
+/* Marca de tempo antiga: decrementa o tempo de todas as tarefas */
+static tick_t espera_antiga[MAX_TAREFAS + 1];
+
+static void marca_varredura(void) {
+    for (uint8_t tarefa = numero_tarefas; tarefa > 0; tarefa--) {
+        if (espera_antiga[tarefa] > 0) {
+            espera_antiga[tarefa]--;
+            if (espera_antiga[tarefa] == 0) {
+                tarefa_pronta(tarefa);
+            }
+        }
+    }
+}
+
+static void espera_varredura(uint8_t tarefa, tick_t marcas) {
+    espera_antiga[tarefa] = marcas;
+    tarefa_bloqueada(tarefa);
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+typedef enum { CASO_OCIOSA, CASO_ESPERA, CASO_DESPERTA, CASO_INSERCAO, NUM_CASOS } Caso;
+static const char* const nomes_casos[NUM_CASOS] = {"ociosa", "espera", "desperta", "insercao"};
+
+/* Menor custo de uma chamada do caso, com a lista delta ou com a varredura */
+static uint64_t mede(Caso caso, int n, bool varredura) {
+    uint64_t menor = UINT64_MAX;
+
+    for (int r = 0; r < BENCH_REPETICOES; r++) {
+        reinicia(n);
+        memset(espera_antiga, 0, sizeof(espera_antiga));
+
+        // Prepara a fila sem medir
+        int esperando = (caso == CASO_INSERCAO) ? n - 1 : n;
+        if (caso != CASO_OCIOSA) {
+            for (int t = 1; t <= esperando; t++) {
+                tick_t marcas = (caso == CASO_DESPERTA) ? 1 : (tick_t)(1000 + t);
+                if (varredura) {
+                    espera_varredura((uint8_t)t, marcas);
+                } else {
+                    espera((uint8_t)t, marcas);
+                }
+            }
+        }
+
+        uint64_t inicio = agora();
+        if (caso == CASO_INSERCAO) {
+            if (varredura) {
+                espera_varredura((uint8_t)n, 5000);
+            } else {
+                espera((uint8_t)n, 5000);
+            }
+        } else if (varredura) {
+            marca_varredura();
+        } else {
+            ExecutaMarcaDeTempo();
+        }
+        uint64_t custo = agora() - inicio;
+
+        if (custo < menor) {
+            menor = custo;
+        }
+    }
+    return menor;
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static void self_check(void) {
+    // Tempos fora de ordem despertam em ordem, empates na ordem de entrada
+    static const tick_t tempos[6] = {5, 2, 5, 1, 3, 2};
+    static const uint8_t ordem[6] = {4, 2, 6, 5, 1, 3};
+    reinicia(6);
+    for (int t = 1; t <= 6; t++) {
+        espera((uint8_t)t, tempos[t - 1]);
+    }
+    assert(mapa_prontas == 0);
+
+    int despertas = 0;
+    for (tick_t marca = 1; marca <= 5; marca++) {
+        ExecutaMarcaDeTempo();
+        for (int i = 0; i < 6; i++) {
+            bool deve = tempos[ordem[i] - 1] <= marca;
+            assert((TCB[ordem[i]].estado == PRONTA) == deve);
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        despertas += (TCB[ordem[i]].estado == PRONTA);
+    }
+    assert(despertas == 6 && fila_tempo == 0);
+
+    // TarefaContinua tira a tarefa da fila sem mudar quando as outras despertam
+    reinicia(3);
+    espera(1, 4);
+    espera(2, 6);
+    espera(3, 8);
+    TarefaContinua(2);
+    assert(TCB[2].estado == PRONTA && TCB[3].tempo_espera == 4);
+    for (int marca = 1; marca <= 8; marca++) {
+        ExecutaMarcaDeTempo();
+        assert((TCB[1].estado == PRONTA) == (marca >= 4));
+        assert((TCB[3].estado == PRONTA) == (marca >= 8));
+    }
+    assert(fila_tempo == 0);
+
+    printf("# conferencia da fila de tempo OK\n");
+}
+
+int main(void) {
+    static const int tamanhos[] = {8, 32, 64};
+
+    self_check();
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("tarefas,caso,varredura_ciclos,lista_delta_ciclos\n");
+#else
+    printf("tarefas,caso,varredura_ns,lista_delta_ns\n");
+#endif
+    for (size_t i = 0; i < sizeof(tamanhos) / sizeof(tamanhos[0]); i++) {
+        for (int caso = 0; caso < NUM_CASOS; caso++) {
+            uint64_t antigo = mede((Caso)caso, tamanhos[i], true);
+            uint64_t novo = mede((Caso)caso, tamanhos[i], false);
+            printf("%d,%s,%llu,%llu\n", tamanhos[i], nomes_casos[caso],
+                   (unsigned long long)antigo, (unsigned long long)novo);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Conferencia e custo da verificacao de pilhas do rtos (cfg_VERIFICA_PILHA):
+ * pintura em CriaTarefa, TarefaPilhaUsada, RelatorioPilhas e a guarda
+ * conferida em TrocaContextoDasTarefas.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_pilha.c -o bench_rtos_pilha
+ * Executar:
+ *   ./bench_rtos_pilha         # conferencia + custo, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h,
+ * mas CriaContexto escreve as 16 palavras do contexto inicial no topo da
+ * pilha, como a do ARM. ESTOURO_DE_PILHA anota a tarefa em vez de travar.
+ * O custo de TarefaPilhaUsada cresce com a parte livre da pilha (a
+ * varredura vem do fim); a guarda na troca de contexto e uma leitura.
+ */
+
+#define BENCH_REPETICOES 2000
+#define MAX_PALAVRAS     1024
+
+#define NUMERO_DE_TAREFAS 4
+#define PORTA_PC_CRIA_CONTEXTO
+
+static uint8_t estourada;
+#define ESTOURO_DE_PILHA(tarefa)   estourada = (tarefa)
+
+#include "rtos_porta_pc.h"
+
+/* Contexto inicial do Cortex-M0: 16 palavras no topo */
+stackptr_t CriaContexto(tarefa_t endereco_tarefa, stackptr_t ptr_pilha) {
+    for (int r = 0; r < 16; r++) {
+        *(--ptr_pilha) = (uint32_t)(uintptr_t)endereco_tarefa + (uint32_t)r;
+    }
+    return ptr_pilha;
+}
+
+static void tarefa_vazia(void) {
+}
+
+static uint32_t pilha_a[40];
+static uint32_t pilha_b[64];
+static uint32_t pilha_c[100];
+static uint32_t pilha_grande[MAX_PALAVRAS];
+
+static void reinicia(void) {
+    ReiniciaMultitarefas();
+    estourada = 0;
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static void self_check(void) {
+    reinicia();
+    CriaTarefa(tarefa_vazia, "A", pilha_a, 40, 1);
+    CriaTarefa(tarefa_vazia, "B", pilha_b, 64, 2);
+    CriaTarefa(tarefa_vazia, "C", pilha_c, 100, 3);
+
+    // So o contexto inicial usado; o resto pintado
+    assert(TarefaPilhaUsada(1) == 16 && TarefaPilhaUsada(2) == 16 && TarefaPilhaUsada(3) == 16);
+    assert(pilha_b[0] == PADRAO_PILHA && pilha_b[47] == PADRAO_PILHA);
+
+    // B chegou a usar 30 palavras e voltou: o maximo fica
+    pilha_b[64 - 30] = 0;
+    assert(TarefaPilhaUsada(2) == 30);
+
+    // Relatorio na ordem de criacao, limitado ao tamanho do vetor
+    uso_pilha_t relatorio[4];
+    assert(RelatorioPilhas(relatorio, 4) == 3);
+    assert(strcmp(relatorio[1].nome, "B") == 0 && relatorio[1].tamanho == 64 && relatorio[1].maximo_usado == 30);
+    assert(RelatorioPilhas(relatorio, 2) == 2);
+
+    // Guarda intacta: nada acontece; sobrescrita: a tarefa que sai e apontada
+    tarefa_atual = 3;
+    TrocaContextoDasTarefas();
+    assert(estourada == 0);
+    pilha_a[0] = 0;
+    tarefa_atual = 1;
+    TrocaContextoDasTarefas();
+    assert(estourada == 1);
+    assert(TarefaPilhaUsada(1) == 40);
+
+    printf("# conferencia da verificacao de pilhas OK\n");
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+int main(void) {
+    static const uint16_t tamanhos[] = {40, 128, 512, 1024};
+
+    self_check();
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("palavras,pilha_usada_ciclos,troca_contexto_ciclos\n");
+#else
+    printf("palavras,pilha_usada_ns,troca_contexto_ns\n");
+#endif
+    for (size_t i = 0; i < sizeof(tamanhos) / sizeof(tamanhos[0]); i++) {
+        reinicia();
+        CriaTarefa(tarefa_vazia, "t", pilha_grande, tamanhos[i], 1);
+
+        uint64_t menor_usada = UINT64_MAX, menor_troca = UINT64_MAX;
+        for (int r = 0; r < BENCH_REPETICOES; r++) {
+            uint64_t inicio = agora();
+            volatile uint16_t usada = TarefaPilhaUsada(1);
+            uint64_t custo = agora() - inicio;
+            (void)usada;
+            menor_usada = custo < menor_usada ? custo : menor_usada;
+
+            tarefa_atual = 1;
+            inicio = agora();
+            TrocaContextoDasTarefas();
+            custo = agora() - inicio;
+            menor_troca = custo < menor_troca ? custo : menor_troca;
+        }
+        assert(estourada == 0);
+        printf("%u,%llu,%llu\n", tamanhos[i], (unsigned long long)menor_usada, (unsigned long long)menor_troca);
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "../RingBuffer/ring_buffer.h"
+
+/*
+ * Ping-pong produtor/consumidor no rtos (como tarefa_12/tarefa_13) pela
+ * fila circular SPSC, com os semaforos Cheio/Vazio.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_pingpong.c -o bench_rtos_pingpong
+ * Executar:
+ *   ./bench_rtos_pingpong      # CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido por rtos_porta_pc.h, com o PendSV
+ * feito por swapcontext() (PORTA_PC_TROCA): cada troca pedida salva e
+ * restaura o contexto, mesmo quando o escalonador escolhe a mesma tarefa,
+ * como no Cortex-M. Compara:
+ *  - sempre:    SemaforoLibera() seguido de troca incondicional (o
+ *               comportamento antigo, reproduzido em libera())
+ *  - seletiva:  troca so quando a tarefa acordada passa a atual
+ *
+ * O swapcontext() do PC custa bem mais que o PendSV (chama o sistema
+ * para a mascara de sinais), entao a diferenca absoluta e maior que no
+ * Cortex-M0; a contagem de trocas e a mesma.
+ */
+
+#define BENCH_ITENS       200000
+#define BENCH_REPETICOES  5
+#define TAM_FILA          8
+
+#define NUMERO_DE_TAREFAS 3
+#define cfg_CONTA_TROCAS  1
+#define PORTA_PC_TROCA    1
+#include "rtos_porta_pc.h"
+
+/**********************
+ * PRODUTOR E CONSUMIDOR
+ **********************/
+static RingBuffer fila;
+static uint8_t memoria_fila[TAM_FILA];
+static semaforo_t cheio;
+static semaforo_t vazio;
+static bool troca_sempre;
+static uint32_t recebidos;
+
+static void libera(semaforo_t* sem) {
+    uint32_t antes = trocas_necessarias;
+    SemaforoLibera(sem);
+    if (troca_sempre && trocas_necessarias == antes) {
+        pendsv();
+    }
+}
+
+static void produtor(void) {
+    uint8_t valor = 0;
+    for (;;) {
+        SemaforoAguarda(&vazio);
+        assert(ring_push(&fila, valor++));
+        libera(&cheio);
+    }
+}
+
+static void consumidor(void) {
+    uint8_t esperado = 0;
+    for (;;) {
+        uint8_t valor;
+        SemaforoAguarda(&cheio);
+        assert(ring_pop(&fila, &valor) && valor == esperado);
+        esperado++;
+        libera(&vazio);
+
+        if (++recebidos == BENCH_ITENS) {
+            volta();
+        }
+    }
+}
+
+static void ociosa(void) {
+    for (;;) {
+        pendsv();
+    }
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+typedef struct {
+    const char* nome;
+    prioridade_t produtor;
+    prioridade_t consumidor;
+} Cenario;
+
+static const Cenario cenarios[] = {
+    {"produtor_alto", 2, 1},
+    {"consumidor_alto", 1, 2},
+    {"iguais", 1, 1},
+};
+
+typedef struct {
+    double itens_por_s;
+    uint32_t pendsvs;
+    uint32_t pedidas;
+    uint32_t necessarias;
+} Resultado;
+
+static Resultado executa(const Cenario* cenario, bool sempre) {
+    reinicia_pc();
+    recebidos = 0;
+    troca_sempre = sempre;
+
+    ring_init(&fila, memoria_fila, sizeof(memoria_fila));
+    cheio = (semaforo_t){0, {0}};
+    vazio = (semaforo_t){TAM_FILA, {0}};
+
+    cria(ociosa, 0);
+    cria(produtor, cenario->produtor);
+    cria(consumidor, cenario->consumidor);
+
+    struct timespec inicio, fim;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    inicia();
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+
+    double s = (double)(fim.tv_sec - inicio.tv_sec) + (double)(fim.tv_nsec - inicio.tv_nsec) * 1e-9;
+    return (Resultado){BENCH_ITENS / s, pendsvs, trocas_pedidas, trocas_necessarias};
+}
+
+int main(void) {
+    printf("cenario,trocas,itens_por_s,pendsv,pedidas,necessarias\n");
+    for (size_t c = 0; c < sizeof(cenarios) / sizeof(cenarios[0]); c++) {
+        for (int sempre = 1; sempre >= 0; sempre--) {
+            Resultado melhor = {0};
+            for (int r = 0; r < BENCH_REPETICOES; r++) {
+                Resultado resultado = executa(&cenarios[c], sempre);
+                if (resultado.itens_por_s > melhor.itens_por_s) {
+                    melhor = resultado;
+                }
+            }
+            printf("%s,%s,%.0f,%u,%u,%u\n", cenarios[c].nome, sempre ? "sempre" : "seletiva",
+                   melhor.itens_por_s, melhor.pendsvs, melhor.pedidas, melhor.necessarias);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Benchmark dos pools de blocos de tamanho fixo do rtos (pool_t) contra
+ * malloc/free, com quadros de TAM_QUADRO bytes emprestados e devolvidos em
+ * ordem sorteada.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_pool.c -o bench_rtos_pool
+ * Executar:
+ *   ./bench_rtos_pool          # conferencia + benchmark, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h.
+ * Cada chamada e medida com o TSC (sem TSC, em ns); a saida tem a media e
+ * os percentis 50, 99 e 99.9 de cada operacao. O malloc e o da glibc, nao
+ * o da newlib do ARM, e os outros pedidos de tamanhos variados (PEDIDOS_
+ * VARIADOS) fragmentam o heap como fariam as outras tarefas. O pool faz
+ * sempre o mesmo caminho; a diferenca que importa e a cauda, nao a media.
+ */
+
+#define BENCH_OPERACOES   200000
+#define TAM_QUADRO        128
+#define NUM_QUADROS       32
+#define PEDIDOS_VARIADOS  64
+
+#define NUMERO_DE_TAREFAS 3
+#include "rtos_porta_pc.h"
+
+static POOL_AREA(area_quadros, TAM_QUADRO, NUM_QUADROS);
+static pool_t quadros;
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static void self_check(void) {
+    static POOL_AREA(area, 5, 3);
+    static pool_t pool;
+    void* b[4];
+
+    // Tamanho arredondado para ponteiros; blocos em ordem e alinhados
+    PoolCria(&pool, area, 5, 3);
+    assert(pool.tamanho == POOL_PALAVRAS(5) * sizeof(void*));
+    for (int i = 0; i < 3; i++) {
+        b[i] = PoolAloca(&pool, 0);
+        assert(b[i] == (uint8_t*)area + i * pool.tamanho);
+        assert(((uintptr_t)b[i] % sizeof(void*)) == 0);
+    }
+
+    // Vazio: sem espera retorna 0 e conta a falha
+    assert(PoolAloca(&pool, 0) == 0 && PoolAlocaISR(&pool) == 0);
+    assert(pool.falhas == 2 && pool.livres == 0 && pool.minimo_livres == 0);
+
+    // O ultimo devolvido e o proximo emprestado; a marca d'agua fica
+    PoolLibera(&pool, b[1]);
+    PoolLiberaISR(&pool, b[0]);
+    assert(pool.livres == 2 && pool.minimo_livres == 0);
+    assert(PoolAlocaISR(&pool) == b[0] && PoolAloca(&pool, 0) == b[1]);
+
+    // Quadro emprestado na interrupcao e passado por ponteiro na fila
+    static void* memoria_fila[2];
+    static fila_mensagens_t fila;
+    FilaInicia(&fila, memoria_fila, sizeof(void*), 2);
+    PoolCria(&quadros, area_quadros, TAM_QUADRO, NUM_QUADROS);
+    uint8_t* quadro = PoolAlocaISR(&quadros);
+    memset(quadro, 0xA5, TAM_QUADRO);
+    assert(FilaEnviaISR(&fila, &quadro));
+
+    uint8_t* recebido = 0;
+    assert(FilaRecebe(&fila, &recebido, 0) == 1 && recebido == quadro);
+    assert(recebido[TAM_QUADRO - 1] == 0xA5);
+    PoolLibera(&quadros, recebido);
+    assert(quadros.livres == NUM_QUADROS && quadros.minimo_livres == NUM_QUADROS - 1);
+
+    printf("# conferencia do pool OK\n");
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint32_t estado_sorteio;
+
+static uint32_t sorteia(void) {
+    estado_sorteio ^= estado_sorteio << 13;
+    estado_sorteio ^= estado_sorteio >> 17;
+    estado_sorteio ^= estado_sorteio << 5;
+    return estado_sorteio;
+}
+
+static int compara(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double media;
+    uint64_t p50, p99, p999;
+} Estatistica;
+
+static Estatistica estatistica(uint64_t* custos, uint32_t n) {
+    double soma = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        soma += (double)custos[i];
+    }
+    qsort(custos, n, sizeof(uint64_t), compara);
+    return (Estatistica){soma / n, custos[n / 2], custos[(uint64_t)n * 99 / 100], custos[(uint64_t)n * 999 / 1000]};
+}
+
+static uint64_t custos_aloca[BENCH_OPERACOES];
+static uint64_t custos_libera[BENCH_OPERACOES];
+
+/* Empresta e devolve quadros em ordem sorteada, com ate NUM_QUADROS ao
+   mesmo tempo; com malloc, pedidos de outros tamanhos no meio */
+static void executa(bool com_pool, Estatistica* aloca, Estatistica* libera) {
+    void* emprestados[NUM_QUADROS];
+    void* variados[PEDIDOS_VARIADOS] = {0};
+    uint32_t n_emprestados = 0, n_aloca = 0, n_libera = 0;
+
+    estado_sorteio = 0x2545F491u;
+    PoolCria(&quadros, area_quadros, TAM_QUADRO, NUM_QUADROS);
+
+    for (uint32_t op = 0; op < BENCH_OPERACOES; op++) {
+        bool empresta = n_emprestados == 0 || (n_emprestados < NUM_QUADROS && (sorteia() & 1));
+        if (empresta) {
+            uint64_t inicio = agora();
+            void* q = com_pool ? PoolAloca(&quadros, 0) : malloc(TAM_QUADRO);
+            custos_aloca[n_aloca++] = agora() - inicio;
+            assert(q != 0);
+            ((uint8_t*)q)[0] = (uint8_t)op;
+            emprestados[n_emprestados++] = q;
+        } else {
+            uint32_t i = sorteia() % n_emprestados;
+            void* q = emprestados[i];
+            emprestados[i] = emprestados[--n_emprestados];
+            uint64_t inicio = agora();
+            if (com_pool) {
+                PoolLibera(&quadros, q);
+            } else {
+                free(q);
+            }
+            custos_libera[n_libera++] = agora() - inicio;
+        }
+        if (!com_pool) {
+            uint32_t v = sorteia() % PEDIDOS_VARIADOS;
+            free(variados[v]);
+            variados[v] = malloc(16 + sorteia() % 512);
+        }
+    }
+
+    while (n_emprestados > 0) {
+        void* q = emprestados[--n_emprestados];
+        if (com_pool) {
+            PoolLibera(&quadros, q);
+        } else {
+            free(q);
+        }
+    }
+    for (int v = 0; v < PEDIDOS_VARIADOS; v++) {
+        free(variados[v]);
+    }
+    if (com_pool) {
+        assert(quadros.livres == NUM_QUADROS && quadros.falhas == 0);
+    }
+
+    *aloca = estatistica(custos_aloca, n_aloca);
+    *libera = estatistica(custos_libera, n_libera);
+}
+
+int main(void) {
+    self_check();
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("alocador,operacao,media_ciclos,p50_ciclos,p99_ciclos,p999_ciclos\n");
+#else
+    printf("alocador,operacao,media_ns,p50_ns,p99_ns,p999_ns\n");
+#endif
+    for (int com_pool = 0; com_pool <= 1; com_pool++) {
+        Estatistica aloca, libera;
+        executa(com_pool, &aloca, &libera);
+        const char* nome = com_pool ? "pool" : "malloc";
+        printf("%s,aloca,%.1f,%llu,%llu,%llu\n", nome, aloca.media, (unsigned long long)aloca.p50,
+               (unsigned long long)aloca.p99, (unsigned long long)aloca.p999);
+        printf("%s,libera,%.1f,%llu,%llu,%llu\n", nome, libera.media, (unsigned long long)libera.p50,
+               (unsigned long long)libera.p99, (unsigned long long)libera.p999);
+    }
+    printf("# pool: minimo de livres %u de %u (maximo emprestado %u)\n", quadros.minimo_livres,
+           quadros.quantidade, quadros.quantidade - quadros.minimo_livres);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <asf.h>
+#include "rtos.h"
+
+/*
+ * Micro benchmarks do escalonador com a porta POSIX do rtos (rtos/posix):
+ * o rtos.c do as_sam_d21 sem alteracoes, com a marca de tempo de 1 ms
+ * gerada por SIGALRM durante toda a medida.
+ * Compilar com:
+ *   gcc -O2 -Wall -DNUMERO_DE_TAREFAS=3 -I ../rtos/posix -I ../rtos/as_sam_d21/src \
+ *       bench_rtos_posix.c ../rtos/as_sam_d21/src/rtos.c ../rtos/posix/cpu-port.c -o bench_rtos_posix
+ * Executar:
+ *   ./bench_rtos_posix         # CSV na saida
+ *
+ * Medidas (A com prioridade 1, B com prioridade 2):
+ *  - continua:  A faz TarefaContinua(B), B faz TarefaSuspende(B); duas
+ *               trocas de contexto por volta
+ *  - semaforo:  ping-pong com dois semaforos; a ida e volta tem duas
+ *               trocas e quatro chamadas de semaforo
+ *  - espera_1:  intervalo real entre os retornos de TarefaEspera(1) na
+ *               tarefa A, que deveria ser uma marca (1 ms)
+ *  - cpu:       EstatisticasTarefas e CargaCPU no fim (contador livre em ns)
+ *
+ * A troca de contexto no PC e um swapcontext(), que chama o sistema para
+ * a mascara de sinais; os numeros medem o kernel mais essa troca, e nao
+ * estimam o tempo no Cortex-M0.
+ */
+
+#define BENCH_VOLTAS    200000
+#define BENCH_ESPERAS   500
+#define TAM_PILHA       (TAM_MINIMO_PILHA + 24)
+
+static uint32_t pilha_a[TAM_PILHA];
+static uint32_t pilha_b[TAM_PILHA];
+static uint32_t pilha_ociosa[TAM_PILHA];
+
+#define TAREFA_A  1
+#define TAREFA_B  2
+
+static semaforo_t ping = {0, {0}};
+static semaforo_t pong = {0, {0}};
+static volatile bool com_semaforo = false;
+
+static uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void resultado(const char* medida, uint64_t ns, uint32_t voltas, uint32_t trocas_por_volta) {
+    double ns_volta = (double)ns / voltas;
+    printf("%s,%u,%.0f,%.0f\n", medida, voltas, ns_volta, 1e9 * trocas_por_volta / ns_volta);
+}
+
+static void tarefa_a(void) {
+    // TarefaContinua/TarefaSuspende
+    uint64_t inicio = agora_ns();
+    for (uint32_t i = 0; i < BENCH_VOLTAS; i++) {
+        TarefaContinua(TAREFA_B);
+    }
+    resultado("continua", agora_ns() - inicio, BENCH_VOLTAS, 2);
+
+    // Ping-pong com semaforos: B passa a esperar ping
+    com_semaforo = true;
+    TarefaContinua(TAREFA_B);
+    inicio = agora_ns();
+    for (uint32_t i = 0; i < BENCH_VOLTAS; i++) {
+        SemaforoLibera(&ping);
+        SemaforoAguarda(&pong);
+    }
+    resultado("semaforo", agora_ns() - inicio, BENCH_VOLTAS, 2);
+
+    // Despertar pela marca de tempo
+    uint64_t soma = 0, maior = 0, anterior;
+    TarefaEspera(1);
+    anterior = agora_ns();
+    for (uint32_t i = 0; i < BENCH_ESPERAS; i++) {
+        TarefaEspera(1);
+        uint64_t t = agora_ns();
+        soma += t - anterior;
+        maior = (t - anterior > maior) ? t - anterior : maior;
+        anterior = t;
+    }
+    printf("# espera_1: intervalo medio %.0f ns, maior %llu ns (marca de %lu ns)\n",
+           (double)soma / BENCH_ESPERAS, (unsigned long long)maior, PERIODO_CONTADOR_CICLOS());
+
+    // Tempo de processador: a espera acima deixou a ociosa com quase tudo
+    estatistica_tarefa_t estatisticas[NUMERO_DE_TAREFAS];
+    uint16_t carga = CargaCPU();
+    uint8_t n = EstatisticasTarefas(estatisticas, NUMERO_DE_TAREFAS);
+    printf("# carga desde o inicio %u.%u %%\n", carga / 10, carga % 10);
+    for (uint8_t t = 0; t < n; t++) {
+        printf("# cpu %s: %llu ns, %u execucoes, maior %u ns\n", estatisticas[t].nome,
+               (unsigned long long)estatisticas[t].ciclos, estatisticas[t].execucoes,
+               estatisticas[t].maior_execucao);
+    }
+
+    PortaEncerra();
+}
+
+static void tarefa_b(void) {
+    for (;;) {
+        if (com_semaforo) {
+            SemaforoAguarda(&ping);
+            SemaforoLibera(&pong);
+        } else {
+            TarefaSuspende(TAREFA_B);
+        }
+    }
+}
+
+int main(void) {
+    CriaTarefa(tarefa_a, "A", pilha_a, TAM_PILHA, 1);
+    CriaTarefa(tarefa_b, "B", pilha_b, TAM_PILHA, 2);
+    CriaTarefa(tarefa_ociosa, "ociosa", pilha_ociosa, TAM_PILHA, 0);
+
+    printf("medida,voltas,ns_por_volta,trocas_por_s\n");
+    ConfiguraMarcaTempo();
+    IniciaMultitarefas();
+    return 0;
+}
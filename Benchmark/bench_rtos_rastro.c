@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Conferencia e custo do rastro binario do kernel (cfg_RASTRO): registros
+ * gravados pelas trocas de contexto, tarefas prontas/bloqueadas, semaforos
+ * e marcas de tempo, e a volta do anel.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_rastro.c -o bench_rtos_rastro
+ * Executar:
+ *   ./bench_rtos_rastro                # conferencia + custo, CSV na saida
+ *   ./bench_rtos_rastro rastro.bin     # grava tambem o anel de um cenario de exemplo
+ *   ../rtos/ferramentas/rastro_json rastro.bin > rastro.json
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h;
+ * o contador livre e uma variavel que o teste avanca (1 ciclo = 1 us com a
+ * FREQUENCIA_CONTADOR_LIVRE abaixo). O custo medido e o de RastroRegistra,
+ * chamado em cada ponto instrumentado.
+ */
+
+#define BENCH_REGISTROS 200000
+
+#define NUMERO_DE_TAREFAS 4
+#define FREQUENCIA_CONTADOR_LIVRE  1000000UL
+
+static volatile uint32_t relogio;
+#define LE_CONTADOR_LIVRE()        relogio
+
+#define cfg_RASTRO            1
+#define cfg_RASTRO_REGISTROS  64
+
+#include "rtos_porta_pc.h"
+
+static void tarefa_vazia(void) {
+}
+
+static uint32_t pilha_a[40];
+static uint32_t pilha_b[40];
+static uint32_t pilha_ociosa[40];
+static semaforo_t sinal = {0, {0}};
+
+#define TAREFA_A       1
+#define TAREFA_B       2
+#define TAREFA_OCIOSA  3
+
+static void reinicia(void) {
+    ReiniciaMultitarefas();
+    relogio = 0;
+    sinal.contador = 0;
+
+    CriaTarefa(tarefa_vazia, "A", pilha_a, 40, 1);
+    CriaTarefa(tarefa_vazia, "B", pilha_b, 40, 2);
+    CriaTarefa(tarefa_vazia, "ociosa", pilha_ociosa, 40, 0);
+    IniciaMultitarefas();
+}
+
+/* o PendSV que a porta faria depois de cada chamada */
+static void pendsv(uint32_t ciclos) {
+    relogio += ciclos;
+    TrocaContextoDasTarefas();
+}
+
+/* interrupcao do SysTick, como em cpu-port.c */
+static void systick(uint32_t ciclos) {
+    relogio += ciclos;
+    RASTRO_ISR_ENTRA(EXCECAO_SYSTICK);
+    ExecutaMarcaDeTempo();
+    RASTRO_ISR_SAI(EXCECAO_SYSTICK);
+}
+
+/* B espera o semaforo, A o libera, B volta; a ociosa roda quando os dois dormem */
+static void cenario(uint32_t voltas) {
+    for (uint32_t v = 0; v < voltas; v++) {
+        SemaforoAguarda(&sinal);                 // B bloqueia
+        pendsv(120);                             // -> A
+        systick(300);
+        SemaforoLibera(&sinal);                  // B pronta, preempta A
+        pendsv(40);                              // -> B
+        TarefaEspera(2);                         // B dorme
+        pendsv(80);                              // -> A
+        TarefaSuspende(TAREFA_A);
+        pendsv(60);                              // -> ociosa
+        systick(400);
+        systick(1000);                           // B acorda
+        pendsv(5);                               // -> B
+        TarefaContinua(TAREFA_A);
+    }
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static const rastro_registro_t* registro(uint32_t i) {
+    return &rastro.anel[i & (cfg_RASTRO_REGISTROS - 1)];
+}
+
+static void self_check(void) {
+    reinicia();
+    assert(rastro.marcador == RASTRO_MARCADOR && rastro.registros == 64);
+    assert(strcmp(rastro.nomes[TAREFA_OCIOSA], "ociosa") == 0);
+
+    // CriaTarefa deixou as tres prontas
+    assert(rastro.escritos == 3);
+    assert(registro(0)->evento == RASTRO_EV_PRONTA && registro(0)->tarefa == TAREFA_A);
+    assert(tarefa_atual == TAREFA_B);
+
+    // B espera o semaforo: pedido, bloqueio; a troca registra quem entra e quem sai
+    relogio = 100;
+    SemaforoAguarda(&sinal);
+    assert(rastro.escritos == 5);
+    assert(registro(3)->evento == RASTRO_EV_SEM_AGUARDA && registro(3)->tarefa == TAREFA_B &&
+           registro(3)->dado == (uint16_t)(uintptr_t)&sinal && registro(3)->delta == 100);
+    assert(registro(4)->evento == RASTRO_EV_BLOQUEIA && registro(4)->tarefa == TAREFA_B);
+    pendsv(25);
+    assert(rastro.escritos == 6);
+    assert(registro(5)->evento == RASTRO_EV_TROCA && registro(5)->tarefa == TAREFA_A &&
+           registro(5)->dado == TAREFA_B && registro(5)->delta == 25);
+
+    // PendSV sem troca nao grava nada
+    pendsv(10);
+    assert(rastro.escritos == 6);
+
+    // marca de tempo dentro da interrupcao
+    systick(5);
+    assert(rastro.escritos == 9);
+    assert(registro(6)->evento == RASTRO_EV_ISR_ENTRA && registro(6)->dado == EXCECAO_SYSTICK);
+    assert(registro(7)->evento == RASTRO_EV_MARCA && registro(7)->dado == 1);
+    assert(registro(8)->evento == RASTRO_EV_ISR_SAI);
+
+    // liberacao numa interrupcao aparece com a tarefa 0
+    SemaforoLiberaISR(&sinal);
+    assert(registro(9)->evento == RASTRO_EV_SEM_LIBERA && registro(9)->tarefa == 0);
+    assert(registro(10)->evento == RASTRO_EV_PRONTA && registro(10)->tarefa == TAREFA_B);
+
+    // o anel da a volta: o mais novo sobrescreve o mais antigo
+    cenario(10);
+    assert(rastro.escritos > cfg_RASTRO_REGISTROS);
+    assert(registro(rastro.escritos - 1)->evento == RASTRO_EV_PRONTA &&
+           registro(rastro.escritos - 1)->tarefa == TAREFA_A);
+
+    printf("# conferencia do rastro OK\n");
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+int main(int argc, char** argv) {
+    self_check();
+
+    uint64_t inicio = agora();
+    for (uint32_t i = 0; i < BENCH_REGISTROS; i++) {
+        relogio = i;
+        RastroRegistra(RASTRO_EV_MARCA, 1, (uint16_t)i);
+    }
+    uint64_t custo = agora() - inicio;
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("registros,ciclos_por_registro\n");
+#else
+    printf("registros,ns_por_registro\n");
+#endif
+    printf("%u,%.1f\n", BENCH_REGISTROS, (double)custo / BENCH_REGISTROS);
+
+    if (argc > 1) {
+        reinicia();
+        cenario(4);
+        FILE* arquivo = fopen(argv[1], "wb");
+        assert(arquivo != NULL);
+        fwrite(&rastro, sizeof(rastro), 1, arquivo);
+        fclose(arquivo);
+        printf("# rastro gravado em %s (%u registros)\n", argv[1], rastro.escritos);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Conferencia da base de tempo de 64 bits do rtos: MarcasDeTempo na volta
+ * dos 32 bits baixos, TarefaEsperaAte (inclusive alem de um tick_t),
+ * TarefaPeriodica sem deriva e InstanteEmCiclos com a marca pendente; e o
+ * custo das leituras.
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_tempo.c -o bench_rtos_tempo
+ * Executar:
+ *   ./bench_rtos_tempo         # conferencia + medidas, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h,
+ * mas TrocaContexto() simula a tarefa bloqueada: avanca as marcas (com
+ * CompensaMarcasDeTempo para os saltos grandes) ate ela ficar pronta, ou
+ * ate a marca continua_em, em que uma interrupcao chama TarefaContinua. O
+ * SysTick e as variaveis valor_systick e marca_pendente.
+ * A deriva compara uma tarefa que trabalha TRABALHO marcas por periodo com
+ * TarefaEspera(PERIODO) e com TarefaPeriodica(&proxima, PERIODO).
+ */
+
+#define BENCH_LEITURAS 200000
+#define PERIODO        10
+#define TRABALHO       3
+#define ATIVACOES      1000
+
+#define NUMERO_DE_TAREFAS 4
+
+static volatile uint32_t valor_systick;
+static volatile int marca_pendente;
+#define LE_CONTADOR_CICLOS()       valor_systick
+#define PERIODO_CONTADOR_CICLOS()  48000
+#define MARCA_PENDENTE()           marca_pendente
+
+static void dorme(void);
+#define TrocaContexto()            dorme()
+
+#include "rtos_porta_pc.h"
+
+static uint64_t continua_em = UINT64_MAX;
+
+/* a tarefa atual so volta quando a fila de tempo a despertar ou quando
+   chegar a marca continua_em */
+static void dorme(void) {
+    while (TCB[tarefa_atual].estado != PRONTA) {
+        uint64_t agora = MarcasDeTempo();
+        if (agora >= continua_em) {
+            continua_em = UINT64_MAX;
+            TarefaContinua(tarefa_atual);
+            break;
+        }
+        tick_t marcas = MarcasAteDespertar();
+        if (continua_em - agora < marcas) {
+            marcas = (tick_t)(continua_em - agora);
+        }
+        if (marcas > 1) {
+            CompensaMarcasDeTempo(marcas - 1);
+        }
+        ExecutaMarcaDeTempo();
+    }
+}
+
+static void tarefa_vazia(void) {
+}
+
+static uint32_t pilha[40];
+
+/* uma tarefa pronta, com o contador ja em 'marcas' */
+static void reinicia(tick_t marcas) {
+    ReiniciaMultitarefas();
+    CompensaMarcasDeTempo(marcas);
+    CriaTarefa(tarefa_vazia, "P", pilha, 40, 1);
+    tarefa_atual = 1;
+}
+
+static void trabalha(tick_t marcas) {
+    while (marcas-- > 0) {
+        ExecutaMarcaDeTempo();
+    }
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static void self_check(void) {
+    // A parte alta conta as voltas dos 32 bits baixos
+    reinicia(0xFFFFFFFEull);
+    ExecutaMarcaDeTempo();
+    assert(MarcasDeTempo() == 0xFFFFFFFFull);
+    ExecutaMarcaDeTempo();
+    assert(MarcasDeTempo() == 0x100000000ull && contador_marcas == 0);
+    CompensaMarcasDeTempo(0xFFFFFFF0u);
+    CompensaMarcasDeTempo(0x20);
+    assert(MarcasDeTempo() == 0x200000010ull);
+
+    // Prazo absoluto do outro lado da volta
+    reinicia(0xFFFFFFF0ull);
+    assert(TarefaEsperaAte(0x100000010ull) == 1);
+    assert(MarcasDeTempo() == 0x100000010ull);
+
+    // Prazo que ja passou (ou e agora): nao espera
+    assert(TarefaEsperaAte(0x100000010ull) == 0);
+    assert(TarefaEsperaAte(5) == 0);
+
+    // Mais longe que um tick_t: espera em partes
+    reinicia(0);
+    assert(TarefaEsperaAte(0x180000000ull) == 1);
+    assert(MarcasDeTempo() == 0x180000000ull);
+
+    // TarefaContinua termina a espera em partes, na primeira ou na ultima
+    reinicia(0);
+    continua_em = 1000;
+    assert(TarefaEsperaAte(0x180000000ull) == 1);
+    assert(MarcasDeTempo() == 1000 && fila_tempo == 0);
+    reinicia(0);
+    continua_em = 0x100000005ull;
+    assert(TarefaEsperaAte(0x180000000ull) == 1);
+    assert(MarcasDeTempo() == 0x100000005ull && fila_tempo == 0);
+
+    // Instante com resolucao menor que a marca
+    reinicia(5);
+    valor_systick = 47999;              // acabou de recarregar
+    assert(InstanteEmCiclos() == 5 * 48000ull);
+    valor_systick = 0;
+    assert(InstanteEmCiclos() == 5 * 48000ull + 47999);
+    valor_systick = 47990;              // recarregou com a interrupcao pendente
+    marca_pendente = 1;
+    assert(InstanteEmCiclos() == 6 * 48000ull + 9);
+    marca_pendente = 0;
+
+    printf("# conferencia da base de tempo de 64 bits OK\n");
+}
+
+/**********************
+ * MEDICAO
+ **********************/
+static inline uint64_t agora(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* marca da ultima ativacao menos a ideal (ATIVACOES * PERIODO) */
+static int64_t deriva(bool periodica) {
+    reinicia(0xFFFFFF00ull);            // passa pela volta no meio
+    uint64_t inicio = MarcasDeTempo();
+    uint64_t proxima = inicio;
+    uint64_t ativacao = inicio;
+
+    for (int i = 0; i < ATIVACOES; i++) {
+        trabalha(TRABALHO);
+        if (periodica) {
+            TarefaPeriodica(&proxima, PERIODO);
+        } else {
+            TarefaEspera(PERIODO);
+        }
+        ativacao = MarcasDeTempo();
+    }
+    return (int64_t)(ativacao - inicio) - (int64_t)ATIVACOES * PERIODO;
+}
+
+int main(void) {
+    self_check();
+
+    printf("modo,ativacoes,deriva_marcas\n");
+    printf("TarefaEspera,%d,%lld\n", ATIVACOES, (long long)deriva(false));
+    int64_t d = deriva(true);
+    assert(d == 0);
+    printf("TarefaPeriodica,%d,%lld\n", ATIVACOES, (long long)d);
+
+    volatile uint64_t soma = 0;
+    uint64_t inicio = agora();
+    for (uint32_t i = 0; i < BENCH_LEITURAS; i++) {
+        soma += MarcasDeTempo();
+    }
+    uint64_t custo_marcas = agora() - inicio;
+    inicio = agora();
+    for (uint32_t i = 0; i < BENCH_LEITURAS; i++) {
+        soma += InstanteEmCiclos();
+    }
+    uint64_t custo_instante = agora() - inicio;
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("leitura,ciclos\n");
+#else
+    printf("leitura,ns\n");
+#endif
+    printf("MarcasDeTempo,%.1f\n", (double)custo_marcas / BENCH_LEITURAS);
+    printf("InstanteEmCiclos,%.1f\n", (double)custo_instante / BENCH_LEITURAS);
+    return 0;
+}
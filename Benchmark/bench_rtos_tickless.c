@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Simulacao no PC do modo sem marcas de tempo do rtos (cfg_MARCA_TEMPO_LIVRE).
+ * Compilar com:
+ *   gcc -O2 -I ../rtos/as_sam_d21/src bench_rtos_tickless.c -o bench_rtos_tickless
+ * Executar:
+ *   ./bench_rtos_tickless      # conferencia + contagem de interrupcoes, CSV na saida
+ *
+ * O rtos.c do as_sam_d21 e incluido pela porta vazia de rtos_porta_pc.h.
+ * O tempo anda em marcas inteiras e as tarefas rodam em tempo zero: cada
+ * uma que fica pronta so chama TarefaEspera() de novo com o seu periodo. Uma tarefa suspensa e continuada por "interrupcoes
+ * externas" entre duas marcas, em instantes sorteados com semente fixa.
+ *
+ * Cada cenario roda duas vezes:
+ *  - com marca: uma interrupcao do SysTick por marca (ExecutaMarcaDeTempo)
+ *  - sem marca: com so a ociosa pronta, dorme_sem_marcas() reproduz o
+ *    DormeSemMarcas() da porta: um intervalo ate a proxima tarefa despertar
+ *    (limitado aos 24 bits do SysTick), acordando antes se chegar uma
+ *    interrupcao externa, e CompensaMarcasDeTempo() conta as marcas perdidas
+ *
+ * As duas execucoes tem de rodar as mesmas tarefas nas mesmas marcas e na
+ * mesma ordem; a saida e o numero de interrupcoes do temporizador de cada uma.
+ */
+
+#define MARCAS_SIMULADAS  100000
+#define MAX_TAREFAS       8
+#define MAX_EXECUCOES     200000
+#define MAX_EVENTOS       1024
+
+/* SysTick de 24 bits com 48 MHz e marca de 1 ms */
+#define MARCAS_MAXIMAS_SONO  (0x00FFFFFFUL / 48000UL)
+
+#define NUMERO_DE_TAREFAS MAX_TAREFAS
+#include "rtos_porta_pc.h"
+
+static uint32_t pilhas[MAX_TAREFAS][TAM_MINIMO_PILHA];
+
+static void tarefa_vazia(void) {
+}
+
+/**********************
+ * CENARIOS
+ **********************/
+typedef struct {
+    const char* nome;
+    int tarefas;
+    tick_t periodos[MAX_TAREFAS];   // 0: tarefa continuada por interrupcao externa
+    uint32_t intervalo_eventos;     // intervalo medio das interrupcoes externas, em marcas
+} Cenario;
+
+static const Cenario cenarios[] = {
+    {"sensor",   4, {100, 250, 1000, 0}, 5000},
+    {"longo",    3, {2000, 60000, 0}, 20000},
+    {"misto",    5, {3, 7, 50, 400, 0}, 300},
+    {"ocupado",  3, {1, 2, 5}, 0},
+};
+
+typedef struct {
+    uint8_t tarefa;
+    uint32_t marca;
+} Execucao;
+
+typedef struct {
+    Execucao execucoes[MAX_EXECUCOES];
+    uint32_t num_execucoes;
+    uint32_t interrupcoes;          // do temporizador
+    uint32_t sonos;
+} Resultado;
+
+static const Cenario* cenario;
+static Resultado* resultado;
+static uint32_t eventos[MAX_EVENTOS];
+static uint32_t num_eventos;
+static uint32_t proximo_evento;
+static uint32_t marca_atual;       // contador_marcas sem dar a volta nos 32 bits
+
+static uint32_t sorteia(uint32_t* estado) {
+    *estado ^= *estado << 13;
+    *estado ^= *estado >> 17;
+    *estado ^= *estado << 5;
+    return *estado;
+}
+
+/* Interrupcoes externas entre as marcas e e e+1, em ordem crescente */
+static void sorteia_eventos(void) {
+    uint32_t estado = 0x2545F491u;
+    uint32_t marca = 0;
+    num_eventos = 0;
+    if (cenario->intervalo_eventos == 0) {
+        return;
+    }
+    for (;;) {
+        marca += 1 + sorteia(&estado) % (2 * cenario->intervalo_eventos);
+        if (marca >= MARCAS_SIMULADAS || num_eventos == MAX_EVENTOS) {
+            break;
+        }
+        eventos[num_eventos++] = marca;
+    }
+}
+
+static void reinicia(void) {
+    ReiniciaMultitarefas();
+    marca_atual = 0;
+    proximo_evento = 0;
+
+    CriaTarefa(tarefa_vazia, "ociosa", pilhas[0], TAM_MINIMO_PILHA, 0);
+    for (int i = 0; i < cenario->tarefas; i++) {
+        uint8_t tarefa = CriaTarefa(tarefa_vazia, "t", pilhas[i + 1], TAM_MINIMO_PILHA, (prioridade_t)(1 + i % PRIORIDADE_MAXIMA));
+        assert(tarefa != 0);
+        if (cenario->periodos[i] == 0) {
+            TarefaSuspende(tarefa);
+        }
+    }
+}
+
+/* Roda as tarefas prontas (menos a ociosa) ate todas voltarem a esperar */
+static void executa_prontas(void) {
+    while ((mapa_prontas & ~1UL) != 0) {
+        uint8_t tarefa = escalonador();
+        assert(resultado->num_execucoes < MAX_EXECUCOES);
+        resultado->execucoes[resultado->num_execucoes++] = (Execucao){tarefa, marca_atual};
+
+        tarefa_atual = tarefa;
+        tick_t periodo = cenario->periodos[tarefa - 2];
+        if (periodo == 0) {
+            TarefaSuspende(tarefa);
+        } else {
+            TarefaEspera(periodo);
+        }
+    }
+}
+
+/* Interrupcoes externas que chegaram depois da marca atual */
+static void trata_eventos(void) {
+    while (proximo_evento < num_eventos && eventos[proximo_evento] == marca_atual) {
+        TarefaContinua((uint8_t)(cenario->tarefas + 1));
+        proximo_evento++;
+        executa_prontas();
+    }
+}
+
+static void interrupcao_marca(void) {
+    resultado->interrupcoes++;
+    ExecutaMarcaDeTempo();
+    marca_atual++;
+}
+
+static void compensa(tick_t marcas) {
+    CompensaMarcasDeTempo(marcas);
+    marca_atual += marcas;
+}
+
+/* Modelo do DormeSemMarcas() da porta, em marcas inteiras */
+static void dorme_sem_marcas(tick_t marcas) {
+    if (marcas > MARCAS_MAXIMAS_SONO) {
+        marcas = (tick_t)MARCAS_MAXIMAS_SONO;
+    }
+    resultado->sonos++;
+
+    if (proximo_evento < num_eventos && eventos[proximo_evento] < marca_atual + marcas) {
+        // Acorda com a interrupcao externa: so as marcas que ja passaram
+        compensa((tick_t)(eventos[proximo_evento] - marca_atual));
+    } else {
+        // Intervalo completo: o SysTick pendente conta a ultima marca
+        compensa((tick_t)(marcas - 1));
+        interrupcao_marca();
+    }
+}
+
+static void simula(bool sem_marca) {
+    reinicia();
+    resultado->num_execucoes = 0;
+    resultado->interrupcoes = 0;
+    resultado->sonos = 0;
+
+    while (marca_atual < MARCAS_SIMULADAS) {
+        executa_prontas();
+        trata_eventos();
+
+        tick_t marcas = MarcasAteDespertar();
+        if (sem_marca && marcas >= cfg_MARCAS_MINIMAS_SONO) {
+            dorme_sem_marcas(marcas);
+        } else {
+            interrupcao_marca();
+        }
+        assert(contador_marcas == (tick_t)marca_atual);
+    }
+}
+
+/**********************
+ * CONFERENCIA
+ **********************/
+static void test_compensa() {
+    static const Cenario unico = {"conferencia", 3, {4, 6, 6}, 0};
+    static Resultado r;
+    cenario = &unico;
+    resultado = &r;
+    reinicia();
+
+    // Fila com deltas 4, 2, 0: compensar 5 desperta so a primeira
+    for (uint8_t t = 2; t <= 4; t++) {
+        tarefa_atual = t;
+        TarefaEspera(unico.periodos[t - 2]);
+    }
+    assert(MarcasAteDespertar() == 4);
+    CompensaMarcasDeTempo(5);
+    assert(TCB[2].estado == PRONTA && TCB[3].estado == ESPERA && TCB[4].estado == ESPERA);
+    assert(MarcasAteDespertar() == 1);
+
+    // Mais 3 passam da marca das outras duas
+    CompensaMarcasDeTempo(3);
+    assert(TCB[3].estado == PRONTA && TCB[4].estado == PRONTA);
+    assert(MarcasAteDespertar() == MARCAS_INFINITAS);
+    assert(contador_marcas == 8);
+}
+
+int main(void) {
+    static Resultado com_marca, sem_marca;
+
+    test_compensa();
+
+    printf("cenario,marcas,execucoes,interrupcoes_com_marca,interrupcoes_sem_marca,sonos,economia_pct\n");
+    for (size_t c = 0; c < sizeof(cenarios) / sizeof(cenarios[0]); c++) {
+        cenario = &cenarios[c];
+        sorteia_eventos();
+
+        resultado = &com_marca;
+        simula(false);
+        resultado = &sem_marca;
+        simula(true);
+
+        // As tarefas despertam nas mesmas marcas e na mesma ordem
+        assert(com_marca.num_execucoes == sem_marca.num_execucoes);
+        assert(memcmp(com_marca.execucoes, sem_marca.execucoes,
+                      com_marca.num_execucoes * sizeof(Execucao)) == 0);
+        assert(com_marca.interrupcoes == MARCAS_SIMULADAS);
+
+        printf("%s,%u,%u,%u,%u,%u,%.1f\n", cenario->nome, MARCAS_SIMULADAS,
+               com_marca.num_execucoes, com_marca.interrupcoes, sem_marca.interrupcoes,
+               sem_marca.sonos, 100.0 * (1.0 - (double)sem_marca.interrupcoes / com_marca.interrupcoes));
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * framing_bench.h
+ *
+ * Interface comum para comparar as tres implementacoes do protocolo
+ * STX QTD DADOS CHK ETX (FSM com switch, FSM com ponteiros de funcao e
+ * protothreads). Cada adaptador (bench_*.c) inclui o arquivo da
+ * implementacao e expoe um FramingImpl:
+ *
+ *  - encode(): um quadro com 'length' bytes de dados vai para um ByteSink
+ *  - decode(): consome todo o ByteSource; cada quadro valido entregue soma
+ *              em DecodeStats. O estado do receptor continua entre chamadas,
+ *              entao um quadro pode chegar dividido em varias chamadas.
+ *
+ * Todas as implementacoes usam a verificacao XOR8 padrao e, no receptor,
+ * ressincronizam depois de um quadro com erro.
+ */
+
+#ifndef FRAMING_BENCH_H_
+#define FRAMING_BENCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**********************
+ * FONTE E DESTINO DE BYTES
+ **********************/
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+} ByteSource;
+
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+    size_t length;
+} ByteSink;
+
+static inline bool source_get(ByteSource* source, uint8_t* byte) {
+    if (source->pos >= source->length) {
+        return false;
+    }
+    *byte = source->data[source->pos++];
+    return true;
+}
+
+/* Bytes restantes de uma vez, para os receptores em bloco */
+static inline size_t source_span(ByteSource* source, const uint8_t** span) {
+    *span = &source->data[source->pos];
+    return source->length - source->pos;
+}
+
+static inline void source_consume(ByteSource* source, size_t count) {
+    source->pos += count;
+}
+
+/* Sem verificacao de capacidade no caminho quente: o chamador dimensiona */
+static inline void sink_put(ByteSink* sink, uint8_t byte) {
+    sink->data[sink->length++] = byte;
+}
+
+/**********************
+ * IMPLEMENTACOES
+ **********************/
+typedef struct {
+    uint32_t frames;             // quadros validos entregues
+    uint32_t bytes;              // bytes de dados entregues
+    uint32_t digest;             // tamanho, primeiro e ultimo byte de cada quadro
+} DecodeStats;
+
+/* Custo constante por quadro, para nao pesar no ns/byte do receptor */
+static inline void decode_stats_add(DecodeStats* stats, const uint8_t* data, size_t length) {
+    stats->frames++;
+    stats->bytes += (uint32_t)length;
+    stats->digest = stats->digest * 31u + (uint32_t)length;
+    if (length > 0) {
+        stats->digest = stats->digest * 31u + (uint32_t)(data[0] << 8 | data[length - 1]);
+    }
+}
+
+typedef struct {
+    const char* name;
+    // Funcoes e tabelas do caminho de dados, somadas no tamanho de codigo
+    const char* const* symbols;
+    // false: a implementacao nao transmite quadro sem dados
+    bool empty_frames;
+    void (*reset)(void);
+    void (*encode)(const uint8_t* data, uint16_t length, ByteSink* out);
+    void (*decode)(ByteSource* in, DecodeStats* stats);
+} FramingImpl;
+
+extern const FramingImpl framing_fsm;
+extern const FramingImpl framing_fsm_bloco;
+extern const FramingImpl framing_fsm_ponteiro;
+extern const FramingImpl framing_protothreads;
+
+#endif /* FRAMING_BENCH_H_ */
@@ -0,0 +1,208 @@
+/*
+ * rtos_porta_pc.h
+ *
+ * Porta do rtos para as conferencias e medidas no PC (bench_rtos_*.c).
+ * Inclui o rtos.c do as_sam_d21 (compilar com -I ../rtos/as_sam_d21/src)
+ * com os guardas de asf.h e cpu-port.h ja definidos, que escondem os do
+ * ARM. Diferente de rtos/posix, nao ha SysTick nem sinais: o tempo so anda
+ * quando o benchmark chama ExecutaMarcaDeTempo(), o que deixa cada cenario
+ * deterministico.
+ *
+ * Antes de incluir, o benchmark pode definir NUMERO_DE_TAREFAS, as cfg_*
+ * do rtos.h e qualquer macro da porta (LE_CONTADOR_LIVRE(), TrocaContexto(),
+ * ESTOURO_DE_PILHA, ...); as que faltarem ficam vazias ou em 0. Com
+ * PORTA_PC_CRIA_CONTEXTO o benchmark escreve o seu CriaContexto.
+ *
+ * Dois modos:
+ *  - PORTA_PC_TROCA 0 (padrao): sem troca de contexto de verdade; o
+ *    benchmark escolhe a tarefa atual a mao
+ *  - PORTA_PC_TROCA 1: o PendSV e um swapcontext(), cada tarefa criada com
+ *    cria() tem um ucontext_t com pilha propria; inicia() roda a tarefa
+ *    escolhida pelo escalonador ate uma delas chamar volta()
+ *
+ * ReiniciaMultitarefas(), definida aqui e nao no kernel, (ou reinicia_pc(),
+ * que zera tambem os contadores daqui) volta o kernel ao estado inicial
+ * entre dois cenarios.
+ */
+
+#ifndef RTOS_PORTA_PC_H_
+#define RTOS_PORTA_PC_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef PORTA_PC_TROCA
+#define PORTA_PC_TROCA 0
+#endif
+
+#if PORTA_PC_TROCA
+#include <assert.h>
+#include <ucontext.h>
+#endif
+
+/**********************
+ * PORTA
+ **********************/
+#define ASF_H
+#define CPU_PORT_H_
+#define TAM_MINIMO_PILHA  (16)
+typedef uint32_t* stackptr_t;
+typedef uintptr_t sp_t;
+
+#if PORTA_PC_TROCA
+static void pendsv(void);
+#ifndef TROCA_CONTEXTO
+#define TROCA_CONTEXTO()               pendsv()
+#endif
+#ifndef TrocaContexto
+#define TrocaContexto()                pendsv()
+#endif
+#ifndef SOLICITA_TROCA_CONTEXTO_ISR
+#define SOLICITA_TROCA_CONTEXTO_ISR()  pendsv()
+#endif
+#endif
+
+#ifndef REG_ATOMICA_INICIO
+#define REG_ATOMICA_INICIO()
+#endif
+#ifndef REG_ATOMICA_FIM
+#define REG_ATOMICA_FIM()
+#endif
+#ifndef REG_ATOMICA_SALVA
+#define REG_ATOMICA_SALVA(estado)      estado = 0;
+#endif
+#ifndef REG_ATOMICA_RESTAURA
+#define REG_ATOMICA_RESTAURA(estado)   (void)(estado);
+#endif
+#ifndef TROCA_CONTEXTO
+#define TROCA_CONTEXTO()
+#endif
+#ifndef TrocaContexto
+#define TrocaContexto()
+#endif
+#ifndef SOLICITA_TROCA_CONTEXTO_ISR
+#define SOLICITA_TROCA_CONTEXTO_ISR()
+#endif
+#ifndef GERA_INTERRUPCAO_SW
+#define GERA_INTERRUPCAO_SW()
+#endif
+#ifndef LE_CONTADOR_CICLOS
+#define LE_CONTADOR_CICLOS()           0
+#endif
+#ifndef PERIODO_CONTADOR_CICLOS
+#define PERIODO_CONTADOR_CICLOS()      1
+#endif
+#ifndef LE_CONTADOR_LIVRE
+#define LE_CONTADOR_LIVRE()            0
+#endif
+#ifndef FREQUENCIA_CONTADOR_LIVRE
+#define FREQUENCIA_CONTADOR_LIVRE      1000000UL
+#endif
+#ifndef EXCECAO_SYSTICK
+#define EXCECAO_SYSTICK                15
+#endif
+
+#include "rtos.c"
+
+#ifndef PORTA_PC_CRIA_CONTEXTO
+stackptr_t CriaContexto(tarefa_t endereco_tarefa, stackptr_t ptr_pilha) {
+    (void)endereco_tarefa;
+    return ptr_pilha;
+}
+#endif
+
+/* Volta o kernel ao estado de antes da primeira CriaTarefa: nenhuma tarefa,
+   marcas de tempo em 0, contadores e rastro vazios. Os semaforos, filas e
+   demais objetos sao do benchmark e ficam como estao. Fica aqui, e nao no
+   rtos.c, porque so os benchmarks rodam varios cenarios no mesmo programa;
+   como o rtos.c e incluido acima, ela ve as variaveis static dele. Chamar
+   com as tarefas paradas */
+static void ReiniciaMultitarefas(void) {
+    memset(TCB, 0, sizeof(TCB));
+    memset(Prioridades, 0, sizeof(Prioridades));
+    mapa_prontas = 0;
+    tarefa_atual = 0;
+    proxima_tarefa = 0;
+    numero_tarefas = 0;
+    fila_tempo = 0;
+    contador_marcas = 0;
+    marcas_alto = 0;
+#if cfg_FATIA_TEMPO > 0
+    fatia_restante = cfg_FATIA_TEMPO;
+#endif
+#if cfg_CONTA_TROCAS
+    trocas_pedidas = 0;
+    trocas_necessarias = 0;
+    trocas_realizadas = 0;
+#endif
+#if cfg_MEDE_TROCA_CONTEXTO
+    ciclos_troca_ultimo = 0;
+    ciclos_troca_maximo = 0;
+#endif
+#if cfg_CONTA_TEMPO_CPU
+    inicio_execucao = 0;
+    instante_carga = 0;
+    ociosa_carga = 0;
+#endif
+#if cfg_RASTRO
+    memset(rastro.nomes, 0, sizeof(rastro.nomes));
+    rastro.escritos = 0;
+    rastro_instante = 0;
+#endif
+}
+
+/**********************
+ * TROCA DE CONTEXTO COM swapcontext()
+ **********************/
+#if PORTA_PC_TROCA
+#ifndef TAM_PILHA_PC
+#define TAM_PILHA_PC  (64 * 1024)
+#endif
+
+static ucontext_t principal;
+static ucontext_t contextos[NUMERO_DE_TAREFAS + 1];
+static uint8_t pilhas_pc[NUMERO_DE_TAREFAS + 1][TAM_PILHA_PC];
+static uint32_t pilhas[NUMERO_DE_TAREFAS + 1][TAM_MINIMO_PILHA];
+static uint32_t pendsvs;
+
+/* Salva a tarefa atual e restaura a escolhida pelo escalonador, mesmo
+   quando e a mesma, como o PendSV do Cortex-M */
+static void pendsv(void) {
+    uint8_t anterior = tarefa_atual;
+    pendsvs++;
+    tarefa_atual = escalonador();
+    swapcontext(&contextos[anterior], &contextos[tarefa_atual]);
+}
+
+/* Cria a tarefa no rtos e o seu contexto no PC; retorna o numero da tarefa */
+static inline uint8_t cria(void (*funcao)(void), prioridade_t prioridade) {
+    uint8_t tarefa = CriaTarefa(funcao, "t", pilhas[numero_tarefas + 1], TAM_MINIMO_PILHA, prioridade);
+    assert(tarefa != 0); /* prioridade ou numero de tarefas fora do limite */
+    getcontext(&contextos[tarefa]);
+    contextos[tarefa].uc_stack.ss_sp = pilhas_pc[tarefa];
+    contextos[tarefa].uc_stack.ss_size = TAM_PILHA_PC;
+    contextos[tarefa].uc_link = NULL;
+    makecontext(&contextos[tarefa], funcao, 0);
+    return tarefa;
+}
+
+/* Roda as tarefas criadas ate uma delas chamar volta() */
+static inline void inicia(void) {
+    tarefa_atual = escalonador();
+    swapcontext(&principal, &contextos[tarefa_atual]);
+}
+
+/* Chamada por uma tarefa: devolve o controle a quem chamou inicia() */
+static inline void volta(void) {
+    swapcontext(&contextos[tarefa_atual], &principal);
+}
+#endif
+
+static inline void reinicia_pc(void) {
+    ReiniciaMultitarefas();
+#if PORTA_PC_TROCA
+    pendsvs = 0;
+#endif
+}
+
+#endif /* RTOS_PORTA_PC_H_ */
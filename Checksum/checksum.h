@@ -0,0 +1,172 @@
+/*
+ * checksum.h
+ *
+ * Checksum XOR de 8 bits usado pelos tres protocolos (FSM switch,
+ * FSM com ponteiros de funcao e protothreads).
+ *
+ * Caminhos disponiveis:
+ *  - checksum_xor8_ref():  laco byte a byte, usado como referencia
+ *  - checksum_xor8_word(): palavra a palavra (32 ou 64 bits), com tratamento
+ *                          da cabeca desalinhada e da cauda
+ *  - checksum_xor8_simd(): AVX2, SSE2 ou NEON, escolhido na compilacao;
+ *                          sem SIMD disponivel usa o caminho por palavra
+ *  - checksum_xor8():      melhor caminho disponivel
+ *
+ * Como o XOR e associativo e comutativo, cada caminho acumula blocos
+ * largos e no final "dobra" o acumulador ate 8 bits.
+ */
+
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* palavra nativa do processador: 64 bits no host, 32 bits no Cortex-M0 */
+#if UINTPTR_MAX > 0xFFFFFFFFu
+typedef uint64_t checksum_word_t;
+#else
+typedef uint32_t checksum_word_t;
+#endif
+
+#if defined(__AVX2__)
+#define CHECKSUM_SIMD_NOME "AVX2"
+#elif defined(__SSE2__)
+#define CHECKSUM_SIMD_NOME "SSE2"
+#elif defined(__ARM_NEON)
+#define CHECKSUM_SIMD_NOME "NEON"
+#else
+#define CHECKSUM_SIMD_NOME "nenhum (palavra)"
+#endif
+
+/* Caminho de referencia: um byte por iteracao */
+static inline uint8_t checksum_xor8_ref(const uint8_t* data, size_t length) {
+    uint8_t chk = 0;
+    for (size_t i = 0; i < length; i++) {
+        chk ^= data[i];
+    }
+    return chk;
+}
+
+/* Reduz uma palavra a 8 bits com XOR entre suas metades */
+static inline uint8_t checksum_fold_word(checksum_word_t word) {
+    for (unsigned shift = sizeof(checksum_word_t) * 4; shift >= 8; shift /= 2) {
+        word ^= word >> shift;
+    }
+    return (uint8_t)word;
+}
+
+/* Caminho por palavra: bytes ate alinhar, palavras alinhadas e cauda */
+static inline uint8_t checksum_xor8_word(const uint8_t* data, size_t length) {
+    uint8_t chk = 0;
+
+    // Cabeca desalinhada
+    while (length > 0 && ((uintptr_t)data & (sizeof(checksum_word_t) - 1)) != 0) {
+        chk ^= *data++;
+        length--;
+    }
+
+    // Quatro acumuladores independentes para nao serializar os XORs
+    checksum_word_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    checksum_word_t w0, w1, w2, w3;
+    while (length >= 4 * sizeof(checksum_word_t)) {
+        memcpy(&w0, data, sizeof(w0));
+        memcpy(&w1, data + sizeof(w0), sizeof(w1));
+        memcpy(&w2, data + 2 * sizeof(w0), sizeof(w2));
+        memcpy(&w3, data + 3 * sizeof(w0), sizeof(w3));
+        acc0 ^= w0;
+        acc1 ^= w1;
+        acc2 ^= w2;
+        acc3 ^= w3;
+        data += 4 * sizeof(checksum_word_t);
+        length -= 4 * sizeof(checksum_word_t);
+    }
+    while (length >= sizeof(checksum_word_t)) {
+        memcpy(&w0, data, sizeof(w0));
+        acc0 ^= w0;
+        data += sizeof(checksum_word_t);
+        length -= sizeof(checksum_word_t);
+    }
+
+    // Cauda
+    return chk ^ checksum_fold_word(acc0 ^ acc1 ^ acc2 ^ acc3) ^ checksum_xor8_ref(data, length);
+}
+
+/* Caminho SIMD: leituras desalinhadas de 32/16 bytes; o resto vai por palavra */
+static inline uint8_t checksum_xor8_simd(const uint8_t* data, size_t length) {
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    uint8_t lanes[32];
+    size_t nlanes;
+
+    // Blocos curtos nao compensam a reducao do registrador vetorial
+    if (length < 32) {
+        return checksum_xor8_word(data, length);
+    }
+#if defined(__AVX2__)
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    while (length >= 64) {
+        acc0 = _mm256_xor_si256(acc0, _mm256_loadu_si256((const __m256i*)data));
+        acc1 = _mm256_xor_si256(acc1, _mm256_loadu_si256((const __m256i*)(data + 32)));
+        data += 64;
+        length -= 64;
+    }
+    if (length >= 32) {
+        acc0 = _mm256_xor_si256(acc0, _mm256_loadu_si256((const __m256i*)data));
+        data += 32;
+        length -= 32;
+    }
+    _mm256_storeu_si256((__m256i*)lanes, _mm256_xor_si256(acc0, acc1));
+    nlanes = 32;
+#elif defined(__SSE2__)
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    while (length >= 32) {
+        acc0 = _mm_xor_si128(acc0, _mm_loadu_si128((const __m128i*)data));
+        acc1 = _mm_xor_si128(acc1, _mm_loadu_si128((const __m128i*)(data + 16)));
+        data += 32;
+        length -= 32;
+    }
+    if (length >= 16) {
+        acc0 = _mm_xor_si128(acc0, _mm_loadu_si128((const __m128i*)data));
+        data += 16;
+        length -= 16;
+    }
+    _mm_storeu_si128((__m128i*)lanes, _mm_xor_si128(acc0, acc1));
+    nlanes = 16;
+#else
+    uint8x16_t acc0 = vdupq_n_u8(0);
+    uint8x16_t acc1 = vdupq_n_u8(0);
+    while (length >= 32) {
+        acc0 = veorq_u8(acc0, vld1q_u8(data));
+        acc1 = veorq_u8(acc1, vld1q_u8(data + 16));
+        data += 32;
+        length -= 32;
+    }
+    if (length >= 16) {
+        acc0 = veorq_u8(acc0, vld1q_u8(data));
+        data += 16;
+        length -= 16;
+    }
+    vst1q_u8(lanes, veorq_u8(acc0, acc1));
+    nlanes = 16;
+#endif
+    return checksum_xor8_word(lanes, nlanes) ^ checksum_xor8_word(data, length);
+#else
+    return checksum_xor8_word(data, length);
+#endif
+}
+
+/* Melhor caminho disponivel nesta compilacao */
+static inline uint8_t checksum_xor8(const uint8_t* data, size_t length) {
+    return checksum_xor8_simd(data, length);
+}
+
+#endif /* CHECKSUM_H_ */
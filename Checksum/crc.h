@@ -0,0 +1,77 @@
+/*
+ * crc.h
+ *
+ * CRC-16/CCITT e CRC-32C por tabela.
+ *
+ * Cada CRC tem duas formas de atualizacao com o mesmo resultado:
+ *  - *_byte():   um byte por chamada (uma consulta de tabela), para os
+ *                receptores/transmissores byte a byte
+ *  - *_update(): bloco inteiro processado em fatias de 4 (CRC-16) ou
+ *                8 (CRC-32C) bytes, para os caminhos em bloco
+ *
+ * CRC-16/CCITT: valor inicial 0xFFFF, sem reflexao, sem XOR final.
+ * CRC-32C:      valor inicial 0xFFFFFFFF, refletido, XOR final 0xFFFFFFFF.
+ * O valor inicial e o XOR final ficam a cargo de quem chama.
+ */
+
+#ifndef CRC_H_
+#define CRC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "crc_tabelas.h"
+
+#define CRC16_CCITT_INICIAL  0xFFFFu
+#define CRC32C_INICIAL       0xFFFFFFFFu
+#define CRC32C_XOR_FINAL     0xFFFFFFFFu
+
+/* CRC-16/CCITT */
+static inline uint16_t crc16_ccitt_byte(uint16_t crc, uint8_t byte) {
+    return (uint16_t)((crc << 8) ^ crc16_ccitt_tabela[0][(crc >> 8) ^ byte]);
+}
+
+static inline uint16_t crc16_ccitt_update(uint16_t crc, const uint8_t* data, size_t length) {
+    // Fatias de 4 bytes: os dois primeiros se combinam com o CRC atual
+    while (length >= 4) {
+        crc ^= (uint16_t)((data[0] << 8) | data[1]);
+        crc = crc16_ccitt_tabela[3][crc >> 8] ^
+              crc16_ccitt_tabela[2][crc & 0xFF] ^
+              crc16_ccitt_tabela[1][data[2]] ^
+              crc16_ccitt_tabela[0][data[3]];
+        data += 4;
+        length -= 4;
+    }
+    while (length-- > 0) {
+        crc = crc16_ccitt_byte(crc, *data++);
+    }
+    return crc;
+}
+
+/* CRC-32C (Castagnoli) */
+static inline uint32_t crc32c_byte(uint32_t crc, uint8_t byte) {
+    return (crc >> 8) ^ crc32c_tabela[0][(crc ^ byte) & 0xFF];
+}
+
+static inline uint32_t crc32c_update(uint32_t crc, const uint8_t* data, size_t length) {
+    // Fatias de 8 bytes: os quatro primeiros se combinam com o CRC atual
+    while (length >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                             ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+        crc = crc32c_tabela[7][lo & 0xFF] ^
+              crc32c_tabela[6][(lo >> 8) & 0xFF] ^
+              crc32c_tabela[5][(lo >> 16) & 0xFF] ^
+              crc32c_tabela[4][lo >> 24] ^
+              crc32c_tabela[3][data[4]] ^
+              crc32c_tabela[2][data[5]] ^
+              crc32c_tabela[1][data[6]] ^
+              crc32c_tabela[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = crc32c_byte(crc, *data++);
+    }
+    return crc;
+}
+
+#endif /* CRC_H_ */
@@ -0,0 +1,74 @@
+/*
+ * frame_check.h
+ *
+ * Verificacao de quadro selecionavel: XOR de 8 bits (formato original),
+ * CRC-16/CCITT ou CRC-32C. O estado em andamento cabe em um uint32_t; o
+ * valor final e transmitido a partir do byte mais significativo.
+ *
+ * Uso:
+ *   state = check_init(type);
+ *   state = check_update_byte(type, state, byte);       // byte a byte
+ *   state = check_update(type, state, data, length);    // em bloco
+ *   value = check_final(type, state);
+ *   byte i transmitido = check_byte(type, value, i), i < check_size(type)
+ */
+
+#ifndef FRAME_CHECK_H_
+#define FRAME_CHECK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "checksum.h"
+#include "crc.h"
+
+typedef enum {
+    CHECK_XOR8,
+    CHECK_CRC16,
+    CHECK_CRC32C
+} CheckType;
+
+/* Numero de bytes de verificacao no quadro */
+#define CHECK_MAX_SIZE 4
+
+static inline uint8_t check_size(CheckType type) {
+    switch (type) {
+        case CHECK_CRC16:  return 2;
+        case CHECK_CRC32C: return 4;
+        default:           return 1;
+    }
+}
+
+static inline uint32_t check_init(CheckType type) {
+    switch (type) {
+        case CHECK_CRC16:  return CRC16_CCITT_INICIAL;
+        case CHECK_CRC32C: return CRC32C_INICIAL;
+        default:           return 0;
+    }
+}
+
+static inline uint32_t check_update_byte(CheckType type, uint32_t state, uint8_t byte) {
+    switch (type) {
+        case CHECK_CRC16:  return crc16_ccitt_byte((uint16_t)state, byte);
+        case CHECK_CRC32C: return crc32c_byte(state, byte);
+        default:           return state ^ byte;
+    }
+}
+
+static inline uint32_t check_update(CheckType type, uint32_t state, const uint8_t* data, size_t length) {
+    switch (type) {
+        case CHECK_CRC16:  return crc16_ccitt_update((uint16_t)state, data, length);
+        case CHECK_CRC32C: return crc32c_update(state, data, length);
+        default:           return state ^ checksum_xor8(data, length);
+    }
+}
+
+static inline uint32_t check_final(CheckType type, uint32_t state) {
+    return (type == CHECK_CRC32C) ? state ^ CRC32C_XOR_FINAL : state;
+}
+
+/* Byte 'index' do valor final, na ordem de transmissao (MSB primeiro) */
+static inline uint8_t check_byte(CheckType type, uint32_t value, uint8_t index) {
+    return (uint8_t)(value >> (8 * (check_size(type) - 1 - index)));
+}
+
+#endif /* FRAME_CHECK_H_ */
@@ -0,0 +1,285 @@
+// clock_gettime/CLOCK_MONOTONIC (POSIX) tambem com -std=c11
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "checksum.h"
+#include "crc.h"
+
+/*
+ * Testes e benchmark do modulo de checksum.
+ * Compilar com: gcc -O2 teste_checksum.c -o teste_checksum
+ * (acrescentar -mavx2 para o caminho AVX2)
+ */
+
+#define MAX_LEN      255
+#define MAX_OFFSET   32
+
+typedef uint8_t (*ChecksumFunc)(const uint8_t* data, size_t length);
+
+typedef struct {
+    const char* name;
+    ChecksumFunc func;
+} ChecksumPath;
+
+const ChecksumPath paths[] = {
+    {"referencia", checksum_xor8_ref},
+    {"palavra", checksum_xor8_word},
+    {"SIMD " CHECKSUM_SIMD_NOME, checksum_xor8_simd},
+    {"checksum_xor8", checksum_xor8},
+};
+
+#define NUM_PATHS (sizeof(paths) / sizeof(paths[0]))
+
+/**********************
+ * TESTES (TDD)
+ **********************/
+void test_known_values() {
+    printf("=== Teste valores conhecidos ===\n");
+
+    uint8_t complex_data[] = {0x41, 0x42, 0x43, 0x44};
+    for (size_t p = 0; p < NUM_PATHS; p++) {
+        assert(paths[p].func(complex_data, 0) == 0);
+        assert(paths[p].func(complex_data, 2) == (0x41 ^ 0x42));
+        assert(paths[p].func(complex_data, 4) == (0x41 ^ 0x42 ^ 0x43 ^ 0x44));
+    }
+
+    printf("Valores conhecidos OK ✓\n");
+}
+
+void test_all_lengths_and_alignments() {
+    printf("\n=== Teste todos os tamanhos e alinhamentos ===\n");
+
+    // Buffer alinhado a 64 bytes para controlar o deslocamento exato
+    static _Alignas(64) uint8_t buffer[MAX_OFFSET + MAX_LEN + 64];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i * 167 + 13);
+    }
+
+    for (size_t offset = 0; offset < MAX_OFFSET; offset++) {
+        for (size_t length = 0; length <= MAX_LEN; length++) {
+            uint8_t expected = checksum_xor8_ref(&buffer[offset], length);
+            for (size_t p = 1; p < NUM_PATHS; p++) {
+                assert(paths[p].func(&buffer[offset], length) == expected);
+            }
+        }
+    }
+
+    printf("Tamanhos 0..%d e deslocamentos 0..%d conferem com a referencia ✓\n",
+           MAX_LEN, MAX_OFFSET - 1);
+}
+
+void test_single_bit() {
+    printf("\n=== Teste bit isolado em cada posicao ===\n");
+
+    // Cada bit de cada byte precisa chegar ao resultado
+    uint8_t buffer[MAX_LEN];
+    for (size_t pos = 0; pos < MAX_LEN; pos++) {
+        for (int bit = 0; bit < 8; bit++) {
+            memset(buffer, 0, sizeof(buffer));
+            buffer[pos] = (uint8_t)(1u << bit);
+            for (size_t p = 0; p < NUM_PATHS; p++) {
+                assert(paths[p].func(buffer, sizeof(buffer)) == (uint8_t)(1u << bit));
+            }
+        }
+    }
+
+    printf("Todos os bits propagados ✓\n");
+}
+
+// CRCs calculados bit a bit, sem tabela, usados como referencia
+uint16_t crc16_ccitt_bitwise(uint16_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint32_t crc32c_bitwise(uint32_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+void test_crc_check_values() {
+    printf("\n=== Teste CRC: valores de verificacao ===\n");
+
+    const uint8_t check[] = "123456789";
+    assert(crc16_ccitt_update(CRC16_CCITT_INICIAL, check, 9) == 0x29B1);
+    assert((crc32c_update(CRC32C_INICIAL, check, 9) ^ CRC32C_XOR_FINAL) == 0xE3069283u);
+
+    printf("CRC-16/CCITT(\"123456789\") = 0x29B1 ✓\n");
+    printf("CRC-32C(\"123456789\") = 0xE3069283 ✓\n");
+}
+
+void test_crc_tables() {
+    printf("\n=== Teste CRC: tabelas pre-calculadas ===\n");
+
+    // A tabela [k] equivale ao byte i seguido de k bytes nulos
+    for (int i = 0; i < 256; i++) {
+        uint8_t msg[8] = {(uint8_t)i};
+        for (int k = 0; k < 4; k++) {
+            uint16_t crc = crc16_ccitt_bitwise(0, msg, 1 + k);
+            assert(crc16_ccitt_tabela[k][i] == crc);
+        }
+        for (int k = 0; k < 8; k++) {
+            assert(crc32c_tabela[k][i] == crc32c_bitwise(0, msg, 1 + k));
+        }
+    }
+
+    printf("Tabelas conferem com o calculo bit a bit ✓\n");
+}
+
+void test_crc_all_lengths_and_alignments() {
+    printf("\n=== Teste CRC: fatias x byte a byte ===\n");
+
+    static uint8_t buffer[MAX_OFFSET + MAX_LEN + 8];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i * 167 + 13);
+    }
+
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length <= MAX_LEN; length++) {
+            const uint8_t* data = &buffer[offset];
+            uint16_t crc16 = CRC16_CCITT_INICIAL;
+            uint32_t crc32 = CRC32C_INICIAL;
+            for (size_t i = 0; i < length; i++) {
+                crc16 = crc16_ccitt_byte(crc16, data[i]);
+                crc32 = crc32c_byte(crc32, data[i]);
+            }
+            assert(crc16 == crc16_ccitt_bitwise(CRC16_CCITT_INICIAL, data, length));
+            assert(crc32 == crc32c_bitwise(CRC32C_INICIAL, data, length));
+            assert(crc16_ccitt_update(CRC16_CCITT_INICIAL, data, length) == crc16);
+            assert(crc32c_update(CRC32C_INICIAL, data, length) == crc32);
+
+            // Atualizacao incremental em dois blocos
+            size_t half = length / 3;
+            assert(crc16_ccitt_update(crc16_ccitt_update(CRC16_CCITT_INICIAL, data, half),
+                                      data + half, length - half) == crc16);
+            assert(crc32c_update(crc32c_update(CRC32C_INICIAL, data, half),
+                                 data + half, length - half) == crc32);
+        }
+    }
+
+    printf("Caminhos por fatias e byte a byte conferem ✓\n");
+}
+
+void run_all_tests() {
+    printf("Iniciando testes TDD...\n");
+    printf("SIMD nesta compilacao: %s\n\n", CHECKSUM_SIMD_NOME);
+
+    test_known_values();
+    test_all_lengths_and_alignments();
+    test_single_bit();
+    test_crc_check_values();
+    test_crc_tables();
+    test_crc_all_lengths_and_alignments();
+
+    printf("\n Todos os testes passaram!\n");
+}
+
+/**********************
+ * BENCHMARK
+ **********************/
+#define BENCH_BYTES (64u * 1024u * 1024u)
+
+double elapsed_seconds(const struct timespec* start, const struct timespec* end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Vazao de cada caminho para um tamanho de bloco
+void benchmark_block(const ChecksumPath* bench, size_t count, const uint8_t* buffer, size_t block) {
+    size_t repeats = BENCH_BYTES / block;
+    printf("bloco %6zu bytes:", block);
+
+    for (size_t p = 0; p < count; p++) {
+        volatile uint8_t sink = 0;
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t r = 0; r < repeats; r++) {
+            sink ^= bench[p].func(buffer + (r & 7), block);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double mbytes = (double)(repeats * block) / 1e6;
+        printf("  %s %8.1f MB/s", bench[p].name, mbytes / elapsed_seconds(&start, &end));
+    }
+    printf("\n");
+}
+
+uint8_t crc16_byte_loop(const uint8_t* data, size_t length) {
+    uint16_t crc = CRC16_CCITT_INICIAL;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc16_ccitt_byte(crc, data[i]);
+    }
+    return (uint8_t)crc;
+}
+
+uint8_t crc16_sliced(const uint8_t* data, size_t length) {
+    return (uint8_t)crc16_ccitt_update(CRC16_CCITT_INICIAL, data, length);
+}
+
+uint8_t crc32c_byte_loop(const uint8_t* data, size_t length) {
+    uint32_t crc = CRC32C_INICIAL;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc32c_byte(crc, data[i]);
+    }
+    return (uint8_t)crc;
+}
+
+uint8_t crc32c_sliced(const uint8_t* data, size_t length) {
+    return (uint8_t)crc32c_update(CRC32C_INICIAL, data, length);
+}
+
+const ChecksumPath crc_paths[] = {
+    {"CRC-16 byte", crc16_byte_loop},
+    {"CRC-16 x4", crc16_sliced},
+    {"CRC-32C byte", crc32c_byte_loop},
+    {"CRC-32C x8", crc32c_sliced},
+};
+
+void benchmark_checksum() {
+    printf("\n=== Benchmark checksum (MB/s) ===\n");
+
+    static uint8_t buffer[64 * 1024 + 8];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    const size_t blocks[] = {16, 64, 255, 4096, 64 * 1024};
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        benchmark_block(paths, NUM_PATHS, buffer, blocks[b]);
+    }
+
+    printf("\n=== Benchmark CRC (MB/s) ===\n");
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        benchmark_block(crc_paths, sizeof(crc_paths) / sizeof(crc_paths[0]), buffer, blocks[b]);
+    }
+}
+
+/**********************
+ * FUNCIONAMENTO
+ **********************/
+int main(int argc, char** argv) {
+    run_all_tests();
+
+    // "./teste_checksum bench" executa tambem o benchmark
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchmark_checksum();
+    }
+
+    return 0;
+}
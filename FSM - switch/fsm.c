@@ -1,8 +1,16 @@
+// clock_gettime/CLOCK_MONOTONIC (POSIX) tambem com -std=c11
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include "../Checksum/frame_check.h"
+#include "../RingBuffer/ring_buffer.h"
 
 /**********************
  * DEFINIÇÕES DO PROTOCOLO
@@ -11,6 +19,44 @@
 #define ETX 0x03
 #define MAX_DATA_SIZE 255
 
+/*
+ * Quadro estendido, para dados maiores que 255 bytes:
+ *   SOH LEN DADOS CHK ETX
+ * LEN é um varint de 16 bits (7 bits por byte, menos significativos primeiro,
+ * bit 7 = continua; 1 a 3 bytes). A verificação cobre SOH, LEN e DADOS.
+ * Um quadro com LEN = 0 é o anúncio de capacidade:
+ *   SOH 0x00 MAX CHK ETX
+ * com MAX (varint) = maior quadro estendido aceito por quem anuncia. Só se
+ * transmite quadro estendido depois de receber o anúncio do outro lado;
+ * até lá (ou com um par antigo, que ignora o SOH) vale o formato de 1 byte.
+ */
+#define SOH 0x01
+#define MAX_LEN_BYTES 3
+
+// Maior quadro estendido que o receptor pode aceitar (até 65535). O padrão
+// não reserva nada além do quadro original (cada Protocol tem o buffer de
+// dados e a fila de reprocessamento desse tamanho); para quadros estendidos
+// compilar com, por exemplo, -DMAX_EXT_DATA_SIZE=1024
+#ifndef MAX_EXT_DATA_SIZE
+#define MAX_EXT_DATA_SIZE MAX_DATA_SIZE
+#endif
+
+// Tamanho dos buffers de recepção: cabe o maior quadro de qualquer formato
+#define RX_BUFFER_SIZE (MAX_EXT_DATA_SIZE > MAX_DATA_SIZE ? MAX_EXT_DATA_SIZE : MAX_DATA_SIZE)
+
+// Número máximo de buffers no modo sem cópia (um bit de livre/ocupado por buffer)
+#define RX_POOL_MAX 32
+
+// Bytes de um quadro com erro que podem ser reprocessados: cabeçalho
+// (QTD ou LEN/MAX), dados, verificação e o byte que causou o erro
+#define RX_HEADER_SIZE (2 * MAX_LEN_BYTES)
+#define RX_REPLAY_SIZE (RX_HEADER_SIZE + RX_BUFFER_SIZE + CHECK_MAX_SIZE + 1)
+
+// Verificação usada por protocol_init(): CHECK_XOR8, CHECK_CRC16 ou CHECK_CRC32C
+#ifndef PROTOCOL_CHECK_DEFAULT
+#define PROTOCOL_CHECK_DEFAULT CHECK_XOR8
+#endif
+
 /**********************
  * MÁQUINA DE ESTADOS
  **********************/
@@ -18,6 +64,8 @@ typedef enum {
     // Estados do Receptor
     RX_WAIT_STX,
     RX_WAIT_QTD,
+    RX_WAIT_LEN,
+    RX_WAIT_MAX,
     RX_READ_DATA,
     RX_CHECK_CHK,
     RX_WAIT_ETX,
@@ -27,6 +75,7 @@ typedef enum {
     // Estados do Transmissor
     TX_SEND_STX,
     TX_SEND_QTD,
+    TX_SEND_LEN,
     TX_SEND_DATA,
     TX_SEND_CHK,
     TX_SEND_ETX,
@@ -34,71 +83,381 @@ typedef enum {
     TX_ERROR
 } ProtocolState;
 
+// Entrega de um quadro no modo sem cópia; o buffer passa a ser da aplicação
+// até ser devolvido com protocol_rx_release()
+typedef void (*FrameCallback)(void* context, uint8_t* data, uint16_t length);
+
 typedef struct {
+    // Verificação do quadro (XOR8, CRC-16 ou CRC-32C)
+    CheckType check_type;
+    
     // Receptor
     ProtocolState rx_state;
-    uint8_t rx_data[MAX_DATA_SIZE];
-    uint8_t rx_expected_bytes;
-    uint8_t rx_received_bytes;
-    uint8_t rx_calculated_chk;
+    uint8_t rx_data[RX_BUFFER_SIZE];
+    uint8_t* rx_buffer;          // destino dos dados: rx_data ou buffer emprestado
+    uint16_t rx_expected_bytes;
+    uint16_t rx_received_bytes;
+    uint32_t rx_calculated_chk;
+    uint8_t rx_chk_index;
+    uint8_t rx_header[RX_HEADER_SIZE];  // bytes aceitos depois do STX/SOH
+    uint8_t rx_header_len;
+    uint32_t rx_varint;          // LEN ou MAX sendo decodificado
+    uint8_t rx_varint_shift;
+    bool rx_announce;            // quadro atual é um anúncio de capacidade
+    
+    // Quadros estendidos: rx_ext_max == 0 aceita só o formato de 1 byte
+    uint16_t rx_ext_max;
+    uint16_t ext_peer_max;       // anunciado pelo outro lado (0: par antigo)
+    bool ext_peer_announced;     // anúncio recebido; a aplicação responde e limpa
+    
+    // Receptor sem cópia (rx_pool == NULL: usa rx_data)
+    uint8_t (*rx_pool)[RX_BUFFER_SIZE];
+    uint8_t rx_pool_size;
+    uint32_t rx_pool_free;       // bit i em 1: buffer i disponível
+    uint32_t rx_pool_exhausted;  // quadros perdidos por falta de buffer
+    FrameCallback rx_callback;
+    void* rx_callback_context;
+    
+    // Ressincronização automática após erro de enquadramento
+    bool rx_resync;
+    uint8_t rx_replay[RX_REPLAY_SIZE + 1];  // bytes a reprocessar antes da entrada
+    uint16_t rx_replay_len;
+    uint16_t rx_replay_pos;
+    uint32_t rx_frame_errors;    // quadros com checksum ou ETX inválido
+    uint32_t rx_dropped_bytes;   // bytes descartados fora de quadros válidos
     
     // Transmissor
     ProtocolState tx_state;
     const uint8_t* tx_data;
-    uint8_t tx_data_len;
-    uint8_t tx_sent_bytes;
-    uint8_t tx_calculated_chk;
+    uint16_t tx_data_len;
+    uint16_t tx_sent_bytes;
+    uint32_t tx_calculated_chk;
+    uint8_t tx_chk_index;
+    bool tx_extended;
+    uint8_t tx_header[RX_HEADER_SIZE];  // LEN (e MAX no anúncio) já codificados
+    uint8_t tx_header_len;
+    uint8_t tx_header_index;
 } Protocol;
 
 /**********************
  * FUNÇÕES AUXILIARES
  **********************/
 uint8_t calculate_checksum(const uint8_t* data, uint8_t length) {
-    uint8_t chk = 0;
-    for (uint8_t i = 0; i < length; i++) {
-        chk ^= data[i];
+    return checksum_xor8(data, length);
+}
+
+// Codifica 'value' como varint de 16 bits; retorna o número de bytes (1 a 3)
+uint8_t encode_varint(uint16_t value, uint8_t* out) {
+    uint8_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
     }
-    return chk;
+    out[n++] = (uint8_t)value;
+    return n;
 }
 
-void protocol_init(Protocol* proto) {
-    // Inicializa receptor
+/**********************
+ * BUFFERS DO MODO SEM CÓPIA
+ **********************/
+// Empresta um buffer livre do conjunto; NULL se todos estão com a aplicação
+uint8_t* protocol_rx_borrow(Protocol* proto) {
+    if (proto->rx_pool_free == 0) {
+        return NULL;
+    }
+    
+    uint8_t index = 0;
+    while ((proto->rx_pool_free & (1UL << index)) == 0) {
+        index++;
+    }
+    proto->rx_pool_free &= ~(1UL << index);
+    return proto->rx_pool[index];
+}
+
+// Devolve ao conjunto um buffer entregue pelo callback
+void protocol_rx_release(Protocol* proto, uint8_t* buffer) {
+    uint8_t index = (uint8_t)((buffer - proto->rx_pool[0]) / RX_BUFFER_SIZE);
+    if (index < proto->rx_pool_size) {
+        proto->rx_pool_free |= 1UL << index;
+    }
+}
+
+void protocol_rx_reset(Protocol* proto) {
+    // Quadro interrompido: o buffer emprestado volta para o conjunto
+    if (proto->rx_pool != NULL) {
+        if (proto->rx_buffer != NULL) {
+            protocol_rx_release(proto, proto->rx_buffer);
+        }
+        proto->rx_buffer = NULL;
+    } else {
+        proto->rx_buffer = proto->rx_data;
+    }
+    
     proto->rx_state = RX_WAIT_STX;
     proto->rx_received_bytes = 0;
     proto->rx_expected_bytes = 0;
     proto->rx_calculated_chk = 0;
+    proto->rx_chk_index = 0;
+    proto->rx_header_len = 0;
+    proto->rx_announce = false;
+}
+
+void protocol_init(Protocol* proto) {
+    proto->check_type = PROTOCOL_CHECK_DEFAULT;
+    
+    // Inicializa receptor
+    proto->rx_pool = NULL;
+    proto->rx_pool_size = 0;
+    proto->rx_pool_free = 0;
+    proto->rx_pool_exhausted = 0;
+    proto->rx_callback = NULL;
+    proto->rx_callback_context = NULL;
+    proto->rx_resync = false;
+    proto->rx_replay_len = 0;
+    proto->rx_replay_pos = 0;
+    proto->rx_frame_errors = 0;
+    proto->rx_dropped_bytes = 0;
+    proto->rx_ext_max = 0;
+    proto->ext_peer_max = 0;
+    proto->ext_peer_announced = false;
+    protocol_rx_reset(proto);
     
     // Inicializa transmissor
     proto->tx_state = TX_SEND_STX;
     proto->tx_sent_bytes = 0;
     proto->tx_calculated_chk = 0;
+    proto->tx_chk_index = 0;
     proto->tx_data = NULL;
     proto->tx_data_len = 0;
+    proto->tx_extended = false;
+    proto->tx_header_len = 0;
+}
+
+// Troca a verificação do quadro; as duas pontas devem usar a mesma
+void protocol_set_check(Protocol* proto, CheckType type) {
+    proto->check_type = type;
+}
+
+/*
+ * Ativa o modo sem cópia: os dados de cada quadro são escritos direto em um
+ * dos 'count' buffers da aplicação e entregues a 'callback' no ETX. O
+ * receptor volta a RX_WAIT_STX logo em seguida, com o próximo buffer livre,
+ * enquanto a aplicação processa o quadro anterior. Sem buffer livre o
+ * quadro vai para RX_ERROR e é contado em rx_pool_exhausted.
+ * O conjunto é controlado por um único contexto (sem proteção entre
+ * interrupção e tarefa).
+ */
+void protocol_rx_set_pool(Protocol* proto, uint8_t (*buffers)[RX_BUFFER_SIZE], uint8_t count,
+                          FrameCallback callback, void* context) {
+    if (count > RX_POOL_MAX) {
+        count = RX_POOL_MAX;
+    }
+    
+    proto->rx_pool = NULL;
+    protocol_rx_reset(proto);
+    
+    proto->rx_pool = buffers;
+    proto->rx_pool_size = count;
+    proto->rx_pool_free = (count == RX_POOL_MAX) ? 0xFFFFFFFFUL : (1UL << count) - 1;
+    proto->rx_callback = callback;
+    proto->rx_callback_context = context;
+    proto->rx_buffer = NULL;
+}
+
+/*
+ * Quadros estendidos: passa a aceitar quadros SOH de até 'max' bytes
+ * (limitado a RX_BUFFER_SIZE; 0 volta a aceitar só o formato de 1 byte).
+ * O outro lado só os envia depois de receber protocol_tx_announce().
+ */
+void protocol_set_ext_max(Protocol* proto, uint16_t max) {
+    proto->rx_ext_max = (max > RX_BUFFER_SIZE) ? RX_BUFFER_SIZE : max;
+}
+
+// Maior quadro que pode ser transmitido ao outro lado
+uint16_t protocol_tx_max(Protocol* proto) {
+    if (proto->rx_ext_max == 0 || proto->ext_peer_max <= MAX_DATA_SIZE) {
+        return MAX_DATA_SIZE;
+    }
+    return proto->ext_peer_max;
+}
+
+/*
+ * Ressincronização automática: em vez de ficar em RX_ERROR até
+ * protocol_init(), um quadro com checksum ou ETX inválido é descartado e os
+ * bytes recebidos depois do seu STX são reprocessados, procurando o próximo
+ * STX candidato. Um quadro válido que chegou "dentro" do quadro corrompido
+ * (por exemplo, depois de um QTD corrompido) não é perdido.
+ */
+void protocol_set_resync(Protocol* proto, bool enable) {
+    proto->rx_resync = enable;
+}
+
+bool protocol_rx_step(Protocol* proto, uint8_t byte);
+
+// Erro de enquadramento no byte 'byte'
+void protocol_rx_fail(Protocol* proto, uint8_t byte) {
+    proto->rx_frame_errors++;
+    
+    if (!proto->rx_resync) {
+        proto->rx_state = RX_ERROR;
+        return;
+    }
+    
+    // Remonta na própria fila os bytes do quadro depois do STX, seguidos do
+    // que ainda faltava reprocessar de um erro anterior: primeiro o resto da
+    // fila vai para o seu lugar, depois cabeçalho, dados (de rx_buffer),
+    // verificação e o byte do erro entram na frente. Se o quadro veio da
+    // fila, os seus bytes já consumidos ocupam pelo menos esse espaço, então
+    // o resto só anda para trás; senão a fila estava vazia
+    bool with_data = (proto->rx_state == RX_CHECK_CHK || proto->rx_state == RX_WAIT_ETX);
+    size_t n = proto->rx_header_len + 1u;
+    if (with_data) {
+        n += proto->rx_received_bytes + proto->rx_chk_index;
+    }
+    size_t remaining = proto->rx_replay_len - proto->rx_replay_pos;
+    memmove(&proto->rx_replay[n], &proto->rx_replay[proto->rx_replay_pos], remaining);
+    proto->rx_replay_len = (uint16_t)(n + remaining);
+    proto->rx_replay_pos = 0;
+    
+    n = proto->rx_header_len;
+    memcpy(proto->rx_replay, proto->rx_header, n);
+    if (with_data) {
+        uint32_t value = check_final(proto->check_type, proto->rx_calculated_chk);
+        memcpy(&proto->rx_replay[n], proto->rx_buffer, proto->rx_received_bytes);
+        n += proto->rx_received_bytes;
+        for (uint8_t i = 0; i < proto->rx_chk_index; i++) {
+            proto->rx_replay[n++] = check_byte(proto->check_type, value, i);
+        }
+    }
+    proto->rx_replay[n] = byte;
+    
+    // O STX (ou SOH) do quadro com erro é descartado
+    proto->rx_dropped_bytes++;
+    protocol_rx_reset(proto);
+}
+
+// Busca em bloco pelo próximo STX (ou SOH); retorna a posição ou 'length'
+size_t protocol_rx_hunt(Protocol* proto, const uint8_t* data, size_t length) {
+    const uint8_t* stx = memchr(data, STX, length);
+    size_t skipped = (stx != NULL) ? (size_t)(stx - data) : length;
+    
+    if (proto->rx_ext_max > 0) {
+        const uint8_t* soh = memchr(data, SOH, skipped);
+        if (soh != NULL) {
+            skipped = (size_t)(soh - data);
+        }
+    }
+    
+    proto->rx_dropped_bytes += (uint32_t)skipped;
+    return skipped;
+}
+
+// Reprocessa os bytes pendentes; para ao completar um quadro
+bool protocol_rx_replay(Protocol* proto) {
+    while (proto->rx_replay_pos < proto->rx_replay_len) {
+        if (proto->rx_state == RX_DONE) {
+            return true;
+        }
+        if (proto->rx_state == RX_WAIT_STX) {
+            proto->rx_replay_pos += (uint16_t)protocol_rx_hunt(proto, &proto->rx_replay[proto->rx_replay_pos],
+                                                               proto->rx_replay_len - proto->rx_replay_pos);
+            if (proto->rx_replay_pos >= proto->rx_replay_len) {
+                break;
+            }
+        }
+        if (protocol_rx_step(proto, proto->rx_replay[proto->rx_replay_pos++])) {
+            return true;
+        }
+    }
+    
+    proto->rx_replay_len = 0;
+    proto->rx_replay_pos = 0;
+    return false;
+}
+
+// Tamanho do quadro conhecido: reserva o buffer e segue para os dados
+void protocol_rx_begin_data(Protocol* proto, uint16_t length, uint8_t byte) {
+    if (proto->rx_pool != NULL && proto->rx_buffer == NULL) {
+        proto->rx_buffer = protocol_rx_borrow(proto);
+        if (proto->rx_buffer == NULL) {
+            proto->rx_pool_exhausted++;
+            protocol_rx_fail(proto, byte);
+            return;
+        }
+    }
+    proto->rx_header[proto->rx_header_len++] = byte;
+    proto->rx_expected_bytes = length;
+    proto->rx_received_bytes = 0;
+    // Quadro sem dados vai direto para o checksum
+    proto->rx_state = (length == 0) ? RX_CHECK_CHK : RX_READ_DATA;
+    proto->rx_calculated_chk = check_update_byte(proto->check_type, proto->rx_calculated_chk, byte);
+    proto->rx_chk_index = 0;
+}
+
+// Um byte de varint (LEN ou MAX); retorna true no último byte
+bool protocol_rx_varint(Protocol* proto, uint8_t byte) {
+    proto->rx_varint |= (uint32_t)(byte & 0x7F) << proto->rx_varint_shift;
+    proto->rx_varint_shift += 7;
+    return (byte & 0x80) == 0 || proto->rx_varint_shift >= 7 * MAX_LEN_BYTES;
 }
 
 /**********************
  * RECEPTOR (Máquina de Estados)
  **********************/
-bool protocol_rx_byte(Protocol* proto, uint8_t byte) {
+bool protocol_rx_step(Protocol* proto, uint8_t byte) {
     switch (proto->rx_state) {
         case RX_WAIT_STX:
             if (byte == STX) {
                 proto->rx_state = RX_WAIT_QTD;
-                proto->rx_calculated_chk = byte;
+                proto->rx_calculated_chk = check_update_byte(proto->check_type, check_init(proto->check_type), byte);
+            } else if (byte == SOH && proto->rx_ext_max > 0) {
+                proto->rx_state = RX_WAIT_LEN;
+                proto->rx_varint = 0;
+                proto->rx_varint_shift = 0;
+                proto->rx_calculated_chk = check_update_byte(proto->check_type, check_init(proto->check_type), byte);
+            } else {
+                proto->rx_dropped_bytes++;
             }
             break;
             
         case RX_WAIT_QTD:
-            proto->rx_expected_bytes = byte;
-            proto->rx_received_bytes = 0;
-            proto->rx_state = RX_READ_DATA;
-            proto->rx_calculated_chk ^= byte;
+            protocol_rx_begin_data(proto, byte, byte);
+            break;
+            
+        case RX_WAIT_LEN:
+            if (!protocol_rx_varint(proto, byte)) {
+                proto->rx_header[proto->rx_header_len++] = byte;
+                proto->rx_calculated_chk = check_update_byte(proto->check_type, proto->rx_calculated_chk, byte);
+            } else if (proto->rx_varint == 0 && (byte & 0x80) == 0) {
+                // LEN = 0: anúncio de capacidade, segue o MAX
+                proto->rx_header[proto->rx_header_len++] = byte;
+                proto->rx_calculated_chk = check_update_byte(proto->check_type, proto->rx_calculated_chk, byte);
+                proto->rx_announce = true;
+                proto->rx_varint_shift = 0;
+                proto->rx_state = RX_WAIT_MAX;
+            } else if ((byte & 0x80) != 0 || proto->rx_varint > proto->rx_ext_max) {
+                // Varint longo demais ou quadro maior que o aceito
+                protocol_rx_fail(proto, byte);
+            } else {
+                protocol_rx_begin_data(proto, (uint16_t)proto->rx_varint, byte);
+            }
+            break;
+            
+        case RX_WAIT_MAX:
+            proto->rx_header[proto->rx_header_len++] = byte;
+            proto->rx_calculated_chk = check_update_byte(proto->check_type, proto->rx_calculated_chk, byte);
+            if (protocol_rx_varint(proto, byte)) {
+                proto->rx_expected_bytes = 0;
+                proto->rx_received_bytes = 0;
+                proto->rx_chk_index = 0;
+                proto->rx_state = RX_CHECK_CHK;
+            }
             break;
             
         case RX_READ_DATA:
-            if (proto->rx_received_bytes < MAX_DATA_SIZE) {
-                proto->rx_data[proto->rx_received_bytes++] = byte;
-                proto->rx_calculated_chk ^= byte;
+            if (proto->rx_received_bytes < RX_BUFFER_SIZE) {
+                proto->rx_buffer[proto->rx_received_bytes++] = byte;
+                proto->rx_calculated_chk = check_update_byte(proto->check_type, proto->rx_calculated_chk, byte);
                 if (proto->rx_received_bytes >= proto->rx_expected_bytes) {
                     proto->rx_state = RX_CHECK_CHK;
                 }
@@ -108,19 +467,37 @@ bool protocol_rx_byte(Protocol* proto, uint8_t byte) {
             break;
             
         case RX_CHECK_CHK:
-            if (proto->rx_calculated_chk == byte) {
-                proto->rx_state = RX_WAIT_ETX;
+            // Confere um byte da verificação por chamada (1, 2 ou 4 bytes)
+            if (check_byte(proto->check_type, check_final(proto->check_type, proto->rx_calculated_chk),
+                           proto->rx_chk_index) == byte) {
+                if (++proto->rx_chk_index >= check_size(proto->check_type)) {
+                    proto->rx_state = RX_WAIT_ETX;
+                }
             } else {
-                proto->rx_state = RX_ERROR;
+                protocol_rx_fail(proto, byte);
             }
             break;
             
         case RX_WAIT_ETX:
-            if (byte == ETX) {
+            if (byte == ETX && proto->rx_announce) {
+                // Anúncio do outro lado: não é entregue como quadro de dados
+                proto->ext_peer_max = (proto->rx_varint > 0xFFFF) ? 0xFFFF : (uint16_t)proto->rx_varint;
+                proto->ext_peer_announced = true;
+                protocol_rx_reset(proto);
+            } else if (byte == ETX) {
+                if (proto->rx_callback != NULL) {
+                    // Modo sem cópia: entrega o buffer e já aguarda o próximo quadro
+                    uint8_t* buffer = proto->rx_buffer;
+                    uint16_t length = proto->rx_received_bytes;
+                    proto->rx_buffer = NULL;
+                    protocol_rx_reset(proto);
+                    proto->rx_callback(proto->rx_callback_context, buffer, length);
+                    return true;
+                }
                 proto->rx_state = RX_DONE;
                 return true;
             } else {
-                proto->rx_state = RX_ERROR;
+                protocol_rx_fail(proto, byte);
             }
             break;
             
@@ -136,36 +513,172 @@ bool protocol_rx_byte(Protocol* proto, uint8_t byte) {
     return false;
 }
 
+bool protocol_rx_byte(Protocol* proto, uint8_t byte) {
+    if (proto->rx_replay_len == 0 || proto->rx_state == RX_DONE) {
+        // Um erro neste byte carrega a fila de bytes a reprocessar. Com um
+        // quadro já entregue e ainda não reinicializado o byte é ignorado,
+        // como no modo original; a fila só anda depois de protocol_rx_reset()
+        return protocol_rx_step(proto, byte) ||
+               (proto->rx_replay_len > 0 && protocol_rx_replay(proto));
+    }
+    
+    // Ainda há bytes de um quadro com erro: o novo byte entra na fila atrás deles
+    memmove(proto->rx_replay, &proto->rx_replay[proto->rx_replay_pos],
+            proto->rx_replay_len - proto->rx_replay_pos);
+    proto->rx_replay_len -= proto->rx_replay_pos;
+    proto->rx_replay_pos = 0;
+    proto->rx_replay[proto->rx_replay_len++] = byte;
+    
+    return protocol_rx_replay(proto);
+}
+
+/*
+ * Recebe um bloco de bytes de uma vez.
+ * Os dados do quadro (RX_READ_DATA) são copiados com um único memcpy e a
+ * verificação é calculada sobre o bloco inteiro; os demais estados usam
+ * protocol_rx_byte(). Retorna true ao completar um quadro e para logo após
+ * o ETX, informando em *consumed quantos bytes foram usados, para que o
+ * restante do buffer seja passado na próxima chamada. Um quadro pode ser
+ * dividido em vários buffers. Se chamada com um quadro já entregue
+ * (RX_DONE), inicia a recepção do próximo. A espera pelo STX é uma busca
+ * em bloco (memchr) em vez de um byte por vez.
+ */
+bool protocol_rx_buffer(Protocol* proto, const uint8_t* data, size_t length, size_t* consumed) {
+    size_t pos = 0;
+    
+    if (proto->rx_state == RX_DONE) {
+        protocol_rx_reset(proto);
+    }
+    
+    // Bytes pendentes de uma ressincronização vêm antes do bloco novo
+    if (proto->rx_replay_len > 0 && protocol_rx_replay(proto)) {
+        *consumed = 0;
+        return true;
+    }
+    
+    while (pos < length) {
+        if (proto->rx_state == RX_READ_DATA) {
+            size_t pending = proto->rx_expected_bytes - proto->rx_received_bytes;
+            size_t block = (length - pos < pending) ? length - pos : pending;
+            
+            memcpy(&proto->rx_buffer[proto->rx_received_bytes], &data[pos], block);
+            proto->rx_calculated_chk = check_update(proto->check_type, proto->rx_calculated_chk, &data[pos], block);
+            proto->rx_received_bytes += (uint16_t)block;
+            pos += block;
+            
+            if (proto->rx_received_bytes >= proto->rx_expected_bytes) {
+                proto->rx_state = RX_CHECK_CHK;
+            }
+        } else if (proto->rx_state == RX_WAIT_STX) {
+            pos += protocol_rx_hunt(proto, &data[pos], length - pos);
+            if (pos < length) {
+                protocol_rx_step(proto, data[pos++]);
+            }
+        } else if (proto->rx_state == RX_ERROR) {
+            // Mantém no estado de erro até ser reinicializado, descartando o bloco
+            pos = length;
+        } else if (protocol_rx_step(proto, data[pos++]) ||
+                   (proto->rx_replay_len > 0 && protocol_rx_replay(proto))) {
+            *consumed = pos;
+            return true;
+        }
+    }
+    
+    *consumed = pos;
+    return false;
+}
+
+/*
+ * Drena a fila circular preenchida pela interrupção da UART, passando cada
+ * trecho contínuo direto para protocol_rx_buffer(), sem cópia intermediária.
+ * Retorna true ao completar um quadro; os bytes seguintes ficam na fila
+ * para a próxima chamada.
+ */
+bool protocol_rx_ring(Protocol* proto, RingBuffer* ring) {
+    const uint8_t* span;
+    size_t length;
+    size_t consumed;
+    
+    // Quadro completo que ficou nos bytes de uma ressincronização
+    if (proto->rx_replay_len > 0 && protocol_rx_buffer(proto, NULL, 0, &consumed)) {
+        return true;
+    }
+    
+    while ((length = ring_peek_span(ring, &span)) > 0) {
+        bool done = protocol_rx_buffer(proto, span, length, &consumed);
+        ring_consume(ring, consumed);
+        if (done) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**********************
  * TRANSMISSOR (Máquina de Estados)
  **********************/
-void protocol_tx_begin(Protocol* proto, const uint8_t* data, uint8_t length) {
+/*
+ * Prepara a transmissão de 'length' bytes. Até 255 bytes usa o formato
+ * original; acima disso, o quadro estendido, se o outro lado anunciou
+ * suporte. Sem suporte (ou acima do máximo anunciado) vai para TX_ERROR.
+ */
+void protocol_tx_begin(Protocol* proto, const uint8_t* data, uint16_t length) {
     proto->tx_state = TX_SEND_STX;
     proto->tx_data = data;
     proto->tx_data_len = length;
     proto->tx_sent_bytes = 0;
     proto->tx_calculated_chk = 0;
+    proto->tx_chk_index = 0;
+    proto->tx_extended = length > MAX_DATA_SIZE;
+    proto->tx_header_len = 0;
+    proto->tx_header_index = 0;
+    
+    if (proto->tx_extended) {
+        if (length > protocol_tx_max(proto)) {
+            proto->tx_state = TX_ERROR;
+            return;
+        }
+        proto->tx_header_len = encode_varint(length, proto->tx_header);
+    }
+}
+
+// Prepara o anúncio de capacidade (SOH 0x00 MAX CHK ETX) com rx_ext_max
+void protocol_tx_announce(Protocol* proto) {
+    protocol_tx_begin(proto, NULL, 0);
+    proto->tx_extended = true;
+    proto->tx_header[0] = 0x00;
+    proto->tx_header_len = 1 + encode_varint(proto->rx_ext_max, &proto->tx_header[1]);
 }
 
 bool protocol_tx_byte(Protocol* proto, uint8_t* byte) {
     switch (proto->tx_state) {
         case TX_SEND_STX:
-            *byte = STX;
-            proto->tx_calculated_chk = *byte;
-            proto->tx_state = TX_SEND_QTD;
+            *byte = proto->tx_extended ? SOH : STX;
+            proto->tx_calculated_chk = check_update_byte(proto->check_type, check_init(proto->check_type), *byte);
+            proto->tx_state = proto->tx_extended ? TX_SEND_LEN : TX_SEND_QTD;
             return false;
             
         case TX_SEND_QTD:
-            *byte = proto->tx_data_len;
-            proto->tx_calculated_chk ^= *byte;
-            proto->tx_state = TX_SEND_DATA;
+            *byte = (uint8_t)proto->tx_data_len;
+            proto->tx_calculated_chk = check_update_byte(proto->check_type, proto->tx_calculated_chk, *byte);
+            // Quadro sem dados vai direto para o checksum
+            proto->tx_state = (proto->tx_data_len == 0) ? TX_SEND_CHK : TX_SEND_DATA;
             proto->tx_sent_bytes = 0;
+            proto->tx_chk_index = 0;
+            return false;
+            
+        case TX_SEND_LEN:
+            *byte = proto->tx_header[proto->tx_header_index++];
+            proto->tx_calculated_chk = check_update_byte(proto->check_type, proto->tx_calculated_chk, *byte);
+            if (proto->tx_header_index >= proto->tx_header_len) {
+                proto->tx_state = (proto->tx_data_len == 0) ? TX_SEND_CHK : TX_SEND_DATA;
+            }
             return false;
             
         case TX_SEND_DATA:
             if (proto->tx_sent_bytes < proto->tx_data_len) {
                 *byte = proto->tx_data[proto->tx_sent_bytes++];
-                proto->tx_calculated_chk ^= *byte;
+                proto->tx_calculated_chk = check_update_byte(proto->check_type, proto->tx_calculated_chk, *byte);
                 if (proto->tx_sent_bytes >= proto->tx_data_len) {
                     proto->tx_state = TX_SEND_CHK;
                 }
@@ -174,8 +687,12 @@ bool protocol_tx_byte(Protocol* proto, uint8_t* byte) {
             break;
             
         case TX_SEND_CHK:
-            *byte = proto->tx_calculated_chk;
-            proto->tx_state = TX_SEND_ETX;
+            // Envia um byte da verificação por chamada, MSB primeiro
+            *byte = check_byte(proto->check_type, check_final(proto->check_type, proto->tx_calculated_chk),
+                               proto->tx_chk_index++);
+            if (proto->tx_chk_index >= check_size(proto->check_type)) {
+                proto->tx_state = TX_SEND_ETX;
+            }
             return false;
             
         case TX_SEND_ETX:
@@ -412,6 +929,552 @@ void test_full_cycle() {
     printf("Ciclo completo TX/RX bem-sucedido ✓\n");
 }
 
+// Monta um quadro completo usando o transmissor; retorna o tamanho do quadro
+size_t encode_frame_check(CheckType type, const uint8_t* data, uint8_t length, uint8_t* out) {
+    Protocol proto;
+    protocol_init(&proto);
+    protocol_set_check(&proto, type);
+    protocol_tx_begin(&proto, data, length);
+    
+    size_t n = 0;
+    while (!protocol_tx_byte(&proto, &out[n++])) {
+    }
+    return n;
+}
+
+size_t encode_frame(const uint8_t* data, uint8_t length, uint8_t* out) {
+    return encode_frame_check(PROTOCOL_CHECK_DEFAULT, data, length, out);
+}
+
+void test_rx_empty_packet() {
+    printf("\n=== Teste RX: Pacote sem dados ===\n");
+    
+    uint8_t frame[8];
+    size_t frame_len = encode_frame(NULL, 0, frame);
+    assert(frame_len == 4);
+    
+    Protocol proto;
+    protocol_init(&proto);
+    bool complete = false;
+    for (size_t i = 0; i < frame_len; i++) {
+        complete = protocol_rx_byte(&proto, frame[i]);
+    }
+    assert(complete == true);
+    assert(proto.rx_received_bytes == 0);
+    
+    size_t consumed;
+    protocol_init(&proto);
+    assert(protocol_rx_buffer(&proto, frame, frame_len, &consumed) == true);
+    assert(consumed == frame_len);
+    assert(proto.rx_received_bytes == 0);
+    
+    printf("Pacote sem dados recebido pelos dois caminhos ✓\n");
+}
+
+void test_rx_buffer_single() {
+    printf("\n=== Teste RX em bloco: Pacote inteiro ===\n");
+    
+    uint8_t data[MAX_DATA_SIZE];
+    for (int i = 0; i < MAX_DATA_SIZE; i++) {
+        data[i] = (uint8_t)(i * 7 + 1);
+    }
+    
+    uint8_t stream[2 * (MAX_DATA_SIZE + 4)];
+    size_t frame_len = encode_frame(data, MAX_DATA_SIZE, stream);
+    
+    // Lixo depois do ETX não pode ser consumido
+    stream[frame_len] = 0xAA;
+    
+    Protocol proto;
+    protocol_init(&proto);
+    size_t consumed;
+    assert(protocol_rx_buffer(&proto, stream, frame_len + 1, &consumed) == true);
+    assert(consumed == frame_len);
+    assert(proto.rx_state == RX_DONE);
+    assert(proto.rx_received_bytes == MAX_DATA_SIZE);
+    assert(memcmp(proto.rx_data, data, MAX_DATA_SIZE) == 0);
+    
+    printf("Pacote de %d bytes recebido em uma chamada ✓\n", MAX_DATA_SIZE);
+}
+
+void test_rx_buffer_split() {
+    printf("\n=== Teste RX em bloco: Pacotes divididos em vários buffers ===\n");
+    
+    uint8_t first[] = {0x10, 0x20, 0x30, 0x40, 0x50};
+    uint8_t second[] = {0x03, 0x02, 0x01};
+    uint8_t stream[32];
+    size_t stream_len = encode_frame(first, sizeof(first), stream);
+    stream_len += encode_frame(second, sizeof(second), &stream[stream_len]);
+    
+    // Testa todos os tamanhos de fatia, inclusive byte a byte
+    for (size_t chunk = 1; chunk <= stream_len; chunk++) {
+        Protocol proto;
+        protocol_init(&proto);
+        int frames = 0;
+        
+        for (size_t offset = 0; offset < stream_len; offset += chunk) {
+            size_t length = (stream_len - offset < chunk) ? stream_len - offset : chunk;
+            const uint8_t* ptr = &stream[offset];
+            
+            while (length > 0) {
+                size_t consumed;
+                bool done = protocol_rx_buffer(&proto, ptr, length, &consumed);
+                ptr += consumed;
+                length -= consumed;
+                
+                if (done) {
+                    if (frames == 0) {
+                        assert(proto.rx_received_bytes == sizeof(first));
+                        assert(memcmp(proto.rx_data, first, sizeof(first)) == 0);
+                    } else {
+                        assert(proto.rx_received_bytes == sizeof(second));
+                        assert(memcmp(proto.rx_data, second, sizeof(second)) == 0);
+                    }
+                    frames++;
+                }
+            }
+        }
+        assert(frames == 2);
+    }
+    
+    printf("Dois pacotes recebidos com todas as divisões de buffer ✓\n");
+}
+
+void test_rx_buffer_invalid_checksum() {
+    printf("\n=== Teste RX em bloco: Checksum inválido ===\n");
+    
+    uint8_t invalid_packet[] = {STX, 0x02, 0x01, 0x02, 0x00, ETX}; // CHK errado
+    
+    Protocol proto;
+    protocol_init(&proto);
+    size_t consumed;
+    assert(protocol_rx_buffer(&proto, invalid_packet, sizeof(invalid_packet), &consumed) == false);
+    assert(consumed == sizeof(invalid_packet));
+    assert(proto.rx_state == RX_ERROR);
+    
+    printf("Pacote com checksum inválido rejeitado corretamente ✓\n");
+}
+
+void test_check_modes() {
+    printf("\n=== Teste verificação XOR8 / CRC-16 / CRC-32C ===\n");
+    
+    const CheckType types[] = {CHECK_XOR8, CHECK_CRC16, CHECK_CRC32C};
+    uint8_t data[] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90};
+    
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        uint8_t frame[32];
+        size_t frame_len = encode_frame_check(types[t], data, sizeof(data), frame);
+        assert(frame_len == 3 + sizeof(data) + check_size(types[t]));
+        assert(frame[frame_len - 1] == ETX);
+        
+        // Byte a byte
+        Protocol proto;
+        protocol_init(&proto);
+        protocol_set_check(&proto, types[t]);
+        bool complete = false;
+        for (size_t i = 0; i < frame_len; i++) {
+            complete = protocol_rx_byte(&proto, frame[i]);
+        }
+        assert(complete == true);
+        assert(memcmp(proto.rx_data, data, sizeof(data)) == 0);
+        
+        // Em bloco
+        size_t consumed;
+        protocol_init(&proto);
+        protocol_set_check(&proto, types[t]);
+        assert(protocol_rx_buffer(&proto, frame, frame_len, &consumed) == true);
+        assert(consumed == frame_len);
+        assert(memcmp(proto.rx_data, data, sizeof(data)) == 0);
+        
+        // Dois bytes de dados trocados de posição: o XOR não percebe, os CRCs sim
+        uint8_t swapped = frame[3];
+        frame[3] = frame[4];
+        frame[4] = swapped;
+        protocol_init(&proto);
+        protocol_set_check(&proto, types[t]);
+        complete = protocol_rx_buffer(&proto, frame, frame_len, &consumed);
+        assert(complete == (types[t] == CHECK_XOR8));
+        
+        printf("Verificação de %u byte(s) OK, troca de bytes %s ✓\n",
+               check_size(types[t]), complete ? "não detectada" : "detectada");
+    }
+}
+
+typedef struct {
+    uint8_t* frames[4];
+    uint8_t lengths[4];
+    int count;
+} ZeroCopyLog;
+
+void zero_copy_collect(void* context, uint8_t* data, uint16_t length) {
+    ZeroCopyLog* log = (ZeroCopyLog*)context;
+    log->frames[log->count] = data;
+    log->lengths[log->count] = length;
+    log->count++;
+}
+
+void test_rx_zero_copy() {
+    printf("\n=== Teste RX sem cópia: buffers da aplicação ===\n");
+    
+    static uint8_t pool[2][RX_BUFFER_SIZE];
+    uint8_t first[] = {0x11, 0x22, 0x33};
+    uint8_t second[] = {0x44, 0x55};
+    uint8_t third[] = {0x66};
+    uint8_t stream[64];
+    size_t len1 = encode_frame(first, sizeof(first), stream);
+    size_t len2 = encode_frame(second, sizeof(second), &stream[len1]);
+    size_t len3 = encode_frame(third, sizeof(third), &stream[len1 + len2]);
+    
+    Protocol proto;
+    ZeroCopyLog log = {{NULL}, {0}, 0};
+    protocol_init(&proto);
+    protocol_rx_set_pool(&proto, pool, 2, zero_copy_collect, &log);
+    
+    // Dois quadros seguidos em um único bloco: cada um em um buffer do conjunto
+    size_t pos = 0;
+    while (pos < len1 + len2) {
+        size_t consumed;
+        protocol_rx_buffer(&proto, &stream[pos], len1 + len2 - pos, &consumed);
+        pos += consumed;
+    }
+    assert(log.count == 2);
+    assert(log.frames[0] == pool[0] && log.lengths[0] == sizeof(first));
+    assert(log.frames[1] == pool[1] && log.lengths[1] == sizeof(second));
+    assert(memcmp(log.frames[0], first, sizeof(first)) == 0);
+    assert(memcmp(log.frames[1], second, sizeof(second)) == 0);
+    assert(proto.rx_state == RX_WAIT_STX);
+    
+    // Os dois buffers continuam com a aplicação: o terceiro quadro é perdido
+    size_t consumed;
+    assert(protocol_rx_buffer(&proto, &stream[pos], len3, &consumed) == false);
+    assert(proto.rx_state == RX_ERROR);
+    assert(proto.rx_pool_exhausted == 1);
+    
+    // Devolvido um buffer, o terceiro quadro é recebido nele
+    protocol_rx_release(&proto, log.frames[0]);
+    protocol_rx_reset(&proto);
+    for (size_t i = 0; i < len3; i++) {
+        protocol_rx_byte(&proto, stream[pos + i]);
+    }
+    assert(log.count == 3);
+    assert(log.frames[2] == pool[0] && log.lengths[2] == sizeof(third));
+    assert(log.frames[2][0] == 0x66);
+    
+    printf("Quadros entregues nos buffers da aplicação sem cópia ✓\n");
+}
+
+void test_rx_ring() {
+    printf("\n=== Teste RX pela fila circular da UART ===\n");
+    
+    uint8_t storage[16];
+    RingBuffer ring;
+    ring_init(&ring, storage, sizeof(storage));
+    
+    uint8_t data[] = {0x61, 0x62, 0x63, 0x64, 0x65, 0x66};
+    uint8_t frame[16];
+    size_t frame_len = encode_frame(data, sizeof(data), frame);
+    
+    Protocol proto;
+    protocol_init(&proto);
+    
+    // Três quadros passando por uma fila de 16 bytes: os trechos dão a volta no vetor
+    int frames = 0;
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < frame_len; i++) {
+            assert(ring_push(&ring, frame[i]));   // papel da interrupção
+            if (protocol_rx_ring(&proto, &ring)) {
+                assert(proto.rx_received_bytes == sizeof(data));
+                assert(memcmp(proto.rx_data, data, sizeof(data)) == 0);
+                frames++;
+            }
+        }
+    }
+    assert(frames == 3);
+    assert(ring_count(&ring) == 0);
+    assert(ring_overflows(&ring) == 0);
+    
+    printf("Três quadros recebidos pela fila circular ✓\n");
+}
+
+/*
+ * Recebe 'stream' inteiro com ressincronização ligada, em blocos de 'chunk'
+ * bytes (0 = byte a byte), e guarda o tamanho de cada quadro recebido
+ */
+int receive_with_resync(Protocol* proto, const uint8_t* stream, size_t stream_len, size_t chunk,
+                        uint8_t* lengths, uint8_t (*frames)[MAX_DATA_SIZE]) {
+    int count = 0;
+    
+    protocol_init(proto);
+    protocol_set_resync(proto, true);
+    
+    if (chunk == 0) {
+        for (size_t i = 0; i < stream_len; i++) {
+            if (protocol_rx_byte(proto, stream[i])) {
+                lengths[count] = proto->rx_received_bytes;
+                memcpy(frames[count++], proto->rx_data, proto->rx_received_bytes);
+                protocol_rx_reset(proto);
+            }
+        }
+        return count;
+    }
+    
+    for (size_t offset = 0; offset < stream_len; offset += chunk) {
+        size_t block = (stream_len - offset < chunk) ? stream_len - offset : chunk;
+        size_t pos = 0;
+        size_t consumed;
+        
+        // Repete até não haver mais quadros, inclusive nos bytes reprocessados
+        while (protocol_rx_buffer(proto, &stream[offset + pos], block - pos, &consumed)) {
+            lengths[count] = proto->rx_received_bytes;
+            memcpy(frames[count++], proto->rx_data, proto->rx_received_bytes);
+            pos += consumed;
+        }
+    }
+    return count;
+}
+
+void test_rx_resync() {
+    printf("\n=== Teste ressincronização após erro de enquadramento ===\n");
+    
+    uint8_t first[] = {0x10, 0x11, 0x12};
+    uint8_t second[] = {0x20, 0x21, 0x22, 0x23};
+    uint8_t third[] = {0x30, 0x31};
+    uint8_t stream[64];
+    uint8_t lengths[4];
+    uint8_t frames[4][MAX_DATA_SIZE];
+    
+    // A + B com checksum corrompido + C
+    size_t len_a = encode_frame(first, sizeof(first), stream);
+    size_t len_b = encode_frame(second, sizeof(second), &stream[len_a]);
+    size_t len_c = encode_frame(third, sizeof(third), &stream[len_a + len_b]);
+    size_t stream_len = len_a + len_b + len_c;
+    stream[len_a + len_b - 2] ^= 0xFF;
+    
+    const size_t chunks[] = {0, 1, 5, sizeof(stream)};
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        Protocol proto;
+        int count = receive_with_resync(&proto, stream, stream_len, chunks[c], lengths, frames);
+        assert(count == 2);
+        assert(lengths[0] == sizeof(first) && memcmp(frames[0], first, sizeof(first)) == 0);
+        assert(lengths[1] == sizeof(third) && memcmp(frames[1], third, sizeof(third)) == 0);
+        assert(proto.rx_frame_errors == 1);
+        // STX, QTD, dados e CHK de B; o ETX de B é reprocessado e descartado
+        assert(proto.rx_dropped_bytes == len_b);
+    }
+    printf("Quadro corrompido descartado, o seguinte recebido ✓\n");
+    
+    // QTD corrompido "engole" o quadro seguinte: C é recuperado dos bytes reprocessados
+    size_t len = encode_frame(first, sizeof(first), stream);
+    stream[1] = 20;
+    size_t filler = len + encode_frame(third, sizeof(third), &stream[len]);
+    while (filler < 2 + 20 + 1) {
+        stream[filler++] = 0x55;
+    }
+    stream_len = filler;
+    
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        Protocol proto;
+        int count = receive_with_resync(&proto, stream, stream_len, chunks[c], lengths, frames);
+        assert(count == 1);
+        assert(lengths[0] == sizeof(third) && memcmp(frames[0], third, sizeof(third)) == 0);
+        assert(proto.rx_frame_errors == 1);
+        assert(proto.rx_state == RX_WAIT_STX);
+    }
+    printf("Quadro dentro de um QTD corrompido recuperado ✓\n");
+    
+    // Sem ressincronização o receptor continua parando em RX_ERROR
+    Protocol proto;
+    protocol_init(&proto);
+    for (size_t i = 0; i < stream_len; i++) {
+        protocol_rx_byte(&proto, stream[i]);
+    }
+    assert(proto.rx_state == RX_ERROR);
+    printf("Modo original mantém RX_ERROR ✓\n");
+    
+    // Bytes que chegam depois de um quadro completo, sem protocol_rx_reset(),
+    // com bytes ainda na fila de reprocessamento, são ignorados sem estourar a fila
+    len = encode_frame(first, sizeof(first), stream);
+    stream[1] = 20;
+    filler = len + encode_frame(third, sizeof(third), &stream[len]);
+    while (filler < sizeof(stream)) {
+        stream[filler++] = 0x55;
+    }
+    protocol_init(&proto);
+    protocol_set_resync(&proto, true);
+    bool done = false;
+    for (size_t i = 0; i < sizeof(stream) && !done; i++) {
+        done = protocol_rx_byte(&proto, stream[i]);
+    }
+    assert(done && proto.rx_replay_pos < proto.rx_replay_len);
+    uint16_t pending = proto.rx_replay_len;
+    for (int i = 0; i < 4 * RX_REPLAY_SIZE; i++) {
+        assert(protocol_rx_byte(&proto, STX));
+    }
+    assert(proto.rx_replay_len == pending);
+    assert(proto.rx_received_bytes == sizeof(third));
+    assert(memcmp(proto.rx_data, third, sizeof(third)) == 0);
+    printf("Bytes após quadro completo não estouram a fila ✓\n");
+}
+
+// Transmite o quadro já preparado em 'proto' para 'out'; retorna o tamanho
+size_t encode_prepared(Protocol* proto, uint8_t* out) {
+    size_t n = 0;
+    while (!protocol_tx_byte(proto, &out[n++])) {
+    }
+    return n;
+}
+
+// Entrega 'len' bytes ao receptor, byte a byte; retorna os quadros completos
+int deliver_bytes(Protocol* rx, const uint8_t* stream, size_t len) {
+    int frames = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (protocol_rx_byte(rx, stream[i])) {
+            frames++;
+        }
+    }
+    return frames;
+}
+
+void test_ext_frames() {
+    printf("\n=== Teste quadros estendidos (LEN varint) ===\n");
+    
+#if MAX_EXT_DATA_SIZE < 1024
+    // Os quadros deste teste não cabem no buffer: confere só o limite
+    Protocol p;
+    protocol_init(&p);
+    protocol_set_ext_max(&p, 1024);
+    assert(p.rx_ext_max == RX_BUFFER_SIZE);
+    printf("Máximo limitado a %d bytes; teste completo com -DMAX_EXT_DATA_SIZE=1024 ✓\n",
+           RX_BUFFER_SIZE);
+#else
+    static uint8_t data[MAX_EXT_DATA_SIZE];
+    static uint8_t stream[4 * (MAX_EXT_DATA_SIZE + 16)];
+    for (int i = 0; i < MAX_EXT_DATA_SIZE; i++) {
+        data[i] = (uint8_t)(i * 13 + 5);
+    }
+    
+    // Varint: 1, 2 e 3 bytes
+    uint8_t varint[MAX_LEN_BYTES];
+    assert(encode_varint(127, varint) == 1 && varint[0] == 0x7F);
+    assert(encode_varint(300, varint) == 2 && varint[0] == 0xAC && varint[1] == 0x02);
+    assert(encode_varint(65535, varint) == 3 && varint[2] == 0x03);
+    
+    Protocol a, b, legacy;
+    protocol_init(&a);
+    protocol_init(&b);
+    protocol_init(&legacy);
+    protocol_set_ext_max(&a, 1024);
+    protocol_set_ext_max(&b, 512);
+    
+    // Sem anúncio do outro lado, só o formato de 1 byte
+    assert(protocol_tx_max(&a) == MAX_DATA_SIZE);
+    protocol_tx_begin(&a, data, 300);
+    assert(a.tx_state == TX_ERROR);
+    
+    // Negociação: cada lado anuncia o seu máximo
+    protocol_tx_announce(&a);
+    size_t len = encode_prepared(&a, stream);
+    assert(deliver_bytes(&b, stream, len) == 0);
+    assert(b.ext_peer_announced && b.ext_peer_max == 1024);
+    assert(b.rx_state == RX_WAIT_STX);
+    
+    protocol_tx_announce(&b);
+    len = encode_prepared(&b, stream);
+    assert(deliver_bytes(&a, stream, len) == 0);
+    assert(a.ext_peer_max == 512 && protocol_tx_max(&a) == 512);
+    
+    // Um par antigo ignora o anúncio e continua recebendo normalmente
+    protocol_tx_announce(&a);
+    len = encode_prepared(&a, stream);
+    assert(deliver_bytes(&legacy, stream, len) == 0);
+    assert(legacy.rx_state == RX_WAIT_STX && legacy.rx_frame_errors == 0);
+    
+    // 500 bytes: SOH + 2 bytes de LEN + dados + CHK + ETX
+    protocol_tx_begin(&a, data, 500);
+    len = encode_prepared(&a, stream);
+    assert(len == 1 + 2 + 500 + check_size(a.check_type) + 1);
+    assert(stream[0] == SOH);
+    assert(deliver_bytes(&b, stream, len) == 1);
+    assert(b.rx_received_bytes == 500 && memcmp(b.rx_data, data, 500) == 0);
+    protocol_rx_reset(&b);
+    
+    // Acima do máximo anunciado não transmite
+    protocol_tx_begin(&a, data, 513);
+    assert(a.tx_state == TX_ERROR);
+    
+    // Até 255 bytes continua no formato original, mesmo negociado
+    protocol_tx_begin(&a, data, 255);
+    len = encode_prepared(&a, stream);
+    assert(stream[0] == STX && stream[1] == 255);
+    assert(deliver_bytes(&legacy, stream, len) == 1);
+    
+    // LEN maior que o aceito é erro de enquadramento
+    Protocol big;
+    protocol_init(&big);
+    protocol_set_ext_max(&big, 1024);
+    big.ext_peer_max = 1024;
+    protocol_tx_begin(&big, data, 1000);
+    len = encode_prepared(&big, stream);
+    assert(deliver_bytes(&b, stream, len) == 0);
+    assert(b.rx_frame_errors == 1);
+    
+    // Em bloco, misturando formatos, com ressincronização e quadro corrompido
+    size_t stream_len = 0;
+    protocol_tx_begin(&big, data, 10);
+    stream_len += encode_prepared(&big, &stream[stream_len]);
+    protocol_tx_begin(&big, data, 700);
+    size_t corrupted = stream_len + 300;
+    stream_len += encode_prepared(&big, &stream[stream_len]);
+    protocol_tx_begin(&big, data, 1000);
+    stream_len += encode_prepared(&big, &stream[stream_len]);
+    protocol_tx_announce(&big);
+    stream_len += encode_prepared(&big, &stream[stream_len]);
+    protocol_tx_begin(&big, data, 0);
+    stream_len += encode_prepared(&big, &stream[stream_len]);
+    
+    const size_t chunks[] = {1, 7, 4096};
+    for (int corrupt = 0; corrupt < 2; corrupt++) {
+        if (corrupt) {
+            stream[corrupted] ^= 0x10;
+        }
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            Protocol rx;
+            protocol_init(&rx);
+            protocol_set_ext_max(&rx, 1024);
+            protocol_set_resync(&rx, true);
+            
+            int count = 0;
+            uint16_t sizes[4];
+            for (size_t offset = 0; offset < stream_len; ) {
+                size_t block = (chunks[c] < stream_len - offset) ? chunks[c] : stream_len - offset;
+                size_t pos = 0, consumed;
+                while (protocol_rx_buffer(&rx, &stream[offset + pos], block - pos, &consumed)) {
+                    assert(memcmp(rx.rx_data, data, rx.rx_received_bytes) == 0);
+                    sizes[count++] = rx.rx_received_bytes;
+                    pos += consumed;
+                }
+                offset += block;
+            }
+            
+            if (!corrupt) {
+                assert(count == 4);
+                assert(sizes[0] == 10 && sizes[1] == 700 && sizes[2] == 1000 && sizes[3] == 0);
+                assert(rx.rx_frame_errors == 0);
+            } else {
+                // Os dados do quadro descartado são reprocessados e podem
+                // conter STX/SOH falsos, que também contam como erro
+                assert(count == 3);
+                assert(sizes[0] == 10 && sizes[1] == 1000 && sizes[2] == 0);
+                assert(rx.rx_frame_errors >= 1);
+            }
+            assert(rx.ext_peer_announced && rx.ext_peer_max == 1024);
+        }
+    }
+    
+    printf("Negociação, formatos misturados e quadros de até %d bytes ✓\n", MAX_EXT_DATA_SIZE);
+#endif
+}
+
 void run_all_tests() {
     printf("Iniciando testes TDD...\n");
     
@@ -422,17 +1485,175 @@ void run_all_tests() {
     test_rx_missing_etx();
     test_tx_transmission();
     test_full_cycle();
+    test_rx_empty_packet();
+    test_rx_buffer_single();
+    test_rx_buffer_split();
+    test_rx_buffer_invalid_checksum();
+    test_check_modes();
+    test_rx_zero_copy();
+    test_rx_ring();
+    test_rx_resync();
+    test_ext_frames();
     
     printf("\n Todos os testes passaram!\n");
 }
 
+/**********************
+ * BENCHMARK
+ **********************/
+#define BENCH_FRAMES 16384
+
+double elapsed_seconds(const struct timespec* start, const struct timespec* end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Compara a recepção byte a byte com a recepção em bloco (MB/s)
+void benchmark_rx(CheckType type, const char* name) {
+    printf("\n=== Benchmark RX (%s): byte a byte x bloco ===\n", name);
+    
+    static uint8_t stream[BENCH_FRAMES * (MAX_DATA_SIZE + 3 + CHECK_MAX_SIZE)];
+    uint8_t data[MAX_DATA_SIZE];
+    size_t stream_len = 0;
+    
+    for (int i = 0; i < MAX_DATA_SIZE; i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        stream_len += encode_frame_check(type, data, MAX_DATA_SIZE, &stream[stream_len]);
+    }
+    
+    Protocol proto;
+    struct timespec start, end;
+    int frames;
+    
+    // Byte a byte
+    protocol_init(&proto);
+    protocol_set_check(&proto, type);
+    frames = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < stream_len; i++) {
+        if (protocol_rx_byte(&proto, stream[i])) {
+            frames++;
+            protocol_rx_reset(&proto);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert(frames == BENCH_FRAMES);
+    double per_byte = elapsed_seconds(&start, &end);
+    
+    // Em bloco
+    protocol_init(&proto);
+    protocol_set_check(&proto, type);
+    frames = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t pos = 0; pos < stream_len; ) {
+        size_t consumed;
+        if (protocol_rx_buffer(&proto, &stream[pos], stream_len - pos, &consumed)) {
+            frames++;
+        }
+        pos += consumed;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert(frames == BENCH_FRAMES);
+    double bulk = elapsed_seconds(&start, &end);
+    
+    double mbytes = (double)stream_len / 1e6;
+    printf("Byte a byte: %8.1f MB/s\n", mbytes / per_byte);
+    printf("Em bloco:    %8.1f MB/s (%.1fx)\n", mbytes / bulk, per_byte / bulk);
+}
+
+/*
+ * Eficiência (dados / bytes na linha) e quadros/s para vários tamanhos.
+ * Acima de 255 bytes compara o quadro estendido com a mesma carga dividida
+ * em quadros de 255 bytes no formato original.
+ */
+#define BENCH_EXT_BYTES (16u * 1024u * 1024u)
+
+void benchmark_frame_sizes(CheckType type, const char* name) {
+    printf("\n=== Benchmark tamanho de quadro (%s) ===\n", name);
+    printf(" dados  formato    bytes/quadro  eficiência  TX quadros/s  RX quadros/s   RX MB/s dados\n");
+    
+    static uint8_t data[MAX_EXT_DATA_SIZE];
+    static uint8_t stream[BENCH_EXT_BYTES + MAX_EXT_DATA_SIZE + 16];
+    for (int i = 0; i < MAX_EXT_DATA_SIZE; i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+    
+    const uint16_t sizes[] = {16, 64, 128, 255, 256, 512, 1024};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint16_t size = sizes[s];
+        if (size > MAX_EXT_DATA_SIZE && size > MAX_DATA_SIZE) {
+            continue;
+        }
+        
+        Protocol tx, rx;
+        protocol_init(&tx);
+        protocol_init(&rx);
+        protocol_set_check(&tx, type);
+        protocol_set_check(&rx, type);
+        protocol_set_ext_max(&tx, MAX_EXT_DATA_SIZE);
+        protocol_set_ext_max(&rx, MAX_EXT_DATA_SIZE);
+        tx.ext_peer_max = MAX_EXT_DATA_SIZE;
+        
+        // TX: gera o fluxo byte a byte
+        struct timespec start, end;
+        size_t stream_len = 0;
+        int frames = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (stream_len + size + 16 <= BENCH_EXT_BYTES) {
+            protocol_tx_begin(&tx, data, size);
+            stream_len += encode_prepared(&tx, &stream[stream_len]);
+            frames++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double tx_time = elapsed_seconds(&start, &end);
+        size_t frame_len = stream_len / frames;
+        
+        // RX: em bloco
+        int received = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t pos = 0; pos < stream_len; ) {
+            size_t consumed;
+            if (protocol_rx_buffer(&rx, &stream[pos], stream_len - pos, &consumed)) {
+                received++;
+            }
+            pos += consumed;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double rx_time = elapsed_seconds(&start, &end);
+        assert(received == frames);
+        
+        printf("%6u  %-9s  %12zu  %9.1f%%  %12.0f  %12.0f  %12.1f\n",
+               size, size > MAX_DATA_SIZE ? "estendido" : "original", frame_len,
+               100.0 * size / frame_len, frames / tx_time, frames / rx_time,
+               (double)frames * size / rx_time / 1e6);
+        
+        if (size > MAX_DATA_SIZE) {
+            // Mesma carga em quadros de até 255 bytes
+            size_t chunks = (size + MAX_DATA_SIZE - 1) / MAX_DATA_SIZE;
+            size_t legacy_len = size + chunks * (3 + check_size(type));
+            printf("%6u  %-9s  %12zu  %9.1f%%   (%zu quadros de até %d bytes)\n",
+                   size, "original", legacy_len, 100.0 * size / legacy_len, chunks, MAX_DATA_SIZE);
+        }
+    }
+}
+
 /**********************
  * FUNCIONAMENTO
  **********************/
-int main() {
+int main(int argc, char** argv) {
     // Executa todos os testes
     run_all_tests();
     
+    // "./fsm bench" executa também o benchmark
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchmark_rx(CHECK_XOR8, "XOR8");
+        benchmark_rx(CHECK_CRC16, "CRC-16");
+        benchmark_rx(CHECK_CRC32C, "CRC-32C");
+        benchmark_frame_sizes(CHECK_XOR8, "XOR8");
+        benchmark_frame_sizes(CHECK_CRC32C, "CRC-32C");
+    }
+    
     // Exemplo de uso completo
     printf("\n=== Exemplo de uso completo ===\n");
     Protocol proto;
@@ -1,24 +1,62 @@
+// clock_gettime/CLOCK_MONOTONIC (POSIX) tambem com -std=c11
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-
-#define MAX_DADOS 256
+#include <time.h>
+#include "../Checksum/checksum.h"
+#include "../RingBuffer/ring_buffer.h"
+
+#define MAX_DADOS 255     // quadro original: QTD de 1 byte
+
+// Quadro estendido: SOH LEN DADOS CHK ETX, com LEN em varint de 16 bits
+// (7 bits por byte, menos significativos primeiro, bit 7 = continua).
+// SOH 0x00 MAX CHK ETX anuncia o maior quadro estendido aceito; só se
+// transmite quadro estendido depois de receber esse anúncio do outro lado.
+#define SOH 0x01
+#define MAX_LEN_BYTES 3
+
+// Maior quadro estendido aceito pelo receptor. O padrão não reserva nada
+// além do quadro original; compilar com -DMAX_DADOS_EXT=1024 para quadros
+// estendidos (dados do pacote e fila de reprocessamento crescem junto)
+#ifndef MAX_DADOS_EXT
+#define MAX_DADOS_EXT MAX_DADOS
+#endif
+
+#define TAM_DADOS (MAX_DADOS_EXT > MAX_DADOS ? MAX_DADOS_EXT : MAX_DADOS)
+#define TAM_CABECALHO (2 * MAX_LEN_BYTES)
+
+// Número máximo de canais (UARTs) atendidos por um FsmEngine
+#ifndef MAX_CANAIS
+#define MAX_CANAIS 16
+#endif
+
+// Tamanho da fila de entrada de cada canal (potência de 2)
+#ifndef TAM_ENTRADA
+#define TAM_ENTRADA 1024
+#endif
 
 // ========== ESTRUTURAS E ESTADOS ==========
 typedef enum {
     // Estados do Receptor
     RX_WAIT_STX = 0,
     RX_WAIT_QTD,
+    RX_WAIT_LEN,
+    RX_WAIT_MAX,
     RX_WAIT_DADOS,
     RX_WAIT_CHK,
     RX_WAIT_ETX,
     RX_PACKET_COMPLETE,
     RX_ERROR_STATE,
     
-    // Estados do Transmissor  
+    // Estados do Transmissor
     TX_IDLE,
     TX_SEND_STX,
     TX_SEND_QTD,
+    TX_SEND_LEN,
     TX_SEND_DADOS,
     TX_SEND_CHK,
     TX_SEND_ETX,
@@ -29,71 +67,119 @@ typedef enum {
 } State;
 
 typedef struct {
-    unsigned char qtd;
-    unsigned char dados[MAX_DADOS];
+    unsigned short qtd;
+    unsigned char dados[TAM_DADOS];
     unsigned char chk;
 } Packet;
 
-// ========== VARIÁVEIS GLOBAIS ==========
-State rx_state;      // Estado do receptor
-State tx_state;      // Estado do transmissor
+// Bytes de um quadro descartado que serão reprocessados
+#define TAM_REPLAY (TAM_CABECALHO + TAM_DADOS + 1 + 1)
 
-Packet rx_packet;    // Pacote sendo recebido
-Packet tx_packet;    // Pacote a ser transmitido
+// Buffers volumosos de um canal; ficam fora do contexto para que os
+// contextos de todos os canais fiquem contíguos na memória
+typedef struct {
+    Packet rx_packet;
+    Packet tx_packet;
+    unsigned char rx_replay[TAM_REPLAY];
+} ChannelBuffers;
 
-unsigned char rx_dataIndex;
-unsigned char tx_dataIndex;
-unsigned char rx_calculated_chk;
-unsigned char tx_calculated_chk;
+// ========== CONTEXTO DE UM CANAL ==========
+// Tudo o que antes eram variáveis globais: cada canal tem o seu
+typedef struct {
+    State rx_state;      // Estado do receptor
+    State tx_state;      // Estado do transmissor
+    
+    unsigned short rx_dataIndex;
+    unsigned short tx_dataIndex;
+    unsigned char rx_calculated_chk;
+    unsigned char tx_calculated_chk;
+    
+    // Cabeçalho depois do STX/SOH: QTD, ou LEN (e MAX no anúncio)
+    unsigned char rx_header[TAM_CABECALHO];
+    int rx_headerLen;
+    unsigned long rx_varint;
+    int rx_varintShift;
+    int rx_announce;
+    unsigned char tx_header[TAM_CABECALHO];
+    int tx_headerLen;
+    int tx_headerIndex;
+    int tx_extended;
+    
+    // Quadros estendidos: rx_extMax == 0 aceita só o formato original
+    unsigned short rx_extMax;
+    unsigned short ext_peerMax;      // anunciado pelo outro lado (0: par antigo)
+    int ext_peerAnnounced;
+    
+    Packet* rx_packet;   // Pacote sendo recebido
+    Packet* tx_packet;   // Pacote a ser transmitido
+    
+    // Ressincronização: com rx_resync ligado, um quadro com CHK ou ETX inválido
+    // é descartado e os bytes depois do seu STX são reprocessados
+    int rx_resync;
+    unsigned long rx_frameErrors;    // quadros descartados
+    unsigned long rx_droppedBytes;   // bytes fora de quadros válidos
+    unsigned char* rx_replay;
+    int rx_replayLen;
+    int rx_replayPos;
+} FsmContext;
 
 // ========== PROTÓTIPOS ==========
-typedef void (*StateFunc)(unsigned char byte);
+typedef void (*StateFunc)(FsmContext* ctx, unsigned char byte);
 
 // Funções do Receptor
-void rx_waitSTX(unsigned char byte);
-void rx_waitQTD(unsigned char byte);
-void rx_waitDADOS(unsigned char byte);
-void rx_waitCHK(unsigned char byte);
-void rx_waitETX(unsigned char byte);
-void rx_packetComplete(unsigned char byte);
-void rx_errorState(unsigned char byte);
+void rx_waitSTX(FsmContext* ctx, unsigned char byte);
+void rx_waitQTD(FsmContext* ctx, unsigned char byte);
+void rx_waitLEN(FsmContext* ctx, unsigned char byte);
+void rx_waitMAX(FsmContext* ctx, unsigned char byte);
+void rx_waitDADOS(FsmContext* ctx, unsigned char byte);
+void rx_waitCHK(FsmContext* ctx, unsigned char byte);
+void rx_waitETX(FsmContext* ctx, unsigned char byte);
+void rx_packetComplete(FsmContext* ctx, unsigned char byte);
+void rx_errorState(FsmContext* ctx, unsigned char byte);
+void rx_frameError(FsmContext* ctx, unsigned char byte);
 
 // Funções do Transmissor
-void tx_idle(unsigned char byte);
-void tx_sendSTX(unsigned char byte);
-void tx_sendQTD(unsigned char byte);
-void tx_sendDADOS(unsigned char byte);
-void tx_sendCHK(unsigned char byte);
-void tx_sendETX(unsigned char byte);
-void tx_complete(unsigned char byte);
-void tx_errorState(unsigned char byte);
+void tx_idle(FsmContext* ctx, unsigned char byte);
+void tx_sendSTX(FsmContext* ctx, unsigned char byte);
+void tx_sendQTD(FsmContext* ctx, unsigned char byte);
+void tx_sendLEN(FsmContext* ctx, unsigned char byte);
+void tx_sendDADOS(FsmContext* ctx, unsigned char byte);
+void tx_sendCHK(FsmContext* ctx, unsigned char byte);
+void tx_sendETX(FsmContext* ctx, unsigned char byte);
+void tx_complete(FsmContext* ctx, unsigned char byte);
+void tx_errorState(FsmContext* ctx, unsigned char byte);
 
 // Funções de obtenção de bytes (substituem o switch-case)
-unsigned char tx_getSTX(void);
-unsigned char tx_getQTD(void);
-unsigned char tx_getDADOS(void);
-unsigned char tx_getCHK(void);
-unsigned char tx_getETX(void);
-unsigned char tx_getIdle(void);
-unsigned char tx_getError(void);
-unsigned char tx_getComplete(void);
-
-typedef unsigned char (*TxByteFunc)(void);
-
-void processRxByte(unsigned char byte);
-void prepareTxPacket(const unsigned char* data, unsigned char size);
-unsigned char getTxByte(void);
-void advanceTxState(void);
-void resetFSM(void);
+unsigned char tx_getSTX(FsmContext* ctx);
+unsigned char tx_getQTD(FsmContext* ctx);
+unsigned char tx_getLEN(FsmContext* ctx);
+unsigned char tx_getDADOS(FsmContext* ctx);
+unsigned char tx_getCHK(FsmContext* ctx);
+unsigned char tx_getETX(FsmContext* ctx);
+unsigned char tx_getIdle(FsmContext* ctx);
+unsigned char tx_getError(FsmContext* ctx);
+unsigned char tx_getComplete(FsmContext* ctx);
+
+typedef unsigned char (*TxByteFunc)(FsmContext* ctx);
+
+void initContext(FsmContext* ctx, ChannelBuffers* buffers);
+void processRxByte(FsmContext* ctx, unsigned char byte);
+void prepareTxPacket(FsmContext* ctx, const unsigned char* data, unsigned short size);
+void prepareTxAnnounce(FsmContext* ctx);
+unsigned char getTxByte(FsmContext* ctx);
+void advanceTxState(FsmContext* ctx);
+void resetFSM(FsmContext* ctx);
+void resetRx(FsmContext* ctx);
 
 // ========== FSM ==========
-StateFunc rx_fsm[] = { 
-    rx_waitSTX, rx_waitQTD, rx_waitDADOS, rx_waitCHK, rx_waitETX, 
-    rx_packetComplete, rx_errorState
+// As tabelas são compartilhadas por todos os canais: só o contexto muda
+StateFunc rx_fsm[] = {
+    rx_waitSTX, rx_waitQTD, rx_waitLEN, rx_waitMAX, rx_waitDADOS, rx_waitCHK,
+    rx_waitETX, rx_packetComplete, rx_errorState
 };
 
 StateFunc tx_fsm[] = {
-    tx_idle, tx_sendSTX, tx_sendQTD, tx_sendDADOS, tx_sendCHK, 
+    tx_idle, tx_sendSTX, tx_sendQTD, tx_sendLEN, tx_sendDADOS, tx_sendCHK,
     tx_sendETX, tx_complete, tx_errorState
 };
 
@@ -102,6 +188,7 @@ TxByteFunc tx_byte_funcs[] = {
     tx_getIdle,      // TX_IDLE
     tx_getSTX,       // TX_SEND_STX
     tx_getQTD,       // TX_SEND_QTD
+    tx_getLEN,       // TX_SEND_LEN
     tx_getDADOS,     // TX_SEND_DADOS
     tx_getCHK,       // TX_SEND_CHK
     tx_getETX,       // TX_SEND_ETX
@@ -110,221 +197,800 @@ TxByteFunc tx_byte_funcs[] = {
 };
 
 // ========== FUNÇÕES AUXILIARES ==========
-void resetFSM(void) {
-    rx_state = RX_WAIT_STX;
-    tx_state = TX_IDLE;
-    rx_dataIndex = 0;
-    tx_dataIndex = 0;
-    memset(&rx_packet, 0, sizeof(Packet));
-    memset(&tx_packet, 0, sizeof(Packet));
-    rx_calculated_chk = 0;
-    tx_calculated_chk = 0;
+void initContext(FsmContext* ctx, ChannelBuffers* buffers) {
+    ctx->rx_packet = &buffers->rx_packet;
+    ctx->tx_packet = &buffers->tx_packet;
+    ctx->rx_replay = buffers->rx_replay;
+    ctx->rx_resync = 0;
+    ctx->rx_extMax = 0;
+    resetFSM(ctx);
+}
+
+void resetFSM(FsmContext* ctx) {
+    ctx->rx_state = RX_WAIT_STX;
+    ctx->tx_state = TX_IDLE;
+    ctx->rx_dataIndex = 0;
+    ctx->tx_dataIndex = 0;
+    memset(ctx->rx_packet, 0, sizeof(Packet));
+    memset(ctx->tx_packet, 0, sizeof(Packet));
+    ctx->rx_calculated_chk = 0;
+    ctx->tx_calculated_chk = 0;
+    ctx->rx_frameErrors = 0;
+    ctx->rx_droppedBytes = 0;
+    ctx->rx_replayLen = 0;
+    ctx->rx_replayPos = 0;
+    ctx->rx_headerLen = 0;
+    ctx->rx_announce = 0;
+    ctx->tx_extended = 0;
+    ctx->ext_peerMax = 0;
+    ctx->ext_peerAnnounced = 0;
+}
+
+// Prepara o receptor para o próximo quadro, sem perder bytes a reprocessar
+void resetRx(FsmContext* ctx) {
+    ctx->rx_state = RX_WAIT_STX;
+    ctx->rx_dataIndex = 0;
+    ctx->rx_calculated_chk = 0;
+    ctx->rx_headerLen = 0;
+    ctx->rx_announce = 0;
+}
+
+// Codifica 'value' em varint; retorna o número de bytes (1 a 3)
+int encodeVarint(unsigned short value, unsigned char* out) {
+    int n = 0;
+    while(value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// Maior quadro estendido aceito: rx_extMax, limitado aos dados do pacote
+unsigned short rxExtMax(FsmContext* ctx) {
+    return ctx->rx_extMax > TAM_DADOS ? TAM_DADOS : ctx->rx_extMax;
+}
+
+// Maior quadro que pode ser transmitido ao outro lado (e copiado em dados)
+unsigned short txMax(FsmContext* ctx) {
+    if(ctx->rx_extMax == 0 || ctx->ext_peerMax <= MAX_DADOS) {
+        return MAX_DADOS;
+    }
+    return ctx->ext_peerMax > TAM_DADOS ? TAM_DADOS : ctx->ext_peerMax;
 }
 
 // ========== RECEPTOR ==========
-void rx_waitSTX(unsigned char byte) {
+void rx_waitSTX(FsmContext* ctx, unsigned char byte) {
     if(byte == 0x02) {
-        rx_calculated_chk = byte;
-        rx_state = RX_WAIT_QTD;
+        ctx->rx_calculated_chk = byte;
+        ctx->rx_state = RX_WAIT_QTD;
+    } else if(byte == SOH && ctx->rx_extMax > 0) {
+        ctx->rx_calculated_chk = byte;
+        ctx->rx_varint = 0;
+        ctx->rx_varintShift = 0;
+        ctx->rx_state = RX_WAIT_LEN;
+    } else {
+        ctx->rx_droppedBytes++;
     }
 }
 
-void rx_waitQTD(unsigned char byte) {
-    rx_packet.qtd = byte;
-    rx_calculated_chk ^= byte;
-    
-    if(rx_packet.qtd <= MAX_DADOS) {
-        if(rx_packet.qtd == 0) {
-            rx_state = RX_WAIT_CHK;
-        } else {
-            rx_state = RX_WAIT_DADOS;
-        }
+// Tamanho conhecido: segue para os dados (ou direto para o CHK)
+void rx_beginData(FsmContext* ctx, unsigned short qtd, unsigned char byte) {
+    ctx->rx_header[ctx->rx_headerLen++] = byte;
+    ctx->rx_calculated_chk ^= byte;
+    ctx->rx_packet->qtd = qtd;
+    ctx->rx_state = (qtd == 0) ? RX_WAIT_CHK : RX_WAIT_DADOS;
+}
+
+// Um byte de varint; retorna 1 no último byte
+int rx_varintByte(FsmContext* ctx, unsigned char byte) {
+    ctx->rx_varint |= (unsigned long)(byte & 0x7F) << ctx->rx_varintShift;
+    ctx->rx_varintShift += 7;
+    return (byte & 0x80) == 0 || ctx->rx_varintShift >= 7 * MAX_LEN_BYTES;
+}
+
+void rx_waitQTD(FsmContext* ctx, unsigned char byte) {
+    // QTD de 1 byte nunca passa de MAX_DADOS
+    rx_beginData(ctx, byte, byte);
+}
+
+void rx_waitLEN(FsmContext* ctx, unsigned char byte) {
+    if(!rx_varintByte(ctx, byte)) {
+        ctx->rx_header[ctx->rx_headerLen++] = byte;
+        ctx->rx_calculated_chk ^= byte;
+    } else if(ctx->rx_varint == 0 && (byte & 0x80) == 0) {
+        // LEN = 0: anúncio de capacidade, segue o MAX
+        ctx->rx_header[ctx->rx_headerLen++] = byte;
+        ctx->rx_calculated_chk ^= byte;
+        ctx->rx_announce = 1;
+        ctx->rx_varintShift = 0;
+        ctx->rx_state = RX_WAIT_MAX;
+    } else if((byte & 0x80) != 0 || ctx->rx_varint > rxExtMax(ctx)) {
+        // Varint longo demais ou quadro maior que o aceito
+        rx_frameError(ctx, byte);
     } else {
-        rx_state = RX_ERROR_STATE;
+        rx_beginData(ctx, (unsigned short)ctx->rx_varint, byte);
+    }
+}
+
+void rx_waitMAX(FsmContext* ctx, unsigned char byte) {
+    ctx->rx_header[ctx->rx_headerLen++] = byte;
+    ctx->rx_calculated_chk ^= byte;
+    if(rx_varintByte(ctx, byte)) {
+        ctx->rx_packet->qtd = 0;
+        ctx->rx_state = RX_WAIT_CHK;
     }
 }
 
-void rx_waitDADOS(unsigned char byte) {
-    if(rx_dataIndex < MAX_DADOS) {
-        rx_packet.dados[rx_dataIndex++] = byte;
-        rx_calculated_chk ^= byte;
+void rx_waitDADOS(FsmContext* ctx, unsigned char byte) {
+    if(ctx->rx_dataIndex < TAM_DADOS) {
+        ctx->rx_packet->dados[ctx->rx_dataIndex++] = byte;
+        ctx->rx_calculated_chk ^= byte;
         
-        if(rx_dataIndex >= rx_packet.qtd) {
-            rx_state = RX_WAIT_CHK;
+        if(ctx->rx_dataIndex >= ctx->rx_packet->qtd) {
+            ctx->rx_state = RX_WAIT_CHK;
         }
     } else {
-        rx_state = RX_ERROR_STATE;
+        ctx->rx_state = RX_ERROR_STATE;
     }
 }
 
-void rx_waitCHK(unsigned char byte) {
-    rx_packet.chk = byte;
-    if(rx_calculated_chk == byte) {
-        rx_state = RX_WAIT_ETX;
+void rx_waitCHK(FsmContext* ctx, unsigned char byte) {
+    ctx->rx_packet->chk = byte;
+    if(ctx->rx_calculated_chk == byte) {
+        ctx->rx_state = RX_WAIT_ETX;
     } else {
-        rx_state = RX_ERROR_STATE;
+        rx_frameError(ctx, byte);
     }
 }
 
-void rx_waitETX(unsigned char byte) {
-    if(byte == 0x03) {
-        rx_state = RX_PACKET_COMPLETE;
+void rx_waitETX(FsmContext* ctx, unsigned char byte) {
+    if(byte == 0x03 && ctx->rx_announce) {
+        // Anúncio do outro lado: não é entregue como pacote
+        ctx->ext_peerMax = (ctx->rx_varint > 0xFFFF) ? 0xFFFF : (unsigned short)ctx->rx_varint;
+        ctx->ext_peerAnnounced = 1;
+        resetRx(ctx);
+    } else if(byte == 0x03) {
+        ctx->rx_state = RX_PACKET_COMPLETE;
     } else {
-        rx_state = RX_ERROR_STATE;
+        rx_frameError(ctx, byte);
     }
 }
 
-void rx_packetComplete(unsigned char byte) {
+void rx_packetComplete(FsmContext* ctx, unsigned char byte) {
     // Permanece neste estado
 }
 
-void rx_errorState(unsigned char byte) {
+void rx_errorState(FsmContext* ctx, unsigned char byte) {
     // Permanece em estado de erro
 }
 
-void processRxByte(unsigned char byte) {
-    if(rx_state < NUM_STATES) {
-        rx_fsm[rx_state](byte);
+void rx_frameError(FsmContext* ctx, unsigned char byte) {
+    ctx->rx_frameErrors++;
+    
+    if(!ctx->rx_resync) {
+        ctx->rx_state = RX_ERROR_STATE;
+        return;
+    }
+    
+    // Bytes depois do STX/SOH (cabeçalho, DADOS, CHK aceito), o byte com
+    // erro e o que ainda faltava reprocessar, montados na própria fila. Os
+    // bytes do quadro vieram da fila ou da entrada, então o que faltava
+    // (a partir de rx_replayPos) só anda para trás ou fica onde está
+    int with_chk = (ctx->rx_state == RX_WAIT_ETX);
+    int n = ctx->rx_headerLen + ctx->rx_dataIndex + with_chk + 1;
+    int remaining = ctx->rx_replayLen - ctx->rx_replayPos;
+    memmove(&ctx->rx_replay[n], &ctx->rx_replay[ctx->rx_replayPos], remaining);
+    ctx->rx_replayLen = n + remaining;
+    ctx->rx_replayPos = 0;
+    
+    n = ctx->rx_headerLen;
+    memcpy(ctx->rx_replay, ctx->rx_header, n);
+    memcpy(&ctx->rx_replay[n], ctx->rx_packet->dados, ctx->rx_dataIndex);
+    n += ctx->rx_dataIndex;
+    if(with_chk) {
+        ctx->rx_replay[n++] = ctx->rx_packet->chk;
+    }
+    ctx->rx_replay[n] = byte;
+    
+    ctx->rx_droppedBytes++;   // STX (ou SOH) do quadro descartado
+    resetRx(ctx);
+}
+
+// Reprocessa os bytes pendentes até acabarem ou completar um quadro
+void rx_runReplay(FsmContext* ctx) {
+    while(ctx->rx_replayPos < ctx->rx_replayLen && ctx->rx_state != RX_PACKET_COMPLETE) {
+        if(ctx->rx_state == RX_WAIT_STX) {
+            // Busca em bloco pelo próximo STX (ou SOH)
+            const unsigned char* start = &ctx->rx_replay[ctx->rx_replayPos];
+            const unsigned char* stx = memchr(start, 0x02, ctx->rx_replayLen - ctx->rx_replayPos);
+            int skipped = stx ? (int)(stx - start) : ctx->rx_replayLen - ctx->rx_replayPos;
+            const unsigned char* soh = ctx->rx_extMax ? memchr(start, SOH, skipped) : NULL;
+            if(soh) {
+                skipped = (int)(soh - start);
+            }
+            ctx->rx_droppedBytes += skipped;
+            ctx->rx_replayPos += skipped;
+            if(ctx->rx_replayPos >= ctx->rx_replayLen) {
+                break;
+            }
+        }
+        rx_fsm[ctx->rx_state](ctx, ctx->rx_replay[ctx->rx_replayPos++]);
+    }
+    
+    if(ctx->rx_replayPos >= ctx->rx_replayLen) {
+        ctx->rx_replayLen = 0;
+        ctx->rx_replayPos = 0;
+    }
+}
+
+void processRxByte(FsmContext* ctx, unsigned char byte) {
+    if(ctx->rx_state >= NUM_STATES) {
+        return;
+    }
+    
+    if(ctx->rx_replayLen == 0 || ctx->rx_state == RX_PACKET_COMPLETE) {
+        // Com um pacote completo ainda não entregue o byte é ignorado; a fila
+        // de reprocessamento só anda depois de resetRx()
+        rx_fsm[ctx->rx_state](ctx, byte);
+    } else {
+        // O novo byte entra na fila atrás dos bytes pendentes
+        memmove(ctx->rx_replay, &ctx->rx_replay[ctx->rx_replayPos], ctx->rx_replayLen - ctx->rx_replayPos);
+        ctx->rx_replayLen -= ctx->rx_replayPos;
+        ctx->rx_replayPos = 0;
+        ctx->rx_replay[ctx->rx_replayLen++] = byte;
+    }
+    
+    if(ctx->rx_replayLen > 0) {
+        rx_runReplay(ctx);
     }
 }
 
 // ========== TRANSMISSOR ==========
-void prepareTxPacket(const unsigned char* data, unsigned char size) {
-    if(size <= MAX_DADOS) {
-        tx_packet.qtd = size;
-        memcpy(tx_packet.dados, data, size);
+// Acima de MAX_DADOS usa o quadro estendido, se o outro lado o anunciou
+void prepareTxPacket(FsmContext* ctx, const unsigned char* data, unsigned short size) {
+    if(size <= txMax(ctx)) {
+        ctx->tx_packet->qtd = size;
+        memcpy(ctx->tx_packet->dados, data, size);
+        ctx->tx_extended = size > MAX_DADOS;
+        ctx->tx_headerLen = ctx->tx_extended ? encodeVarint(size, ctx->tx_header) : 0;
+        ctx->tx_headerIndex = 0;
         
-        // Calcula checksum: STX + QTD + DADOS
-        tx_calculated_chk = 0x02; // STX
-        tx_calculated_chk ^= size; // QTD
-        for(int i = 0; i < size; i++) {
-            tx_calculated_chk ^= data[i]; // DADOS
+        // Calcula checksum: STX + QTD + DADOS (ou SOH + LEN + DADOS)
+        ctx->tx_calculated_chk = ctx->tx_extended ? SOH : 0x02;
+        if(ctx->tx_extended) {
+            ctx->tx_calculated_chk ^= checksum_xor8(ctx->tx_header, ctx->tx_headerLen); // LEN
+        } else {
+            ctx->tx_calculated_chk ^= (unsigned char)size; // QTD
         }
-        tx_packet.chk = tx_calculated_chk;
+        ctx->tx_calculated_chk ^= checksum_xor8(data, size); // DADOS
+        ctx->tx_packet->chk = ctx->tx_calculated_chk;
         
-        tx_state = TX_SEND_STX;
-        tx_dataIndex = 0;
+        ctx->tx_state = TX_SEND_STX;
+        ctx->tx_dataIndex = 0;
     } else {
-        tx_state = TX_ERROR_STATE;
+        ctx->tx_state = TX_ERROR_STATE;
     }
 }
 
-void tx_idle(unsigned char byte) {
+// Anúncio de capacidade: SOH 0x00 MAX CHK ETX, com MAX = rxExtMax()
+void prepareTxAnnounce(FsmContext* ctx) {
+    ctx->tx_packet->qtd = 0;
+    ctx->tx_extended = 1;
+    ctx->tx_header[0] = 0x00;
+    ctx->tx_headerLen = 1 + encodeVarint(rxExtMax(ctx), &ctx->tx_header[1]);
+    ctx->tx_headerIndex = 0;
+    ctx->tx_calculated_chk = SOH ^ checksum_xor8(ctx->tx_header, ctx->tx_headerLen);
+    ctx->tx_packet->chk = ctx->tx_calculated_chk;
+    ctx->tx_state = TX_SEND_STX;
+    ctx->tx_dataIndex = 0;
+}
+
+void tx_idle(FsmContext* ctx, unsigned char byte) {
     // Aguarda comando para iniciar transmissão
 }
 
-void tx_sendSTX(unsigned char byte) {
-    tx_state = TX_SEND_QTD;
+void tx_sendSTX(FsmContext* ctx, unsigned char byte) {
+    ctx->tx_state = ctx->tx_extended ? TX_SEND_LEN : TX_SEND_QTD;
+}
+
+void tx_sendQTD(FsmContext* ctx, unsigned char byte) {
+    // Pacote sem dados vai direto para o CHK
+    ctx->tx_state = (ctx->tx_packet->qtd == 0) ? TX_SEND_CHK : TX_SEND_DADOS;
 }
 
-void tx_sendQTD(unsigned char byte) {
-    tx_state = TX_SEND_DADOS;
+void tx_sendLEN(FsmContext* ctx, unsigned char byte) {
+    if(++ctx->tx_headerIndex >= ctx->tx_headerLen) {
+        ctx->tx_state = (ctx->tx_packet->qtd == 0) ? TX_SEND_CHK : TX_SEND_DADOS;
+    }
 }
 
-void tx_sendDADOS(unsigned char byte) {
-    tx_dataIndex++;
-    if(tx_dataIndex >= tx_packet.qtd) {
-        tx_state = TX_SEND_CHK;
+void tx_sendDADOS(FsmContext* ctx, unsigned char byte) {
+    ctx->tx_dataIndex++;
+    if(ctx->tx_dataIndex >= ctx->tx_packet->qtd) {
+        ctx->tx_state = TX_SEND_CHK;
     }
 }
 
-void tx_sendCHK(unsigned char byte) {
-    tx_state = TX_SEND_ETX;
+void tx_sendCHK(FsmContext* ctx, unsigned char byte) {
+    ctx->tx_state = TX_SEND_ETX;
 }
 
-void tx_sendETX(unsigned char byte) {
-    tx_state = TX_COMPLETE;
+void tx_sendETX(FsmContext* ctx, unsigned char byte) {
+    ctx->tx_state = TX_COMPLETE;
 }
 
-void tx_complete(unsigned char byte) {
+void tx_complete(FsmContext* ctx, unsigned char byte) {
     // Transmissão completa
 }
 
-void tx_errorState(unsigned char byte) {
+void tx_errorState(FsmContext* ctx, unsigned char byte) {
     // Erro na transmissão
 }
 
 // ========== FUNÇÕES DE OBTER BYTES (USANDO PONTEIROS) ==========
-unsigned char tx_getIdle(void) { return 0x00; }
-unsigned char tx_getSTX(void) { return 0x02; }
-unsigned char tx_getQTD(void) { return tx_packet.qtd; }
-unsigned char tx_getDADOS(void) { 
-    return (tx_dataIndex < tx_packet.qtd) ? tx_packet.dados[tx_dataIndex] : 0x00; 
+unsigned char tx_getIdle(FsmContext* ctx) { return 0x00; }
+unsigned char tx_getSTX(FsmContext* ctx) { return ctx->tx_extended ? SOH : 0x02; }
+unsigned char tx_getQTD(FsmContext* ctx) { return (unsigned char)ctx->tx_packet->qtd; }
+unsigned char tx_getLEN(FsmContext* ctx) { return ctx->tx_header[ctx->tx_headerIndex]; }
+unsigned char tx_getDADOS(FsmContext* ctx) {
+    return (ctx->tx_dataIndex < ctx->tx_packet->qtd) ? ctx->tx_packet->dados[ctx->tx_dataIndex] : 0x00;
 }
-unsigned char tx_getCHK(void) { return tx_packet.chk; }
-unsigned char tx_getETX(void) { return 0x03; }
-unsigned char tx_getComplete(void) { return 0x00; }
-unsigned char tx_getError(void) { return 0x00; }
-
-unsigned char getTxByte(void) {
-    if(tx_state >= TX_IDLE && tx_state <= TX_ERROR_STATE) {
-        return tx_byte_funcs[tx_state - TX_IDLE]();
+unsigned char tx_getCHK(FsmContext* ctx) { return ctx->tx_packet->chk; }
+unsigned char tx_getETX(FsmContext* ctx) { return 0x03; }
+unsigned char tx_getComplete(FsmContext* ctx) { return 0x00; }
+unsigned char tx_getError(FsmContext* ctx) { return 0x00; }
+
+unsigned char getTxByte(FsmContext* ctx) {
+    if(ctx->tx_state >= TX_IDLE && ctx->tx_state <= TX_ERROR_STATE) {
+        return tx_byte_funcs[ctx->tx_state - TX_IDLE](ctx);
     }
     return 0x00;
 }
 
-void advanceTxState(void) {
-    if(tx_state >= TX_IDLE && tx_state <= TX_ERROR_STATE) {
-        tx_fsm[tx_state - TX_IDLE](0);
+void advanceTxState(FsmContext* ctx) {
+    if(ctx->tx_state >= TX_IDLE && ctx->tx_state <= TX_ERROR_STATE) {
+        tx_fsm[ctx->tx_state - TX_IDLE](ctx, 0);
+    }
+}
+
+// ========== MOTOR MULTICANAL ==========
+// Chamada a cada pacote completo recebido em um canal
+typedef void (*PacketHandler)(void* arg, int canal, const Packet* packet);
+
+// Estrutura de vetores: os contextos (estado usado a cada byte) ficam juntos
+// e os buffers de pacote e as filas de entrada em vetores separados
+typedef struct {
+    int numCanais;
+    FsmContext ctx[MAX_CANAIS];
+    RingBuffer entrada[MAX_CANAIS];          // a interrupção de cada UART insere aqui
+    ChannelBuffers buffers[MAX_CANAIS];
+    unsigned char entradaDados[MAX_CANAIS][TAM_ENTRADA];
+    PacketHandler onPacket;
+    void* onPacketArg;
+} FsmEngine;
+
+void initEngine(FsmEngine* engine, int numCanais, PacketHandler onPacket, void* arg) {
+    assert(numCanais > 0 && numCanais <= MAX_CANAIS);
+    engine->numCanais = numCanais;
+    engine->onPacket = onPacket;
+    engine->onPacketArg = arg;
+    for(int canal = 0; canal < numCanais; canal++) {
+        initContext(&engine->ctx[canal], &engine->buffers[canal]);
+        ring_init(&engine->entrada[canal], engine->entradaDados[canal], TAM_ENTRADA);
+    }
+}
+
+// Entrega os pacotes completos do canal, inclusive os que estavam nos bytes reprocessados
+int deliverPackets(FsmEngine* engine, int canal) {
+    FsmContext* ctx = &engine->ctx[canal];
+    int pacotes = 0;
+    
+    while(ctx->rx_state == RX_PACKET_COMPLETE) {
+        engine->onPacket(engine->onPacketArg, canal, ctx->rx_packet);
+        pacotes++;
+        resetRx(ctx);
+        if(ctx->rx_replayLen > 0) {
+            rx_runReplay(ctx);
+        }
+    }
+    return pacotes;
+}
+
+/*
+ * Rotina de serviço: uma passada por todos os canais, consumindo o que
+ * houver em cada fila de entrada. Retorna o número de pacotes entregues.
+ */
+int serviceChannels(FsmEngine* engine) {
+    int pacotes = 0;
+    
+    for(int canal = 0; canal < engine->numCanais; canal++) {
+        FsmContext* ctx = &engine->ctx[canal];
+        RingBuffer* ring = &engine->entrada[canal];
+        const uint8_t* span;
+        size_t length;
+        
+        while((length = ring_peek_span(ring, &span)) > 0) {
+            for(size_t i = 0; i < length; i++) {
+                processRxByte(ctx, span[i]);
+                if(ctx->rx_state == RX_PACKET_COMPLETE) {
+                    pacotes += deliverPackets(engine, canal);
+                }
+            }
+            ring_consume(ring, length);
+        }
     }
+    return pacotes;
 }
 
 // ========== TESTES TDD ==========
+// Monta um quadro completo em 'out' usando o transmissor; retorna o tamanho
+int encodePrepared(FsmContext* ctx, unsigned char* out) {
+    int n = 0;
+    while(ctx->tx_state != TX_COMPLETE && ctx->tx_state != TX_ERROR_STATE) {
+        out[n++] = getTxByte(ctx);
+        advanceTxState(ctx);
+    }
+    return n;
+}
+
+int encodePacket(FsmContext* ctx, const unsigned char* data, unsigned short size, unsigned char* out) {
+    prepareTxPacket(ctx, data, size);
+    return encodePrepared(ctx, out);
+}
+
 void testReceptor() {
     printf("=== TESTE RECEPTOR ===\n");
     
+    ChannelBuffers buffers;
+    FsmContext ctx;
+    initContext(&ctx, &buffers);
+    
     // Teste pacote válido
     unsigned char manual_chk = 0x02 ^ 0x03 ^ 0x10 ^ 0x20 ^ 0x30;
     unsigned char stream[] = {0x02, 0x03, 0x10, 0x20, 0x30, manual_chk, 0x03};
     
-    resetFSM();
     for(int i = 0; i < sizeof(stream); i++) {
-        processRxByte(stream[i]);
+        processRxByte(&ctx, stream[i]);
     }
     
-    assert(rx_state == RX_PACKET_COMPLETE);
-    assert(rx_packet.qtd == 3);
-    assert(memcmp(rx_packet.dados, (unsigned char[]){0x10, 0x20, 0x30}, 3) == 0);
+    assert(ctx.rx_state == RX_PACKET_COMPLETE);
+    assert(ctx.rx_packet->qtd == 3);
+    assert(memcmp(ctx.rx_packet->dados, (unsigned char[]){0x10, 0x20, 0x30}, 3) == 0);
     printf("Receptor: Teste passou!\n\n");
 }
 
+void testRessincronizacao() {
+    printf("=== TESTE RESSINCRONIZAÇÃO ===\n");
+    
+    // Quadro A válido, B com CHK corrompido, C válido
+    unsigned char stream[] = {
+        0x02, 0x02, 0x11, 0x12, 0x02 ^ 0x02 ^ 0x11 ^ 0x12, 0x03,
+        0x02, 0x03, 0x21, 0x22, 0x23, 0x5A, 0x03,
+        0x02, 0x01, 0x31, 0x02 ^ 0x01 ^ 0x31, 0x03
+    };
+    unsigned char recebidos[3];
+    int quadros = 0;
+    
+    ChannelBuffers buffers;
+    FsmContext ctx;
+    initContext(&ctx, &buffers);
+    ctx.rx_resync = 1;
+    for(int i = 0; i < sizeof(stream); i++) {
+        processRxByte(&ctx, stream[i]);
+        if(ctx.rx_state == RX_PACKET_COMPLETE) {
+            recebidos[quadros++] = ctx.rx_packet->dados[0];
+            resetRx(&ctx);
+        }
+    }
+    
+    assert(quadros == 2);
+    assert(recebidos[0] == 0x11 && recebidos[1] == 0x31);
+    assert(ctx.rx_frameErrors == 1);
+    assert(ctx.rx_droppedBytes == 7);   // quadro B inteiro
+    
+    // Sem ressincronização o erro continua permanente
+    initContext(&ctx, &buffers);
+    for(int i = 0; i < sizeof(stream); i++) {
+        processRxByte(&ctx, stream[i]);
+        if(ctx.rx_state == RX_PACKET_COMPLETE) {
+            resetRx(&ctx);
+        }
+    }
+    assert(ctx.rx_state == RX_ERROR_STATE);
+    
+    // Bytes depois de um pacote completo, sem resetRx(), com bytes ainda na
+    // fila de reprocessamento: são ignorados e a fila não cresce
+    unsigned char engolido[TAM_REPLAY] = {
+        0x02, 20, 0x11, 0x02, 0x01, 0x31, 0x02 ^ 0x01 ^ 0x31, 0x03
+    };
+    memset(&engolido[8], 0x55, sizeof(engolido) - 8);
+    initContext(&ctx, &buffers);
+    ctx.rx_resync = 1;
+    for(int i = 0; i < sizeof(engolido) && ctx.rx_state != RX_PACKET_COMPLETE; i++) {
+        processRxByte(&ctx, engolido[i]);
+    }
+    assert(ctx.rx_state == RX_PACKET_COMPLETE);
+    assert(ctx.rx_replayPos < ctx.rx_replayLen);
+    int pendentes = ctx.rx_replayLen;
+    for(int i = 0; i < 4 * TAM_REPLAY; i++) {
+        processRxByte(&ctx, 0x02);
+    }
+    assert(ctx.rx_replayLen == pendentes);
+    assert(ctx.rx_packet->qtd == 1 && ctx.rx_packet->dados[0] == 0x31);
+    printf("Ressincronização: Teste passou!\n\n");
+}
+
 void testTransmissor() {
     printf("=== TESTE TRANSMISSOR ===\n");
     
+    ChannelBuffers buffers;
+    FsmContext ctx;
+    initContext(&ctx, &buffers);
+    
     unsigned char dados[] = {0x41, 0x42, 0x43};
-    prepareTxPacket(dados, 3);
+    prepareTxPacket(&ctx, dados, 3);
     
     // Simula transmissão byte a byte
     unsigned char tx_bytes[7];
     for(int i = 0; i < 7; i++) {
-        tx_bytes[i] = getTxByte();
-        advanceTxState();
+        tx_bytes[i] = getTxByte(&ctx);
+        advanceTxState(&ctx);
     }
     
     // Verifica bytes transmitidos
     assert(tx_bytes[0] == 0x02); // STX
     assert(tx_bytes[1] == 0x03); // QTD
     assert(tx_bytes[2] == 0x41); // Dado 1
-    assert(tx_bytes[3] == 0x42); // Dado 2  
+    assert(tx_bytes[3] == 0x42); // Dado 2
     assert(tx_bytes[4] == 0x43); // Dado 3
     
     unsigned char expected_chk = 0x02 ^ 0x03 ^ 0x41 ^ 0x42 ^ 0x43;
     assert(tx_bytes[5] == expected_chk); // CHK
     assert(tx_bytes[6] == 0x03); // ETX
-    assert(tx_state == TX_COMPLETE);
+    assert(ctx.tx_state == TX_COMPLETE);
     
     printf("Transmissor: Teste passou!\n\n");
 }
 
+void testQuadroEstendido() {
+    printf("=== TESTE QUADRO ESTENDIDO ===\n");
+    
+#if MAX_DADOS_EXT < 1024
+    // Sem espaço para quadros estendidos: anúncio e transmissão ficam
+    // limitados aos dados do pacote
+    static ChannelBuffers bufA, bufB;
+    static unsigned char dados[TAM_DADOS + 1];
+    static unsigned char stream[TAM_DADOS + 16];
+    FsmContext a, b;
+    initContext(&a, &bufA);
+    initContext(&b, &bufB);
+    a.rx_extMax = 1024;
+    b.rx_extMax = 1024;
+    
+    prepareTxAnnounce(&b);
+    int n = encodePrepared(&b, stream);
+    for(int i = 0; i < n; i++) {
+        processRxByte(&a, stream[i]);
+    }
+    assert(a.ext_peerAnnounced && a.ext_peerMax == TAM_DADOS);
+    a.ext_peerMax = 1024;
+    assert(txMax(&a) == TAM_DADOS);
+    prepareTxPacket(&a, dados, TAM_DADOS + 1);
+    assert(a.tx_state == TX_ERROR_STATE);
+    
+    printf("Máximo limitado a %d bytes; teste completo com -DMAX_DADOS_EXT=1024\n", TAM_DADOS);
+    printf("Quadro estendido: Teste passou!\n\n");
+#else
+    static ChannelBuffers bufA, bufB, bufAntigo;
+    static unsigned char dados[MAX_DADOS_EXT];
+    static unsigned char stream[MAX_DADOS_EXT + 16];
+    FsmContext a, b, antigo;
+    initContext(&a, &bufA);
+    initContext(&b, &bufB);
+    initContext(&antigo, &bufAntigo);
+    a.rx_extMax = 1024;
+    b.rx_extMax = 600;
+    for(int i = 0; i < MAX_DADOS_EXT; i++) {
+        dados[i] = (unsigned char)(i * 7 + 3);
+    }
+    
+    // Sem anúncio não há quadro estendido
+    prepareTxPacket(&a, dados, 300);
+    assert(a.tx_state == TX_ERROR_STATE);
+    
+    // Anúncios nos dois sentidos; o par antigo ignora
+    prepareTxAnnounce(&b);
+    int n = encodePrepared(&b, stream);
+    for(int i = 0; i < n; i++) {
+        processRxByte(&a, stream[i]);
+        processRxByte(&antigo, stream[i]);
+    }
+    assert(a.ext_peerAnnounced && a.ext_peerMax == 600);
+    assert(a.rx_state == RX_WAIT_STX);
+    assert(antigo.rx_state == RX_WAIT_STX && antigo.rx_frameErrors == 0);
+    
+    // 600 bytes: SOH, 2 bytes de LEN, dados, CHK, ETX
+    n = encodePacket(&a, dados, 600, stream);
+    assert(n == 1 + 2 + 600 + 1 + 1);
+    assert(stream[0] == SOH);
+    for(int i = 0; i < n; i++) {
+        processRxByte(&b, stream[i]);
+    }
+    assert(b.rx_state == RX_PACKET_COMPLETE);
+    assert(b.rx_packet->qtd == 600);
+    assert(memcmp(b.rx_packet->dados, dados, 600) == 0);
+    resetRx(&b);
+    
+    // Acima do máximo anunciado não transmite
+    prepareTxPacket(&a, dados, 601);
+    assert(a.tx_state == TX_ERROR_STATE);
+    
+    // LEN acima do aceito pelo receptor é erro de enquadramento
+    a.ext_peerMax = 1024;
+    n = encodePacket(&a, dados, 1000, stream);
+    for(int i = 0; i < n; i++) {
+        processRxByte(&b, stream[i]);
+    }
+    assert(b.rx_state == RX_ERROR_STATE && b.rx_frameErrors == 1);
+    
+    // Pacote vazio no formato original: STX 0 CHK ETX
+    n = encodePacket(&a, dados, 0, stream);
+    assert(n == 4 && stream[1] == 0 && stream[2] == 0x02);
+    
+    printf("Quadro estendido: Teste passou!\n\n");
+#endif
+}
+
+// Registro dos pacotes entregues pelo motor, por canal
+typedef struct {
+    int pacotes[MAX_CANAIS];
+    unsigned char ultimo[MAX_CANAIS];
+} PacketLog;
+
+void logPacket(void* arg, int canal, const Packet* packet) {
+    PacketLog* log = (PacketLog*)arg;
+    log->pacotes[canal]++;
+    log->ultimo[canal] = packet->dados[0];
+    
+    // Cada canal só recebe os próprios dados
+    for(int i = 0; i < packet->qtd; i++) {
+        assert(packet->dados[i] == (unsigned char)(canal * 16 + i));
+    }
+}
+
+void testMultiCanal() {
+    printf("=== TESTE MULTICANAL ===\n");
+    
+    static FsmEngine engine;
+    PacketLog log;
+    memset(&log, 0, sizeof(log));
+    initEngine(&engine, 4, logPacket, &log);
+    engine.ctx[2].rx_resync = 1;
+    
+    // Um quadro diferente por canal
+    unsigned char quadros[4][MAX_DADOS + 4];
+    int tamanhos[4];
+    for(int canal = 0; canal < 4; canal++) {
+        unsigned char dados[8];
+        for(int i = 0; i < 8; i++) {
+            dados[i] = (unsigned char)(canal * 16 + i);
+        }
+        tamanhos[canal] = encodePacket(&engine.ctx[canal], dados, 5 + canal, quadros[canal]);
+    }
+    
+    // Bytes intercalados entre os canais, como chegariam das quatro UARTs
+    for(int round = 0; round < 3; round++) {
+        for(int i = 0; i < tamanhos[3]; i++) {
+            for(int canal = 0; canal < 4; canal++) {
+                if(i < tamanhos[canal]) {
+                    unsigned char byte = quadros[canal][i];
+                    // Segundo quadro do canal 2 com CHK corrompido
+                    if(canal == 2 && round == 1 && i == tamanhos[canal] - 2) {
+                        byte ^= 0xFF;
+                    }
+                    assert(ring_push(&engine.entrada[canal], byte));
+                }
+            }
+            if(i % 3 == 0) {
+                serviceChannels(&engine);
+            }
+        }
+    }
+    serviceChannels(&engine);
+    
+    assert(log.pacotes[0] == 3 && log.pacotes[1] == 3 && log.pacotes[3] == 3);
+    assert(log.pacotes[2] == 2);
+    assert(engine.ctx[2].rx_frameErrors == 1);
+    assert(engine.ctx[2].rx_state == RX_WAIT_STX);
+    for(int canal = 0; canal < 4; canal++) {
+        assert(ring_count(&engine.entrada[canal]) == 0);
+    }
+    printf("Multicanal: Teste passou!\n\n");
+}
+
 void runAllTests() {
     printf("Iniciando testes TDD...\n\n");
     testReceptor();
-    testTransmissor(); 
+    testRessincronizacao();
+    testTransmissor();
+    testQuadroEstendido();
+    testMultiCanal();
     printf("✅ Todos os testes passaram!\n");
 }
 
+// ========== BENCHMARK ==========
+#define BENCH_BYTES   (16u * 1024u * 1024u)   // total por medição, somando os canais
+#define BENCH_LOTE    512                     // bytes inseridos por canal a cada passada
+
+double elapsedSeconds(const struct timespec* start, const struct timespec* end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+void countPacket(void* arg, int canal, const Packet* packet) {
+    (*(unsigned long*)arg)++;
+}
+
+/*
+ * Custo por byte da rotina de serviço com 'numCanais' canais. A inserção nas
+ * filas (papel das interrupções) fica fora da medição; o total de bytes é o
+ * mesmo para qualquer número de canais.
+ */
+void benchmarkCanais(int numCanais) {
+    static FsmEngine engine;
+    unsigned long pacotes = 0;
+    initEngine(&engine, numCanais, countPacket, &pacotes);
+    
+    // Lote de quadros de 32 bytes de dados
+    unsigned char lote[BENCH_LOTE];
+    unsigned char dados[32];
+    int loteLen = 0;
+    int quadrosPorLote = 0;
+    for(int i = 0; i < 32; i++) {
+        dados[i] = (unsigned char)(i * 7 + 1);
+    }
+    while(loteLen + 37 <= BENCH_LOTE) {
+        loteLen += encodePacket(&engine.ctx[0], dados, sizeof(dados), &lote[loteLen]);
+        quadrosPorLote++;
+    }
+    
+    unsigned long passadas = BENCH_BYTES / ((unsigned long)loteLen * numCanais);
+    double segundos = 0;
+    
+    for(unsigned long p = 0; p < passadas; p++) {
+        for(int canal = 0; canal < numCanais; canal++) {
+            for(int i = 0; i < loteLen; i++) {
+                ring_push(&engine.entrada[canal], lote[i]);
+            }
+        }
+        
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        serviceChannels(&engine);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        segundos += elapsedSeconds(&start, &end);
+    }
+    
+    double bytes = (double)passadas * loteLen * numCanais;
+    assert(pacotes == passadas * quadrosPorLote * numCanais);
+    printf("%2d canais: %8.2f ns/byte  %8.1f MB/s  %lu pacotes\n",
+           numCanais, segundos * 1e9 / bytes, bytes / segundos / 1e6, pacotes);
+}
+
+void runBenchmark() {
+    printf("\n=== BENCHMARK MULTICANAL ===\n");
+    benchmarkCanais(1);
+    benchmarkCanais(4);
+    benchmarkCanais(16);
+}
+
 // ========== MAIN ==========
-int main() {
+int main(int argc, char** argv) {
     runAllTests();
+    
+    // "./fsm_ponteiro bench" executa também o benchmark
+    if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+        runBenchmark();
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -2,108 +2,470 @@
 #include <string.h>
 #include <assert.h>
 #include "pt.h"
+#include "../Checksum/frame_check.h"
 
 // ================= PROTOCOLO =================
+#define SOH 0x01
 #define STX 0x02
 #define ETX 0x03
 #define ACK 0x06
 #define NAK 0x15
-#define MAX_DATA 256
+#define MAX_DATA 255            // quadro original: QTD de 1 byte
 #define MAX_RETRIES 3
 
+// Quadro estendido: SOH [SEQ] LEN DADOS CHK ETX, com LEN em varint de 16
+// bits (7 bits por byte, menos significativos primeiro, bit 7 = continua)
+#ifndef MAX_DATA_EXT
+#define MAX_DATA_EXT 1024
+#endif
+#define MAX_LEN_BYTES 3
+#define TAM_DATA (MAX_DATA_EXT > MAX_DATA ? MAX_DATA_EXT : MAX_DATA)
+
+// Verificação do quadro: CHECK_XOR8, CHECK_CRC16 ou CHECK_CRC32C
+#ifndef CHK_TIPO
+#define CHK_TIPO CHECK_XOR8
+#endif
+
+// Janela deslizante: máximo de quadros enviados e ainda não confirmados
+#define ARQ_JANELA_MAX 16
+
+/*
+ * Modos do transmissor:
+ *  - arq_janela == 0: pare-e-espere original. Quadro STX QTD DADOS CHK ETX,
+ *    resposta de um byte (ACK/NAK), retransmite até MAX_RETRIES
+ *  - arq_janela >= 1: janela deslizante. Quadro STX SEQ QTD DADOS CHK ETX
+ *    (o CHK cobre também o SEQ) e resposta ACK/NAK SEQ ~SEQ. Cada quadro tem
+ *    o seu temporizador de retransmissão.
+ *      ARQ_GO_BACK_N: ACK cumulativo; o receptor só aceita o quadro esperado
+ *                     e o transmissor volta ao mais antigo quando o tempo vence
+ *      ARQ_SELETIVO:  ACK por quadro; o receptor guarda os quadros fora de
+ *                     ordem e só os perdidos são retransmitidos
+ *
+ * Quadros acima de MAX_DATA usam SOH e LEN em varint, só depois que o
+ * receptor anunciou que os aceita. A negociação é feita no modo original:
+ * com tx_anuncio_pendente o transmissor envia SOH 0x00 0x00 CHK ETX; um
+ * receptor novo responde ACK e o seu máximo em varint, um antigo ignora o
+ * SOH e o tempo vence (precisa de arq_timeout > 0). O resultado fica em
+ * tx_ext_max e vale também para o modo com janela.
+ */
+typedef enum {
+    ARQ_GO_BACK_N,
+    ARQ_SELETIVO
+} ArqModo;
+
 // ================= ESTRUTURAS =================
 typedef struct {
-    unsigned char data[MAX_DATA];
-    unsigned char size;
-    unsigned char chk;
+    unsigned char data[TAM_DATA];
+    unsigned short size;
+    unsigned char seq;      // número de sequência (só com janela)
+    unsigned char estendido;    // SOH + LEN em vez de STX + QTD
+    uint32_t chk;
 } Packet;
 
-// ================= CANAL SIMULADO =================
-static struct pt_sem data_sem;
-static struct pt_sem ack_sem;
-static unsigned char channel_data;
-static unsigned char channel_ack;
+// ================= ENLACE SIMULADO =================
+// Cada sentido é uma fila de bytes com instante de chegada. A linha envia um
+// byte por marca de tempo; cada byte chega 'latencia' marcas depois e é
+// corrompido (um bit invertido) com probabilidade 'erro_ppm' por milhão.
+#define LINK_SIZE 8192
+
+typedef struct {
+    unsigned char byte[LINK_SIZE];
+    unsigned long chegada[LINK_SIZE];
+    unsigned long head;
+    unsigned long tail;
+    unsigned long livre;        // marca em que a linha fica livre
+    unsigned long latencia;
+    unsigned long erro_ppm;
+} Link;
+
+static Link data_link;          // transmissor -> receptor
+static Link ack_link;           // receptor -> transmissor
+static unsigned long agora;     // relógio da simulação, em marcas de tempo
+static uint32_t semente = 1;
+
+// Gerador xorshift: a simulação se repete igual a cada execução
+uint32_t aleatorio(void) {
+    semente ^= semente << 13;
+    semente ^= semente >> 17;
+    semente ^= semente << 5;
+    return semente;
+}
+
+void link_init(Link *link, unsigned long latencia, unsigned long erro_ppm) {
+    link->head = 0;
+    link->tail = 0;
+    link->livre = 0;
+    link->latencia = latencia;
+    link->erro_ppm = erro_ppm;
+}
+
+int link_pode_enviar(Link *link) {
+    return link->head - link->tail < LINK_SIZE && link->livre <= agora;
+}
+
+void link_envia(Link *link, unsigned char byte) {
+    if(link->erro_ppm > 0 && aleatorio() % 1000000 < link->erro_ppm) {
+        byte ^= (unsigned char)(1u << (aleatorio() % 8));
+    }
+    link->byte[link->head % LINK_SIZE] = byte;
+    link->chegada[link->head % LINK_SIZE] = agora + link->latencia;
+    link->head++;
+    link->livre = agora + 1;
+}
+
+int link_disponivel(Link *link) {
+    return link->head != link->tail && link->chegada[link->tail % LINK_SIZE] <= agora;
+}
+
+unsigned char link_recebe(Link *link) {
+    return link->byte[link->tail++ % LINK_SIZE];
+}
+
+// Dentro de uma protothread: esperam a linha livre ou um byte chegar
+#define SEND_BYTE(pt, link, b)                       \
+    do {                                             \
+        PT_WAIT_UNTIL(pt, link_pode_enviar(link));   \
+        link_envia(link, (b));                       \
+    } while(0)
+
+#define RECEIVE_BYTE(pt, link, var)                  \
+    do {                                             \
+        PT_WAIT_UNTIL(pt, link_disponivel(link));    \
+        (var) = link_recebe(link);                   \
+    } while(0)
+
+// Recebe um varint de até MAX_LEN_BYTES; 'var' > 0xFFFF indica erro
+#define RECEIVE_VARINT(pt, link, var, tmp, shift)                        \
+    do {                                                                 \
+        (var) = 0;                                                       \
+        (shift) = 0;                                                     \
+        do {                                                             \
+            RECEIVE_BYTE(pt, link, tmp);                                 \
+            (var) |= (unsigned long)((tmp) & 0x7F) << (shift);           \
+            (shift) += 7;                                                \
+        } while(((tmp) & 0x80) && (shift) < 7 * MAX_LEN_BYTES);          \
+        if(((tmp) & 0x80) || (var) > 0xFFFF) (var) = 0x10000;            \
+    } while(0)
 
 // ================= VARIÁVEIS GLOBAIS =================
 Packet tx_packet;
 Packet rx_packet;
 
+unsigned char arq_janela = 0;           // 0: pare-e-espere original
+ArqModo arq_modo = ARQ_GO_BACK_N;
+unsigned long arq_timeout = 0;          // marcas até retransmitir (0: espera indefinida)
+
+// Quadros estendidos
+unsigned short rx_ext_max = 0;          // maior LEN aceito pelo receptor (0: receptor antigo)
+unsigned short tx_ext_max = 0;          // anunciado pelo receptor (0: só o formato original)
+int tx_anuncio_pendente = 0;            // pergunta ao receptor antes do próximo quadro
+
+// Estatísticas
+unsigned long tx_confirmados;
+unsigned long tx_descartados;           // desistências após MAX_RETRIES (modo original)
+unsigned long tx_enviados;              // quadros transmitidos, inclusive repetidos
+unsigned long tx_retransmissoes;
+unsigned long rx_entregues;
+
+// Chamada a cada quadro entregue à aplicação (em ordem, com janela)
+void (*rx_entrega)(const Packet *pkt);
+
+// Transmissor com janela: quadros [arq_base, arq_fim) ocupam os slots seq % ARQ_JANELA_MAX
+static Packet arq_tx[ARQ_JANELA_MAX];
+static unsigned long arq_enviado_em[ARQ_JANELA_MAX];
+static unsigned char arq_confirmado[ARQ_JANELA_MAX];
+static unsigned long arq_base;          // quadro mais antigo sem confirmação
+static unsigned long arq_proximo;       // próximo a enviar (Go-Back-N volta para arq_base)
+static unsigned long arq_maior;         // maior arq_proximo já alcançado
+static unsigned long arq_fim;           // quadros entregues pela aplicação
+static int arq_em_envio;
+static unsigned long arq_quadro_em_envio;
+
+// Receptor com janela
+static unsigned long arq_esperado;      // próximo quadro a entregar
+static Packet arq_rx[ARQ_JANELA_MAX];   // quadros fora de ordem (seletivo)
+static unsigned char arq_rx_ok[ARQ_JANELA_MAX];
+
 // ================= FUNÇÕES AUXILIARES =================
-unsigned char calculate_checksum(Packet *pkt) {
-    unsigned char chk = STX;
-    chk ^= pkt->size;
-    for(int i = 0; i < pkt->size; i++)
-        chk ^= pkt->data[i];
-    return chk;
+// Codifica 'value' em varint; retorna o número de bytes (1 a 3)
+int encode_varint(unsigned short value, unsigned char *out) {
+    int n = 0;
+    while(value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// Bytes entre o início do quadro e os dados: STX [SEQ] QTD ou SOH [SEQ] LEN
+int packet_header(Packet *pkt, unsigned char *out) {
+    int n = 0;
+    out[n++] = pkt->estendido ? SOH : STX;
+    if(arq_janela > 0) {
+        out[n++] = pkt->seq;
+    }
+    if(pkt->estendido) {
+        n += encode_varint(pkt->size, &out[n]);
+    } else {
+        out[n++] = (unsigned char)pkt->size;
+    }
+    return n;
+}
+
+uint32_t calculate_checksum(Packet *pkt) {
+    unsigned char header[2 + MAX_LEN_BYTES];
+    int n = packet_header(pkt, header);
+    uint32_t chk = check_update(CHK_TIPO, check_init(CHK_TIPO), header, n);
+    chk = check_update(CHK_TIPO, chk, pkt->data, pkt->size);
+    return check_final(CHK_TIPO, chk);
+}
+
+// Anúncio SOH 0x00 MAX: LEN zero seguido do máximo em varint
+uint32_t announce_checksum(unsigned short max) {
+    unsigned char header[2 + MAX_LEN_BYTES] = {SOH, 0x00};
+    int n = 2 + encode_varint(max, &header[2]);
+    return check_final(CHK_TIPO, check_update(CHK_TIPO, check_init(CHK_TIPO), header, n));
 }
 
-int is_valid_packet_size(unsigned char size) {
+int is_valid_packet_size(unsigned int size) {
     return size <= MAX_DATA;
 }
 
-void send_byte(struct pt *pt, unsigned char byte) {
-    channel_data = byte;
-    PT_SEM_SIGNAL(pt, &data_sem);
+// Maior quadro que o transmissor pode enviar
+unsigned int tx_max(void) {
+    return tx_ext_max > MAX_DATA ? tx_ext_max : MAX_DATA;
+}
+
+void entrega(const Packet *pkt) {
+    rx_entregues++;
+    if(rx_entrega != NULL) {
+        rx_entrega(pkt);
+    }
+}
+
+// Reinicia transmissor e receptor no modo escolhido
+void arq_reinicia(unsigned char janela, ArqModo modo, unsigned long timeout) {
+    assert(janela <= ARQ_JANELA_MAX);
+    arq_janela = janela;
+    arq_modo = modo;
+    arq_timeout = timeout;
+    arq_base = arq_proximo = arq_maior = arq_fim = 0;
+    arq_em_envio = 0;
+    arq_esperado = 0;
+    memset(arq_rx_ok, 0, sizeof(arq_rx_ok));
+    tx_packet.size = 0;
+    tx_confirmados = tx_descartados = tx_enviados = tx_retransmissoes = 0;
+    rx_entregues = 0;
 }
 
-unsigned char receive_byte(struct pt *pt) {
-    PT_SEM_WAIT(pt, &data_sem);
-    return channel_data;
+// ================= ARQ: TRANSMISSOR =================
+// Há espaço na janela para mais um quadro da aplicação?
+int arq_pode_enviar(void) {
+    if(arq_fim - arq_base >= arq_janela) {
+        return 0;
+    }
+    // Não reutiliza o slot do quadro que está saindo pela linha
+    return !(arq_em_envio && (arq_fim - arq_quadro_em_envio) % ARQ_JANELA_MAX == 0);
 }
 
-void send_ack(struct pt *pt, unsigned char ack) {
-    channel_ack = ack;
-    PT_SEM_SIGNAL(pt, &ack_sem);
+// Retorna 0 com a janela cheia ou quadro maior que o receptor aceita
+int arq_envia(const unsigned char *data, unsigned short size) {
+    if(!arq_pode_enviar() || size > tx_max()) {
+        return 0;
+    }
+    Packet *pkt = &arq_tx[arq_fim % ARQ_JANELA_MAX];
+    memcpy(pkt->data, data, size);
+    pkt->size = size;
+    pkt->estendido = size > MAX_DATA;
+    pkt->seq = (unsigned char)arq_fim;
+    pkt->chk = calculate_checksum(pkt);
+    arq_confirmado[arq_fim % ARQ_JANELA_MAX] = 0;
+    arq_fim++;
+    return 1;
 }
 
-unsigned char receive_ack(struct pt *pt) {
-    PT_SEM_WAIT(pt, &ack_sem);
-    return channel_ack;
+int arq_tempo_vencido(unsigned long quadro) {
+    return arq_timeout > 0 && agora - arq_enviado_em[quadro % ARQ_JANELA_MAX] >= arq_timeout;
+}
+
+// Escolhe o próximo quadro a transmitir; retorna 0 se nenhum
+int arq_seleciona(unsigned long *quadro) {
+    if(arq_proximo < arq_base) {
+        arq_proximo = arq_base;     // confirmado enquanto voltava (Go-Back-N)
+    }
+
+    if(arq_modo == ARQ_GO_BACK_N) {
+        // Só o temporizador do mais antigo importa: ao vencer, volta N
+        if(arq_base < arq_proximo && arq_tempo_vencido(arq_base)) {
+            arq_proximo = arq_base;
+        }
+    } else {
+        for(unsigned long n = arq_base; n < arq_maior; n++) {
+            if(!arq_confirmado[n % ARQ_JANELA_MAX] && arq_tempo_vencido(n)) {
+                *quadro = n;
+                tx_retransmissoes++;
+                return 1;
+            }
+        }
+    }
+
+    if(arq_proximo < arq_fim && arq_proximo < arq_base + arq_janela) {
+        *quadro = arq_proximo++;
+        if(*quadro < arq_maior) {
+            tx_retransmissoes++;
+        }
+        if(arq_proximo > arq_maior) {
+            arq_maior = arq_proximo;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// Resposta do receptor para o quadro com número 'seq'
+void arq_processa_resposta(unsigned char tipo, unsigned char seq) {
+    // Número completo do quadro; fora de [arq_base, arq_maior) é resposta antiga
+    unsigned long n = arq_base + (unsigned char)(seq - (unsigned char)arq_base);
+    if(n >= arq_maior) {
+        return;
+    }
+
+    if(tipo == NAK) {
+        // Vence o temporizador para retransmitir já
+        arq_enviado_em[n % ARQ_JANELA_MAX] = agora - arq_timeout;
+    } else if(arq_modo == ARQ_GO_BACK_N) {
+        // Cumulativo: confirma todos até 'n'
+        tx_confirmados += n + 1 - arq_base;
+        arq_base = n + 1;
+    } else {
+        arq_confirmado[n % ARQ_JANELA_MAX] = 1;
+        while(arq_base < arq_maior && arq_confirmado[arq_base % ARQ_JANELA_MAX]) {
+            arq_base++;
+            tx_confirmados++;
+        }
+    }
+}
+
+// ================= ARQ: RECEPTOR =================
+// Quadro válido recebido: entrega em ordem e retorna o SEQ a confirmar
+unsigned char arq_recebe_quadro(Packet *pkt) {
+    unsigned char distancia = (unsigned char)(pkt->seq - (unsigned char)arq_esperado);
+
+    if(arq_modo == ARQ_GO_BACK_N) {
+        if(distancia == 0) {
+            entrega(pkt);
+            arq_esperado++;
+        }
+        // Confirma o último recebido em ordem (repete o ACK se fora de ordem)
+        return (unsigned char)(arq_esperado - 1);
+    }
+
+    if(distancia < arq_janela) {
+        unsigned long slot = (arq_esperado + distancia) % ARQ_JANELA_MAX;
+        if(!arq_rx_ok[slot]) {
+            arq_rx[slot] = *pkt;
+            arq_rx_ok[slot] = 1;
+        }
+        while(arq_rx_ok[arq_esperado % ARQ_JANELA_MAX]) {
+            arq_rx_ok[arq_esperado % ARQ_JANELA_MAX] = 0;
+            entrega(&arq_rx[arq_esperado % ARQ_JANELA_MAX]);
+            arq_esperado++;
+        }
+    }
+    // Quadros repetidos (ACK perdido) também são confirmados
+    return pkt->seq;
 }
 
 // ================= PROTOTHREAD RECEPTORA =================
 static PT_THREAD(protothread_rx(struct pt *pt)) {
     static unsigned char byte;
-    static unsigned char idx;
+    static unsigned short idx;
+    static unsigned long len;
+    static unsigned char shift;
+    static unsigned char resposta[1 + MAX_LEN_BYTES];
+    static unsigned char resposta_len;
 
     PT_BEGIN(pt);
 
     while(1) {
-        // Recebe STX
-        byte = receive_byte(pt);
-        if(byte != STX) continue;
+        // Recebe STX (ou SOH, se aceita quadros estendidos)
+        RECEIVE_BYTE(pt, &data_link, byte);
+        if(byte == STX) {
+            rx_packet.estendido = 0;
+            RECEIVE_BYTE(pt, &data_link, byte);
+            len = byte;
+        } else if(byte == SOH && rx_ext_max > 0) {
+            rx_packet.estendido = 1;
+            RECEIVE_VARINT(pt, &data_link, len, byte, shift);
+        } else {
+            continue;
+        }
+
+        // LEN zero: o transmissor pergunta o máximo aceito
+        if(rx_packet.estendido && len == 0) {
+            RECEIVE_VARINT(pt, &data_link, len, byte, shift);
+            rx_packet.chk = 0;
+            idx = 0;
+            while(idx < check_size(CHK_TIPO)) {
+                RECEIVE_BYTE(pt, &data_link, byte);
+                rx_packet.chk = (rx_packet.chk << 8) | byte;
+                idx++;
+            }
+            RECEIVE_BYTE(pt, &data_link, byte);
+            if(len > 0xFFFF || byte != ETX ||
+               announce_checksum((unsigned short)len) != rx_packet.chk) {
+                continue;
+            }
+            resposta[0] = ACK;
+            resposta_len = (unsigned char)(1 + encode_varint(rx_ext_max, &resposta[1]));
+            idx = 0;
+            while(idx < resposta_len) {
+                SEND_BYTE(pt, &ack_link, resposta[idx]);
+                idx++;
+            }
+            continue;
+        }
 
         // Recebe tamanho
-        rx_packet.size = receive_byte(pt);
-        if(!is_valid_packet_size(rx_packet.size)) {
-            send_ack(pt, NAK);
+        if(rx_packet.estendido ? len > rx_ext_max : !is_valid_packet_size(len)) {
+            SEND_BYTE(pt, &ack_link, NAK);
             continue;
         }
+        rx_packet.size = (unsigned short)len;
 
         // Recebe dados
         idx = 0;
         while(idx < rx_packet.size) {
-            rx_packet.data[idx++] = receive_byte(pt);
+            RECEIVE_BYTE(pt, &data_link, rx_packet.data[idx]);
+            idx++;
         }
 
-        // Recebe checksum
-        rx_packet.chk = receive_byte(pt);
+        // Recebe checksum (1, 2 ou 4 bytes, MSB primeiro)
+        rx_packet.chk = 0;
+        idx = 0;
+        while(idx < check_size(CHK_TIPO)) {
+            RECEIVE_BYTE(pt, &data_link, byte);
+            rx_packet.chk = (rx_packet.chk << 8) | byte;
+            idx++;
+        }
 
         // Verifica checksum
         if(calculate_checksum(&rx_packet) != rx_packet.chk) {
-            send_ack(pt, NAK);
+            SEND_BYTE(pt, &ack_link, NAK);
             continue;
         }
 
         // Espera ETX
-        byte = receive_byte(pt);
+        RECEIVE_BYTE(pt, &data_link, byte);
         if(byte != ETX) {
-            send_ack(pt, NAK);
+            SEND_BYTE(pt, &ack_link, NAK);
             continue;
         }
 
         // Pacote correto
-        send_ack(pt, ACK);
+        entrega(&rx_packet);
+        SEND_BYTE(pt, &ack_link, ACK);
 
         PT_YIELD(pt);
     }
@@ -111,39 +473,161 @@ static PT_THREAD(protothread_rx(struct pt *pt)) {
     PT_END(pt);
 }
 
+// Receptor com janela: mesmo quadro com SEQ; responde ACK/NAK SEQ ~SEQ
+static PT_THREAD(protothread_arq_rx(struct pt *pt)) {
+    static unsigned char byte;
+    static unsigned short idx;
+    static unsigned long len;
+    static unsigned char shift;
+    static unsigned char resposta;
+    static unsigned char resposta_seq;
+
+    PT_BEGIN(pt);
+    (void)PT_YIELD_FLAG;    // sem PT_YIELD: o laço só cede nas esperas
+
+    while(1) {
+        RECEIVE_BYTE(pt, &data_link, byte);
+        if(byte != STX && !(byte == SOH && rx_ext_max > 0)) continue;
+        rx_packet.estendido = (byte == SOH);
+
+        RECEIVE_BYTE(pt, &data_link, rx_packet.seq);
+        if(rx_packet.estendido) {
+            RECEIVE_VARINT(pt, &data_link, len, byte, shift);
+            // LEN acima do aceito: descarta e espera a retransmissão
+            if(len > rx_ext_max) continue;
+        } else {
+            RECEIVE_BYTE(pt, &data_link, byte);
+            len = byte;
+        }
+        rx_packet.size = (unsigned short)len;
+
+        idx = 0;
+        while(idx < rx_packet.size) {
+            RECEIVE_BYTE(pt, &data_link, rx_packet.data[idx]);
+            idx++;
+        }
+
+        rx_packet.chk = 0;
+        idx = 0;
+        while(idx < check_size(CHK_TIPO)) {
+            RECEIVE_BYTE(pt, &data_link, byte);
+            rx_packet.chk = (rx_packet.chk << 8) | byte;
+            idx++;
+        }
+
+        // Com erro, pede o quadro esperado
+        resposta = NAK;
+        resposta_seq = (unsigned char)arq_esperado;
+        if(calculate_checksum(&rx_packet) == rx_packet.chk) {
+            RECEIVE_BYTE(pt, &data_link, byte);
+            if(byte == ETX) {
+                resposta = ACK;
+                resposta_seq = arq_recebe_quadro(&rx_packet);
+            }
+        }
+
+        SEND_BYTE(pt, &ack_link, resposta);
+        SEND_BYTE(pt, &ack_link, resposta_seq);
+        SEND_BYTE(pt, &ack_link, (unsigned char)~resposta_seq);
+    }
+
+    PT_END(pt);
+}
+
 // ================= PROTOTHREAD TRANSMISSORA =================
 static PT_THREAD(protothread_tx(struct pt *pt)) {
-    static unsigned char idx;
+    static unsigned short idx;
     static unsigned char retry_count;
     static unsigned char ack;
+    static unsigned long enviado_em;
+    static unsigned long max;
+    static unsigned char shift;
+    static unsigned char header[2 + MAX_LEN_BYTES];
+    static unsigned char header_len;
 
     PT_BEGIN(pt);
 
     while(1) {
-        PT_WAIT_UNTIL(pt, tx_packet.size > 0);
+        PT_WAIT_UNTIL(pt, tx_packet.size > 0 || tx_anuncio_pendente);
+
+        // Pergunta ao receptor se aceita quadros estendidos
+        if(tx_anuncio_pendente) {
+            SEND_BYTE(pt, &data_link, SOH);
+            SEND_BYTE(pt, &data_link, 0x00);
+            SEND_BYTE(pt, &data_link, 0x00);
+            idx = 0;
+            while(idx < check_size(CHK_TIPO)) {
+                SEND_BYTE(pt, &data_link, check_byte(CHK_TIPO, announce_checksum(0), idx));
+                idx++;
+            }
+            SEND_BYTE(pt, &data_link, ETX);
+
+            // Receptor antigo não responde: continua no formato original
+            enviado_em = agora;
+            PT_WAIT_UNTIL(pt, link_disponivel(&ack_link) ||
+                              (arq_timeout > 0 && agora - enviado_em >= arq_timeout));
+            tx_anuncio_pendente = 0;
+            tx_ext_max = 0;
+            if(link_disponivel(&ack_link) && link_recebe(&ack_link) == ACK) {
+                RECEIVE_VARINT(pt, &ack_link, max, ack, shift);
+                if(max > TAM_DATA) {
+                    max = TAM_DATA;     // não transmite mais que o próprio buffer
+                }
+                tx_ext_max = (unsigned short)max;
+            }
+            continue;
+        }
+
+        // Acima do que o receptor aceita não há como transmitir
+        if(tx_packet.size > tx_max()) {
+            tx_packet.size = 0;
+            tx_descartados++;
+            continue;
+        }
+        tx_packet.estendido = tx_packet.size > MAX_DATA;
         retry_count = 0;
 
         retransmit:
-        send_byte(pt, STX);
-        send_byte(pt, tx_packet.size);
+        header_len = (unsigned char)packet_header(&tx_packet, header);
+        idx = 0;
+        while(idx < header_len) {
+            SEND_BYTE(pt, &data_link, header[idx]);
+            idx++;
+        }
 
         idx = 0;
         while(idx < tx_packet.size) {
-            send_byte(pt, tx_packet.data[idx++]);
+            SEND_BYTE(pt, &data_link, tx_packet.data[idx]);
+            idx++;
         }
 
         tx_packet.chk = calculate_checksum(&tx_packet);
-        send_byte(pt, tx_packet.chk);
-        send_byte(pt, ETX);
+        idx = 0;
+        while(idx < check_size(CHK_TIPO)) {
+            SEND_BYTE(pt, &data_link, check_byte(CHK_TIPO, tx_packet.chk, idx));
+            idx++;
+        }
+        SEND_BYTE(pt, &data_link, ETX);
+        tx_enviados++;
 
-        ack = receive_ack(pt);
+        // Sem resposta dentro de arq_timeout conta como NAK
+        enviado_em = agora;
+        PT_WAIT_UNTIL(pt, link_disponivel(&ack_link) ||
+                          (arq_timeout > 0 && agora - enviado_em >= arq_timeout));
+        ack = link_disponivel(&ack_link) ? link_recebe(&ack_link) : NAK;
 
         if(ack == ACK) {
             tx_packet.size = 0;
+            tx_confirmados++;
         } else if(ack == NAK) {
             retry_count++;
-            if(retry_count < MAX_RETRIES) goto retransmit;
-            else tx_packet.size = 0;
+            if(retry_count < MAX_RETRIES) {
+                tx_retransmissoes++;
+                goto retransmit;
+            } else {
+                tx_packet.size = 0;
+                tx_descartados++;
+            }
         }
 
         PT_YIELD(pt);
@@ -152,13 +636,174 @@ static PT_THREAD(protothread_tx(struct pt *pt)) {
     PT_END(pt);
 }
 
+// Transmissor com janela: envia quadros novos e retransmite os vencidos
+static PT_THREAD(protothread_arq_tx(struct pt *pt)) {
+    static unsigned long quadro;
+    static Packet *pkt;
+    static unsigned short idx;
+    static unsigned char header[2 + MAX_LEN_BYTES];
+    static unsigned char header_len;
+
+    PT_BEGIN(pt);
+    (void)PT_YIELD_FLAG;    // sem PT_YIELD: o laço só cede nas esperas
+
+    while(1) {
+        PT_WAIT_UNTIL(pt, arq_seleciona(&quadro));
+        pkt = &arq_tx[quadro % ARQ_JANELA_MAX];
+        arq_em_envio = 1;
+        arq_quadro_em_envio = quadro;
+
+        header_len = (unsigned char)packet_header(pkt, header);
+        idx = 0;
+        while(idx < header_len) {
+            SEND_BYTE(pt, &data_link, header[idx]);
+            idx++;
+        }
+
+        idx = 0;
+        while(idx < pkt->size) {
+            SEND_BYTE(pt, &data_link, pkt->data[idx]);
+            idx++;
+        }
+
+        idx = 0;
+        while(idx < check_size(CHK_TIPO)) {
+            SEND_BYTE(pt, &data_link, check_byte(CHK_TIPO, pkt->chk, idx));
+            idx++;
+        }
+        SEND_BYTE(pt, &data_link, ETX);
+
+        // O temporizador do quadro conta a partir do último byte
+        arq_enviado_em[quadro % ARQ_JANELA_MAX] = agora;
+        arq_em_envio = 0;
+        tx_enviados++;
+    }
+
+    PT_END(pt);
+}
+
+// Respostas do receptor chegam em paralelo com a transmissão
+static PT_THREAD(protothread_arq_ack(struct pt *pt)) {
+    static unsigned char tipo;
+    static unsigned char seq;
+    static unsigned char complemento;
+
+    PT_BEGIN(pt);
+    (void)PT_YIELD_FLAG;    // sem PT_YIELD: o laço só cede nas esperas
+
+    while(1) {
+        RECEIVE_BYTE(pt, &ack_link, tipo);
+        if(tipo != ACK && tipo != NAK) continue;
+
+        RECEIVE_BYTE(pt, &ack_link, seq);
+        RECEIVE_BYTE(pt, &ack_link, complemento);
+        if(complemento != (unsigned char)~seq) continue;
+
+        arq_processa_resposta(tipo, seq);
+    }
+
+    PT_END(pt);
+}
+
+// ================= SIMULAÇÃO =================
+static struct pt pt_rx, pt_tx, pt_ack;
+
+void simulacao_inicia(unsigned long latencia, unsigned long erro_ppm) {
+    link_init(&data_link, latencia, erro_ppm);
+    link_init(&ack_link, latencia, erro_ppm);
+    agora = 0;
+    semente = 1;
+    PT_INIT(&pt_rx);
+    PT_INIT(&pt_tx);
+    PT_INIT(&pt_ack);
+}
+
+// Uma marca de tempo: executa as protothreads do modo atual
+void simulacao_marca(void) {
+    if(arq_janela == 0) {
+        protothread_tx(&pt_tx);
+        protothread_rx(&pt_rx);
+    } else {
+        protothread_arq_tx(&pt_tx);
+        protothread_arq_ack(&pt_ack);
+        protothread_arq_rx(&pt_rx);
+    }
+    agora++;
+}
+
+// Conteúdo do quadro 'numero' da sequência de teste
+unsigned short gera_quadro(unsigned long numero, unsigned char *data, unsigned short size) {
+    for(int i = 0; i < size; i++) {
+        data[i] = (unsigned char)(numero * 31 + i);
+    }
+    data[0] = (unsigned char)numero;
+    data[1] = (unsigned char)(numero >> 8);
+    return size;
+}
+
+// Confere que os quadros chegam em ordem, sem falta nem repetição. Com
+// XOR8, dois bits invertidos na mesma posição passam pela verificação:
+// esses quadros são contados em vez de interromper a simulação.
+static unsigned long verifica_proximo;
+unsigned long rx_corrompidos;
+
+void verifica_ordem(const Packet *pkt) {
+    unsigned char esperado[TAM_DATA];
+    gera_quadro(verifica_proximo, esperado, pkt->size);
+    if(memcmp(pkt->data, esperado, pkt->size) != 0) {
+        rx_corrompidos++;
+    }
+    verifica_proximo++;
+}
+
+/*
+ * Envia 'quadros' quadros de 'tamanho' bytes; retorna o número de marcas
+ * gastas até o último ser confirmado (ou desistido, no modo original).
+ */
+unsigned long simula(unsigned char janela, ArqModo modo, unsigned long latencia,
+                     unsigned long erro_ppm, unsigned long quadros, unsigned short tamanho) {
+    unsigned char data[TAM_DATA];
+    unsigned long gerados = 0;
+    // Ida e volta de um quadro e da resposta, com folga
+    unsigned long timeout = 2 * latencia + (tamanho + 8) + 16;
+
+    simulacao_inicia(latencia, erro_ppm);
+    arq_reinicia(janela, modo, timeout);
+    verifica_proximo = 0;
+    rx_corrompidos = 0;
+    rx_entrega = (janela > 0) ? verifica_ordem : NULL;
+
+    while(tx_confirmados + tx_descartados < quadros) {
+        if(janela == 0) {
+            if(tx_packet.size == 0 && gerados < quadros) {
+                tx_packet.size = gera_quadro(gerados++, tx_packet.data, tamanho);
+            }
+        } else {
+            while(gerados < quadros && arq_pode_enviar()) {
+                gera_quadro(gerados, data, tamanho);
+                arq_envia(data, tamanho);
+                gerados++;
+            }
+            assert(arq_fim - arq_base <= arq_janela);
+        }
+        simulacao_marca();
+    }
+
+    rx_entrega = NULL;
+    return agora;
+}
+
 // ================= TESTES TDD =================
 void test_checksum() {
-    Packet pkt = {{0x41, 0x42, 0x43}, 3, 0};
-    unsigned char chk = calculate_checksum(&pkt);
-    unsigned char expected = STX ^ 0x03 ^ 0x41 ^ 0x42 ^ 0x43;
+    Packet pkt = {{0x41, 0x42, 0x43}, 3, 0, 0, 0};
+    uint32_t chk = calculate_checksum(&pkt);
+    unsigned char frame[] = {STX, 0x03, 0x41, 0x42, 0x43};
+    uint32_t expected = check_final(CHK_TIPO, check_update(CHK_TIPO, check_init(CHK_TIPO), frame, sizeof(frame)));
+    if(CHK_TIPO == CHECK_XOR8) {
+        assert(expected == (STX ^ 0x03 ^ 0x41 ^ 0x42 ^ 0x43));
+    }
     assert(chk == expected);
-    printf("Checksum calculado corretamente: 0x%02X\n", chk);
+    printf("Checksum calculado corretamente: 0x%0*lX\n", 2 * (int)check_size(CHK_TIPO), (unsigned long)chk);
 }
 
 void test_packet_validation() {
@@ -169,26 +814,27 @@ void test_packet_validation() {
 }
 
 void test_ack_system() {
-    struct pt pt;
-    PT_INIT(&pt);
-    PT_SEM_INIT(&data_sem, 0);
-    PT_SEM_INIT(&ack_sem, 0);
+    simulacao_inicia(2, 0);
 
-    send_ack(&pt, ACK);
-    assert(channel_ack == ACK);
+    link_envia(&ack_link, ACK);
+    agora++;
+    link_envia(&ack_link, NAK);
 
-    send_ack(&pt, NAK);
-    assert(channel_ack == NAK);
+    // Cada byte só chega depois da latência
+    assert(!link_disponivel(&ack_link));
+    agora++;
+    assert(link_disponivel(&ack_link));
+    assert(link_recebe(&ack_link) == ACK);
+    assert(!link_disponivel(&ack_link));
+    agora++;
+    assert(link_recebe(&ack_link) == NAK);
 
     printf("Sistema ACK/NAK OK\n");
 }
 
 void test_complete_protocol() {
-    struct pt pt_rx, pt_tx;
-    PT_INIT(&pt_rx);
-    PT_INIT(&pt_tx);
-    PT_SEM_INIT(&data_sem, 0);
-    PT_SEM_INIT(&ack_sem, 0);
+    simulacao_inicia(0, 0);
+    arq_reinicia(0, ARQ_GO_BACK_N, 0);
 
     tx_packet.size = 3;
     tx_packet.data[0] = 0x41;
@@ -196,11 +842,12 @@ void test_complete_protocol() {
     tx_packet.data[2] = 0x43;
 
     for(int i=0; i<20; i++) {
-        protothread_tx(&pt_tx);
-        protothread_rx(&pt_rx);
+        simulacao_marca();
         if(tx_packet.size==0) break;
     }
 
+    assert(tx_packet.size == 0);
+    assert(tx_confirmados == 1);
     assert(rx_packet.size == 3);
     assert(rx_packet.data[0]==0x41);
     assert(rx_packet.data[1]==0x42);
@@ -209,22 +856,132 @@ void test_complete_protocol() {
     printf("Protocolo completo funcionando\n");
 }
 
+void test_arq_frame() {
+    simulacao_inicia(0, 0);
+    arq_reinicia(4, ARQ_GO_BACK_N, 100);
+
+    unsigned char data[] = {0x41, 0x42, 0x43};
+    assert(arq_envia(data, 3));
+
+    // STX SEQ QTD DADOS CHK ETX; o CHK cobre o SEQ
+    unsigned char frame[16];
+    int n = 0;
+    for(int i = 0; i < 20 && n < 3 + 3 + check_size(CHK_TIPO) + 1; i++) {
+        protothread_arq_tx(&pt_tx);
+        while(link_disponivel(&data_link)) {
+            frame[n++] = link_recebe(&data_link);
+        }
+        agora++;
+    }
+    unsigned char header[] = {STX, 0x00, 0x03, 0x41, 0x42, 0x43};
+    uint32_t chk = check_final(CHK_TIPO, check_update(CHK_TIPO, check_init(CHK_TIPO), header, sizeof(header)));
+    assert(memcmp(frame, header, sizeof(header)) == 0);
+    for(int i = 0; i < check_size(CHK_TIPO); i++) {
+        assert(frame[sizeof(header) + i] == check_byte(CHK_TIPO, chk, i));
+    }
+    assert(frame[sizeof(header) + check_size(CHK_TIPO)] == ETX);
+
+    printf("Quadro com número de sequência OK\n");
+}
+
+void test_arq_modes() {
+    // Enlace com latência e erros: tudo chega em ordem, uma vez só
+    const ArqModo modos[] = {ARQ_GO_BACK_N, ARQ_SELETIVO};
+    const unsigned char janelas[] = {1, 4, 16};
+
+    for(int m = 0; m < 2; m++) {
+        for(int j = 0; j < 3; j++) {
+            simula(janelas[j], modos[m], 50, 2000, 300, 32);
+            assert(tx_confirmados == 300);
+            assert(rx_entregues == 300);
+            assert(verifica_proximo == 300);
+            assert(tx_retransmissoes > 0);
+            assert(CHK_TIPO == CHECK_XOR8 || rx_corrompidos == 0);
+        }
+    }
+
+    // Sem erros não há retransmissão, e a janela encurta o tempo total
+    unsigned long pare_espere = simula(1, ARQ_GO_BACK_N, 100, 0, 100, 32);
+    assert(tx_retransmissoes == 0);
+    unsigned long janela8 = simula(8, ARQ_SELETIVO, 100, 0, 100, 32);
+    assert(tx_retransmissoes == 0);
+    assert(janela8 * 4 < pare_espere);
+
+    printf("Janela deslizante Go-Back-N e seletiva OK\n");
+}
+
+// Negocia com o receptor e envia um quadro de 'tamanho' bytes
+void envia_com_anuncio(unsigned short tamanho) {
+    simulacao_inicia(10, 0);
+    arq_reinicia(0, ARQ_GO_BACK_N, 100);
+    tx_anuncio_pendente = 1;
+    while(tx_anuncio_pendente) {
+        simulacao_marca();
+    }
+    for(int i = 0; i < 100; i++) {
+        simulacao_marca();     // resposta do anúncio, se houver
+    }
+
+    tx_packet.size = gera_quadro(7, tx_packet.data, tamanho);
+    while(tx_packet.size > 0) {
+        simulacao_marca();
+    }
+}
+
+void test_ext_frames() {
+    // Receptor antigo ignora o anúncio: quadro grande é descartado
+    rx_ext_max = 0;
+    envia_com_anuncio(300);
+    assert(tx_ext_max == 0);
+    assert(tx_descartados == 1 && rx_entregues == 0);
+
+    // Receptor novo responde com o máximo; 1000 bytes em um quadro
+    rx_ext_max = 1024;
+    envia_com_anuncio(1000);
+    assert(tx_ext_max == 1024);
+    assert(tx_confirmados == 1 && rx_entregues == 1);
+    assert(rx_packet.estendido && rx_packet.size == 1000);
+    unsigned char esperado[TAM_DATA];
+    gera_quadro(7, esperado, 1000);
+    assert(memcmp(rx_packet.data, esperado, 1000) == 0);
+
+    // Até MAX_DATA continua no formato original
+    envia_com_anuncio(MAX_DATA);
+    assert(tx_confirmados == 1 && !rx_packet.estendido);
+
+    // Com janela: SOH SEQ LEN, com erros no enlace
+    simula(8, ARQ_SELETIVO, 50, 200, 40, 600);
+    assert(tx_confirmados == 40 && verifica_proximo == 40);
+    assert(CHK_TIPO == CHECK_XOR8 || rx_corrompidos == 0);
+
+    // Acima do máximo anunciado o transmissor recusa
+    unsigned char data[TAM_DATA] = {0};
+    tx_ext_max = 512;
+    arq_reinicia(4, ARQ_SELETIVO, 100);
+    assert(!arq_envia(data, 513));
+    assert(arq_envia(data, 512));
+
+    rx_ext_max = 0;
+    tx_ext_max = 0;
+    printf("Quadros estendidos e negociação OK\n");
+}
+
 void run_all_tests() {
     printf("INICIANDO TESTES TDD...\n");
     test_checksum();
     test_packet_validation();
     test_ack_system();
     test_complete_protocol();
+    test_arq_frame();
+    test_arq_modes();
+    test_ext_frames();
     printf("TODOS OS TESTES PASSARAM!\n");
 }
 
 // ================= DEMONSTRAÇÃO =================
 void demonstration() {
-    struct pt pt_rx, pt_tx;
-    PT_INIT(&pt_rx);
-    PT_INIT(&pt_tx);
-    PT_SEM_INIT(&data_sem, 0);
-    PT_SEM_INIT(&ack_sem, 0);
+    simulacao_inicia(0, 0);
+    arq_reinicia(0, ARQ_GO_BACK_N, 0);
 
     tx_packet.size = 5;
     tx_packet.data[0]='H';
@@ -236,8 +993,7 @@ void demonstration() {
     printf("Transmitindo: HELLO\n");
 
     for(int i=0;i<30;i++) {
-        protothread_tx(&pt_tx);
-        protothread_rx(&pt_rx);
+        simulacao_marca();
         if(tx_packet.size==0) {
             printf("Transmissão completada com sucesso!\n");
             break;
@@ -245,9 +1001,85 @@ void demonstration() {
     }
 }
 
+// ================= BENCHMARK =================
+#define BENCH_QUADROS 1000
+#define BENCH_TAMANHO 32
+
+/*
+ * Vazão útil (bytes de dados confirmados / capacidade do enlace) para cada
+ * janela, comparada com o pare-e-espere original. Latência em tempos de
+ * byte: a 115200 bit/s, 100 marcas são cerca de 8,7 ms.
+ */
+void benchmark_arq() {
+    const unsigned long latencias[] = {10, 100, 1000};
+    const unsigned long erros_ppm[] = {0, 100, 1000};
+    const unsigned char janelas[] = {1, 4, 8, 16};
+    unsigned long corrompidos = 0;
+
+    printf("\n=== SIMULAÇÃO ARQ: vazão útil (%% da capacidade do enlace) ===\n");
+    printf("%d quadros de %d bytes\n", BENCH_QUADROS, BENCH_TAMANHO);
+    printf("latência  erro/byte  original |  GBN 1  GBN 4  GBN 8 GBN 16 |  SR 1   SR 4   SR 8  SR 16\n");
+
+    for(int l = 0; l < 3; l++) {
+        for(int e = 0; e < 3; e++) {
+            double util = (double)BENCH_QUADROS * BENCH_TAMANHO;
+            unsigned long marcas = simula(0, ARQ_GO_BACK_N, latencias[l], erros_ppm[e], BENCH_QUADROS, BENCH_TAMANHO);
+            printf("%8lu  %8.2f%%  %7.1f%% |", latencias[l], erros_ppm[e] / 1e4,
+                   100.0 * tx_confirmados * BENCH_TAMANHO / marcas);
+
+            for(int m = 0; m < 2; m++) {
+                for(int j = 0; j < 4; j++) {
+                    marcas = simula(janelas[j], m == 0 ? ARQ_GO_BACK_N : ARQ_SELETIVO,
+                                    latencias[l], erros_ppm[e], BENCH_QUADROS, BENCH_TAMANHO);
+                    printf(" %5.1f%%", 100.0 * util / marcas);
+                    corrompidos += rx_corrompidos;
+                }
+                printf(m == 0 ? " |" : "\n");
+            }
+        }
+    }
+    printf("Quadros com erro não detectado pela verificação (com janela): %lu\n", corrompidos);
+}
+
+/*
+ * Quadros estendidos: vazão útil com janela seletiva de 8 para tamanhos de
+ * quadro acima e abaixo do limite do formato original.
+ */
+void benchmark_tamanhos() {
+    const unsigned short tamanhos[] = {32, 255, 512, 1024};
+    const unsigned long erros_ppm[] = {0, 100, 1000};
+    unsigned long bytes = 64UL * 1024;
+
+    rx_ext_max = tx_ext_max = MAX_DATA_EXT;
+    printf("\n=== QUADROS ESTENDIDOS: vazão útil, SR 8, latência 100 ===\n");
+    printf("%lu bytes de dados\n", bytes);
+    printf("erro/byte");
+    for(int t = 0; t < 4; t++) {
+        printf(" %8u B", tamanhos[t]);
+    }
+    printf("\n");
+
+    for(int e = 0; e < 3; e++) {
+        printf("%8.2f%%", erros_ppm[e] / 1e4);
+        for(int t = 0; t < 4; t++) {
+            unsigned long quadros = bytes / tamanhos[t];
+            unsigned long marcas = simula(8, ARQ_SELETIVO, 100, erros_ppm[e], quadros, tamanhos[t]);
+            printf(" %9.1f%%", 100.0 * quadros * tamanhos[t] / marcas);
+        }
+        printf("\n");
+    }
+    rx_ext_max = tx_ext_max = 0;
+}
+
 // ================= MAIN =================
-int main() {
+int main(int argc, char **argv) {
     run_all_tests();
     demonstration();
+
+    // "./protothreads bench" executa também a simulação com janela
+    if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchmark_arq();
+        benchmark_tamanhos();
+    }
     return 0;
 }
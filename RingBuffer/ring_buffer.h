@@ -0,0 +1,134 @@
+/*
+ * ring_buffer.h
+ *
+ * Fila circular de bytes sem trava para um produtor e um consumidor
+ * (SPSC), para ficar entre a interrupcao da UART e os decodificadores.
+ *
+ *  - Produtor (interrupcao): ring_push(); escreve so em 'head'
+ *  - Consumidor (tarefa):    ring_peek_span() + ring_consume(), ou ring_pop();
+ *                            escreve so em 'tail'
+ *
+ * Cada indice tem um unico escritor, entao nao ha secao critica
+ * (REG_ATOMICA_INICIO) nem leitura-modificacao-escrita atomica: so leituras
+ * e escritas de palavra, com ordem acquire/release para que os dados sejam
+ * visiveis antes do indice. No Cortex-M0 isso vira LDR/STR com DMB.
+ *
+ * Os indices correm livremente e sao mascarados pelo tamanho, que deve ser
+ * potencia de 2; assim a fila usa todos os 'size' bytes.
+ */
+
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+typedef struct {
+    uint8_t* data;
+    size_t mask;                  // size - 1
+    atomic_size_t head;           // proximo byte a escrever (produtor)
+    atomic_size_t tail;           // proximo byte a ler (consumidor)
+    atomic_uint_least32_t overflows;   // bytes descartados com a fila cheia
+    atomic_size_t high_water;     // maior ocupacao observada pelo produtor
+} RingBuffer;
+
+/* 'size' deve ser potencia de 2; retorna false caso contrario */
+static inline bool ring_init(RingBuffer* ring, uint8_t* storage, size_t size) {
+    if (size == 0 || (size & (size - 1)) != 0) {
+        return false;
+    }
+    ring->data = storage;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overflows, 0);
+    atomic_init(&ring->high_water, 0);
+    return true;
+}
+
+/**********************
+ * PRODUTOR
+ **********************/
+/* Espaco livre, visto pelo produtor */
+static inline size_t ring_space(RingBuffer* ring) {
+    return ring->mask + 1 - (atomic_load_explicit(&ring->head, memory_order_relaxed) -
+                             atomic_load_explicit(&ring->tail, memory_order_acquire));
+}
+
+/* Insere um byte; com a fila cheia descarta o byte e conta o estouro */
+static inline bool ring_push(RingBuffer* ring, uint8_t byte) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t used = head - tail;
+
+    if (used > ring->mask) {
+        // So o produtor escreve o contador: nao precisa de soma atomica
+        atomic_store_explicit(&ring->overflows,
+                              atomic_load_explicit(&ring->overflows, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        return false;
+    }
+
+    ring->data[head & ring->mask] = byte;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (used + 1 > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, used + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+/**********************
+ * CONSUMIDOR
+ **********************/
+/* Bytes disponiveis para leitura */
+static inline size_t ring_count(RingBuffer* ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+/*
+ * Trecho continuo de bytes disponiveis a partir de 'tail', sem copiar.
+ * Quando os dados dao a volta no fim do vetor, retorna so a primeira parte;
+ * depois de ring_consume() a proxima chamada retorna o restante.
+ */
+static inline size_t ring_peek_span(RingBuffer* ring, const uint8_t** span) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t available = atomic_load_explicit(&ring->head, memory_order_acquire) - tail;
+    size_t offset = tail & ring->mask;
+    size_t until_end = ring->mask + 1 - offset;
+
+    *span = &ring->data[offset];
+    return (available < until_end) ? available : until_end;
+}
+
+/* Libera 'count' bytes ja lidos (count <= valor retornado por ring_peek_span) */
+static inline void ring_consume(RingBuffer* ring, size_t count) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+}
+
+static inline bool ring_pop(RingBuffer* ring, uint8_t* byte) {
+    const uint8_t* span;
+    if (ring_peek_span(ring, &span) == 0) {
+        return false;
+    }
+    *byte = *span;
+    ring_consume(ring, 1);
+    return true;
+}
+
+/**********************
+ * ESTATISTICAS
+ **********************/
+static inline uint32_t ring_overflows(RingBuffer* ring) {
+    return atomic_load_explicit(&ring->overflows, memory_order_relaxed);
+}
+
+static inline size_t ring_high_water(RingBuffer* ring) {
+    return atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+}
+
+#endif /* RING_BUFFER_H_ */
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ring_buffer.h"
+
+/*
+ * Testes da fila circular SPSC.
+ * Compilar com: gcc -O2 -pthread teste_ring_buffer.c -o teste_ring_buffer
+ */
+
+#define STRESS_BYTES 5000000UL
+#define STRESS_SIZE  256
+
+/**********************
+ * TESTES (TDD)
+ **********************/
+void test_init() {
+    printf("=== Teste ring_init ===\n");
+
+    uint8_t storage[16];
+    RingBuffer ring;
+    assert(!ring_init(&ring, storage, 0));
+    assert(!ring_init(&ring, storage, 12));
+    assert(ring_init(&ring, storage, 16));
+    assert(ring_count(&ring) == 0);
+    assert(ring_overflows(&ring) == 0);
+    assert(ring_high_water(&ring) == 0);
+
+    printf("Inicializacao OK ✓\n");
+}
+
+void test_fill_and_overflow() {
+    printf("\n=== Teste fila cheia e contador de estouro ===\n");
+
+    uint8_t storage[8];
+    RingBuffer ring;
+    ring_init(&ring, storage, sizeof(storage));
+
+    for (int i = 0; i < 8; i++) {
+        assert(ring_push(&ring, (uint8_t)i));
+    }
+    assert(!ring_push(&ring, 0xEE));
+    assert(!ring_push(&ring, 0xEE));
+    assert(ring_count(&ring) == 8);
+    assert(ring_overflows(&ring) == 2);
+    assert(ring_high_water(&ring) == 8);
+
+    for (int i = 0; i < 8; i++) {
+        uint8_t byte;
+        assert(ring_pop(&ring, &byte));
+        assert(byte == i);
+    }
+    uint8_t byte;
+    assert(!ring_pop(&ring, &byte));
+
+    printf("Estouros contados: %u, ocupacao maxima: %zu ✓\n",
+           ring_overflows(&ring), ring_high_water(&ring));
+}
+
+void test_span_wraparound() {
+    printf("\n=== Teste trechos continuos na volta do vetor ===\n");
+
+    uint8_t storage[8];
+    RingBuffer ring;
+    ring_init(&ring, storage, sizeof(storage));
+
+    // Avanca os indices para que os proximos dados deem a volta
+    for (int i = 0; i < 6; i++) {
+        ring_push(&ring, 0);
+    }
+    ring_consume(&ring, 6);
+
+    for (int i = 0; i < 5; i++) {
+        ring_push(&ring, (uint8_t)(0xA0 + i));
+    }
+
+    const uint8_t* span;
+    size_t length = ring_peek_span(&ring, &span);
+    assert(length == 2);
+    assert(span[0] == 0xA0 && span[1] == 0xA1);
+    ring_consume(&ring, length);
+
+    length = ring_peek_span(&ring, &span);
+    assert(length == 3);
+    assert(span == storage);
+    assert(span[0] == 0xA2 && span[2] == 0xA4);
+    ring_consume(&ring, length);
+    assert(ring_count(&ring) == 0);
+
+    printf("Trechos de 2 e 3 bytes na volta do vetor ✓\n");
+}
+
+/* Teste de estresse: uma thread faz o papel da interrupcao e outra da tarefa */
+typedef struct {
+    RingBuffer* ring;
+    int drop_when_full;        // 1: descarta como a ISR; 0: tenta de novo
+    unsigned long attempts;
+} Producer;
+
+void* producer_thread(void* arg) {
+    Producer* producer = (Producer*)arg;
+    uint8_t sequence = 0;
+
+    for (producer->attempts = 0; producer->attempts < STRESS_BYTES; producer->attempts++) {
+        // Sem descarte: espera espaco antes de inserir
+        while (!producer->drop_when_full && ring_space(producer->ring) == 0) {
+            sched_yield();
+        }
+        if (ring_push(producer->ring, sequence)) {
+            sequence++;
+        }
+    }
+    return NULL;
+}
+
+unsigned long stress(int drop_when_full) {
+    static uint8_t storage[STRESS_SIZE];
+    RingBuffer ring;
+    ring_init(&ring, storage, sizeof(storage));
+
+    Producer producer = {&ring, drop_when_full, 0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer_thread, &producer);
+
+    // Consumidor: drena trechos inteiros e confere a sequencia
+    uint8_t expected = 0;
+    unsigned long received = 0;
+    for (;;) {
+        const uint8_t* span;
+        size_t length = ring_peek_span(&ring, &span);
+        for (size_t i = 0; i < length; i++) {
+            assert(span[i] == expected);
+            expected++;
+        }
+        ring_consume(&ring, length);
+        received += length;
+
+        if (length == 0) {
+            if (received + ring_overflows(&ring) >= STRESS_BYTES) {
+                break;
+            }
+            sched_yield();      // fila vazia: da a vez ao produtor
+        }
+    }
+    pthread_join(thread, NULL);
+
+    assert(received + ring_overflows(&ring) == STRESS_BYTES);
+    if (!drop_when_full) {
+        assert(ring_overflows(&ring) == 0);
+    }
+    assert(ring_high_water(&ring) <= STRESS_SIZE);
+
+    printf("%lu bytes recebidos em ordem, %u descartados, ocupacao maxima %zu\n",
+           received, ring_overflows(&ring), ring_high_water(&ring));
+    return received;
+}
+
+void test_stress_two_threads() {
+    printf("\n=== Teste de estresse: produtor e consumidor em threads ===\n");
+
+    assert(stress(0) == STRESS_BYTES);
+    stress(1);
+
+    printf("Estresse com duas threads OK ✓\n");
+}
+
+void run_all_tests() {
+    printf("Iniciando testes TDD...\n");
+
+    test_init();
+    test_fill_and_overflow();
+    test_span_wraparound();
+    test_stress_two_threads();
+
+    printf("\n Todos os testes passaram!\n");
+}
+
+int main() {
+    run_all_tests();
+    return 0;
+}
@@ -8,6 +8,9 @@
 #include "cpu-port.h"
 #include "rtos.h"
 
+/* ciclos das marcas de tempo completas (LeContadorLivre) */
+static volatile uint32_t ciclos_marcas = 0;
+
 stackptr_t CriaContexto(tarefa_t endereco_tarefa, stackptr_t ptr_pilha)
 {
 	#define INITIAL_XPSR		0x01000000
@@ -54,6 +57,97 @@ void ConfiguraMarcaTempo(void)
 		*(NVIC_SYSTICK_CTRL) = NVIC_SYSTICK_CLK | NVIC_SYSTICK_INT | NVIC_SYSTICK_ENABLE;  // Inicia
 }
 
+#if cfg_MARCA_TEMPO_LIVRE
+/* Codigo dependente de hardware usado pela tarefa ociosa no modo sem marcas
+ * de tempo: o SysTick e reprogramado para um unico intervalo que termina na
+ * marca em que a proxima tarefa desperta e o processador dorme (WFI).
+ * Chamada com as interrupcoes desabilitadas */
+void DormeSemMarcas(tick_t marcas)
+{
+	uint32_t periodo = PERIODO_CONTADOR_CICLOS();
+	uint32_t restante, recarga, decorrido, falta;
+	tick_t completas;
+	
+	/* marca pendente: deixa a interrupcao do SysTick trata-la. O pedido
+	   pendente no ICSR (e nao o COUNTFLAG, que a leitura do CTRL limpa e
+	   pode ja ter sido consumido ou ser de uma volta antiga) fica em 1 ate
+	   o SysTick_Handler executar */
+	if(MARCA_PENDENTE())
+	{
+		return;
+	}
+	
+	/* o contador tem 24 bits */
+	if(marcas > 0x00FFFFFFUL / periodo)
+	{
+		marcas = (tick_t)(0x00FFFFFFUL / periodo);
+	}
+	
+	/* para o SysTick e conta o resto da marca atual mais (marcas - 1) marcas inteiras */
+	*(NVIC_SYSTICK_CTRL) = NVIC_SYSTICK_CLK | NVIC_SYSTICK_INT;
+	restante = LE_CONTADOR_CICLOS();
+	recarga = restante + (uint32_t)(marcas - 1) * periodo;
+	*(NVIC_SYSTICK_LOAD) = recarga;
+	*(NVIC_SYSTICK_VAL) = 0;
+	*(NVIC_SYSTICK_CTRL) = NVIC_SYSTICK_CLK | NVIC_SYSTICK_INT | NVIC_SYSTICK_ENABLE;
+	
+	AGUARDA_INTERRUPCAO();
+	
+	*(NVIC_SYSTICK_CTRL) = NVIC_SYSTICK_CLK | NVIC_SYSTICK_INT;
+	if(MARCA_PENDENTE())
+	{
+		/* intervalo completo: a interrupcao pendente do SysTick conta a ultima marca */
+		completas = marcas - 1;
+		falta = periodo;
+	}else
+	{
+		/* acordou antes por outra interrupcao: conta so as marcas que ja passaram */
+		decorrido = recarga - LE_CONTADOR_CICLOS();
+		if(decorrido < restante)
+		{
+			completas = 0;
+			falta = restante - decorrido;
+		}else
+		{
+			completas = (tick_t)(1 + (decorrido - restante) / periodo);
+			falta = periodo - (decorrido - restante) % periodo;
+		}
+	}
+	
+	/* termina a marca atual e volta ao periodo normal na recarga seguinte */
+	*(NVIC_SYSTICK_LOAD) = falta - 1;
+	*(NVIC_SYSTICK_VAL) = 0;
+	*(NVIC_SYSTICK_CTRL) = NVIC_SYSTICK_CLK | NVIC_SYSTICK_INT | NVIC_SYSTICK_ENABLE;
+	*(NVIC_SYSTICK_LOAD) = periodo - 1;
+	
+	ciclos_marcas += (uint32_t)completas * periodo;
+	CompensaMarcasDeTempo(completas);
+}
+#endif
+
+/* Codigo dependente de hardware usado para ler o contador livre do tempo
+ * de processador das tarefas. Se o SysTick ja recarregou e a interrupcao
+ * ainda esta pendente (no PendSV ou com as interrupcoes desabilitadas), a
+ * marca que ela vai somar e contada aqui; o laco repete se o SysTick_Handler
+ * executar no meio da leitura */
+uint32_t LeContadorLivre(void)
+{
+	uint32_t marcas, valor, periodo;
+	
+	do
+	{
+		marcas = ciclos_marcas;
+		periodo = PERIODO_CONTADOR_CICLOS();
+		valor = LE_CONTADOR_CICLOS();
+		if(MARCA_PENDENTE())
+		{
+			valor = LE_CONTADOR_CICLOS() - periodo;	/* marca pendente ja conta */
+		}
+	}while(marcas != ciclos_marcas);
+	
+	return marcas + periodo - 1 - valor;
+}
+
 /* rotinas de interrupcao necessarias */
 __attribute__ ((naked)) void SVC_Handler(void)
 {
@@ -86,8 +180,14 @@ __attribute__ ((naked)) void PendSV_Handler(void)
    realizar a marca de tempo do sistema multitarefas - interrupcao */
 void SysTick_Handler(void)
 {	
+	 RASTRO_ISR_ENTRA(EXCECAO_SYSTICK);
+	 ciclos_marcas += PERIODO_CONTADOR_CICLOS();
 	 
-	 ExecutaMarcaDeTempo();    
+	 if(ExecutaMarcaDeTempo())
+	 {
+		 SOLICITA_TROCA_CONTEXTO_ISR();	/* fim da fatia de tempo */
+	 }
+	 RASTRO_ISR_SAI(EXCECAO_SYSTICK);
 	 //TrocaContexto();   /* para o uso como sistema preemptivo */
 }
 
@@ -17,18 +17,24 @@
 /* tipo do ponteiro de pilha */
 typedef uint32_t* stackptr_t;
 
+/* tipo do SP usado por SALVA_SP/RESTAURA_SP: uma palavra de 32 bits */
+typedef uint32_t sp_t;
+
 
 /* registradores da cpu ARM Cortex-M*/
 #define NVIC_INT_CTRL_B         ( ( volatile unsigned long *) 0xe000ed04 )
 #define NVIC_SYSPRI3			( ( volatile unsigned long *) 0xe000ed20 )
 #define NVIC_SYSTICK_CTRL       ( ( volatile unsigned long *) 0xe000e010 )
 #define NVIC_SYSTICK_LOAD       ( ( volatile unsigned long *) 0xe000e014 )
+#define NVIC_SYSTICK_VAL        ( ( volatile unsigned long *) 0xe000e018 )
 
 #define NVIC_PENDSVSET      			0x10000000         			// Dispara excecao PendSV
 #define NVIC_PENDSVCLR      			0x08000000         			// Limpa a flag PendSV
+#define NVIC_PENDSTSET      			0x04000000         			// Interrupcao do SysTick pendente
 #define NVIC_SYSTICK_CLK        		0x00000004
 #define NVIC_SYSTICK_INT        		0x00000002
 #define NVIC_SYSTICK_ENABLE     		0x00000001
+#define NVIC_SYSTICK_COUNTFLAG     		0x00010000					// Contador chegou a zero (limpa na leitura)
 #define PRIO_BITS       		        4        					// 15 niveis de prioridade
 #define LOWEST_INTERRUPT_PRIORITY		0xF
 #define KERNEL_INTERRUPT_PRIORITY 		(LOWEST_INTERRUPT_PRIORITY << (8 - PRIO_BITS) )
@@ -40,8 +46,13 @@ typedef uint32_t* stackptr_t;
 #define REG_ATOMICA_INICIO()  	  __asm(" CPSID I");
 #define REG_ATOMICA_FIM()  		  __asm(" CPSIE I");
 
+/* regiao atomica que pode estar dentro de outra: guarda e restaura o PRIMASK */
+#define REG_ATOMICA_SALVA(estado)	  __asm volatile(" MRS %0, PRIMASK\n CPSID I" : "=r"(estado) :: "memory");
+#define REG_ATOMICA_RESTAURA(estado)  __asm volatile(" MSR PRIMASK, %0" :: "r"(estado) : "memory");
+
 #define TROCA_CONTEXTO()		*(NVIC_INT_CTRL_B) = NVIC_PENDSVSET; __asm(" CPSIE I");
 #define TrocaContexto()		    TROCA_CONTEXTO()
+#define SOLICITA_TROCA_CONTEXTO_ISR()	*(NVIC_INT_CTRL_B) = NVIC_PENDSVSET
 #define Clear_PendSV(void)		*(NVIC_INT_CTRL_B) = NVIC_PENDSVCLR
 
 #define GERA_INTERRUPCAO_SW()      __asm(  /* Call SVC to start the first task. */		\
@@ -88,6 +99,23 @@ typedef uint32_t* stackptr_t;
 									"BX      R1               	\n"						  \
 								)
 
+/* contador de ciclos: o Cortex-M0 nao tem DWT, usa o valor do SysTick (decrescente) */
+#define LE_CONTADOR_CICLOS()	(*(NVIC_SYSTICK_VAL))
+#define PERIODO_CONTADOR_CICLOS()	(*(NVIC_SYSTICK_LOAD) + 1)
+#define MARCA_PENDENTE()			(*(NVIC_INT_CTRL_B) & NVIC_PENDSTSET)
+
+/* contador livre de 32 bits (tempo de processador das tarefas): os ciclos
+   das marcas completas, somados pelo SysTick_Handler, mais os da marca atual */
+uint32_t LeContadorLivre(void);
+#define LE_CONTADOR_LIVRE()		LeContadorLivre()
+#define FREQUENCIA_CONTADOR_LIVRE	cfg_CPU_CLOCK_HZ
+
+/* numero da excecao do SysTick (rastro) */
+#define EXCECAO_SYSTICK			15
+
+/* dorme ate a proxima interrupcao; acorda mesmo com as interrupcoes desabilitadas */
+#define AGUARDA_INTERRUPCAO()	__asm(" DSB"); __asm(" WFI"); __asm(" ISB");
+
 #define SALVA_ISR()			// em branco para este processador
 
 #define RESTAURA_ISR()		__asm(							  \
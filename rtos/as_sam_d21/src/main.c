@@ -26,6 +26,7 @@
  * Inclusao de arquivos de cabecalhos
  */
 #include <asf.h>
+#include <stdio.h>
 #include "stdint.h"
 #include "rtos.h"
 
@@ -46,6 +47,12 @@ void tarefa_11(void);
 void tarefa_12(void);
 void tarefa_13(void);
 
+#define TAM_FILA_MENSAGENS 5
+uint8_t memoria_fila[TAM_FILA_MENSAGENS]; /* area estatica das mensagens da fila */
+fila_mensagens_t FilaMensagens; /* declaracao de uma fila de mensagens (tarefas 12 e 13) */
+volatile uint32_t mensagens_recebidas = 0;	/* contadas pela tarefa 13, mostradas pela tarefa 9 */
+volatile uint32_t mensagens_fora_de_ordem = 0;
+
 /*
  * Configuracao dos tamanhos das pilhas
  */
@@ -103,11 +110,13 @@ int main(void)
 
     CriaTarefa(tarefa_10, "Tarefa 10", PILHA_TAREFA_10, TAM_PILHA_10, 4);
 
-	CriaTarefa(tarefa_11, "Tarefa 11", PILHA_TAREFA_11, TAM_PILHA_11, 5);
+	CriaTarefa(tarefa_11, "Tarefa 11", PILHA_TAREFA_11, TAM_PILHA_11, 3);
+
+    FilaInicia(&FilaMensagens, memoria_fila, sizeof(uint8_t), TAM_FILA_MENSAGENS); /* antes das tarefas que a usam */
 
-    CriaTarefa(tarefa_12, "Tarefa 12", PILHA_TAREFA_12, TAM_PILHA_12, 6);
+    CriaTarefa(tarefa_12, "Tarefa 12", PILHA_TAREFA_12, TAM_PILHA_12, 3);
 
-    CriaTarefa(tarefa_13, "Tarefa 13", PILHA_TAREFA_13, TAM_PILHA_13, 7);
+    CriaTarefa(tarefa_13, "Tarefa 13", PILHA_TAREFA_13, TAM_PILHA_13, 4);
 	
 	/* Cria tarefa ociosa do sistema */
 	CriaTarefa(tarefa_ociosa,"Tarefa ociosa", PILHA_TAREFA_OCIOSA, TAM_PILHA_OCIOSA, 0);
@@ -178,7 +187,7 @@ void tarefa_4(void)
 
 /* Tarefas de exemplo que usam funcoes de semaforo */
 
-semaforo_t SemaforoTeste = {0,0}; /* declaracao e inicializacao de um semaforo */
+semaforo_t SemaforoTeste = {0, {0}}; /* declaracao e inicializacao de um semaforo */
 
 void tarefa_5(void)
 {
@@ -219,8 +228,8 @@ void tarefa_6(void)
 #define TAM_BUFFER 10
 uint8_t buffer[TAM_BUFFER]; /* declaracao de um buffer (vetor) ou fila circular */
 
-semaforo_t SemaforoCheio = {0,0}; /* declaracao e inicializacao de um semaforo */
-semaforo_t SemaforoVazio = {TAM_BUFFER,0}; /* declaracao e inicializacao de um semaforo */
+semaforo_t SemaforoCheio = {0, {0}}; /* declaracao e inicializacao de um semaforo */
+semaforo_t SemaforoVazio = {TAM_BUFFER, {0}}; /* declaracao e inicializacao de um semaforo */
 
 void tarefa_7(void)
 {
@@ -245,28 +254,12 @@ void tarefa_7(void)
 void tarefa_8(void)
 {
 	static uint8_t f = 0;
-	volatile uint8_t valor;
 		
 	for(;;)
 	{
-		volatile uint8_t contador;
-		
-		do{
-			REG_ATOMICA_INICIO();			
-				contador = SemaforoCheio.contador;			
-			REG_ATOMICA_FIM();
-			
-			if (contador == 0)
-			{
-				TarefaEspera(100);
-			}
-				
-		} while (!contador);
+		SemaforoAguarda(&SemaforoCheio);	/* espera na fila do semaforo, sem consultar o contador */
 		
-		SemaforoAguarda(&SemaforoCheio);
-		
-		valor = buffer[f];
-		f = (f+1) % TAM_BUFFER;		
+		f = (f+1) % TAM_BUFFER;		/* consome buffer[f] */
 		
 		SemaforoLibera(&SemaforoVazio);
 	}
@@ -279,15 +272,18 @@ void tarefa_9(void)
     for(;;)
     {
         contador++;
-        printf("Tarefa 9 executando... contador = %lu\r\n", contador);
+        printf("Tarefa 9 executando... contador = %lu, mensagens = %lu (fora de ordem: %lu)\r\n",
+               (unsigned long)contador, (unsigned long)mensagens_recebidas,
+               (unsigned long)mensagens_fora_de_ordem);
         TarefaEspera(1000);   // espera 1000 ticks (~1s)
     }
 }
 
-// tafera preemptiva (executada a cada 100 ms)
+// tafera preemptiva (executada a cada 100 ms, sem deriva: o tempo do laco nao atrasa a proxima)
 void tarefa_10(void)
 {
     int led = false;
+    uint64_t proxima = MarcasDeTempo();
 	for(;;)
 	{
         REG_ATOMICA_INICIO();
@@ -296,7 +292,7 @@ void tarefa_10(void)
 			port_pin_set_output_level(LED_0_PIN, led);
         }
         REG_ATOMICA_FIM();
-        TarefaEspera(100);
+        TarefaPeriodica(&proxima, 100);
 	}
 }
 
@@ -314,25 +310,21 @@ void tarefa_11(void)
 	}
 }
 
-uint8_t buffer[5]; /* declaracao de um buffer (vetor) ou fila circular */
-
-semaforo_t SemaforoCheio = {0,0}; /* declaracao e inicializacao de um semaforo */
-semaforo_t SemaforoVazio = {5,0}; /* declaracao e inicializacao de um semaforo */
+/* Tarefas de exemplo que usam a fila de mensagens do sistema */
 
 void tarefa_12(void)
 {
 
-	uint8_t a = 1;			/* inicializa  es para a tarefa */
-	uint8_t i = 0;
+	uint8_t a = 1;			/* inicializacoes para a tarefa */
+	uint8_t *mensagem;
 
 	for(;;)
 	{
-		SemaforoAguarda(&SemaforoVazio);
+		mensagem = FilaReserva(&FilaMensagens, MARCAS_INFINITAS);	/* espera uma posicao livre da fila */
 
-		buffer[i] = a++;
-		i = (i+1) % 5;
+		*mensagem = a++;	/* escreve direto na fila, sem copia intermediaria */
 
-		SemaforoLibera(&SemaforoCheio); /* tarefa libera semaforo para tarefa que esta esperando-o */
+		FilaConfirma(&FilaMensagens); /* mensagem pronta para a tarefa que espera a fila */
 
 		TarefaEspera(10); 	/* tarefa se coloca em espera por 10 marcas de tempo (ticks), equivale a 10ms */
 	}
@@ -340,31 +332,25 @@ void tarefa_12(void)
 
 void tarefa_13(void)
 {
-	static uint8_t f = 0;
-	volatile uint8_t valor;
+	volatile uint8_t valor[TAM_FILA_MENSAGENS];
+	uint8_t esperado = 1;	/* a tarefa 12 numera as mensagens a partir de 1 */
+	uint8_t n, i;
 
 	for(;;)
 	{
-		volatile uint8_t contador;
-
-		do{
-			REG_ATOMICA_INICIO();
-			contador = SemaforoCheio.contador;
-			REG_ATOMICA_FIM();
-
-			if (contador == 0)
+		/* espera na fila e recebe todas as mensagens prontas de uma vez */
+		n = FilaRecebeVarias(&FilaMensagens, (void *)valor, TAM_FILA_MENSAGENS, MARCAS_INFINITAS);
+		
+		/* confere a sequencia: nenhuma mensagem perdida ou repetida */
+		for(i = 0; i < n; i++)
+		{
+			if(valor[i] != esperado)
 			{
-				TarefaEspera(100);
+				mensagens_fora_de_ordem++;
 			}
-
-		} while (!contador);
-
-		SemaforoAguarda(&SemaforoCheio);
-
-		valor = buffer[f];
-		f = (f+1) % 5;
-
-		SemaforoLibera(&SemaforoVazio);
+			esperado = (uint8_t)(valor[i] + 1);
+		}
+		mensagens_recebidas += n;
 	}
 }
 
@@ -153,7 +153,7 @@ void tarefa_4(void)
 
 /* Tarefas de exemplo que usam funcoes de semaforo */
 
-semaforo_t SemaforoTeste = {0,0}; /* declaracao e inicializacao de um semaforo */
+semaforo_t SemaforoTeste = {0, {0}}; /* declaracao e inicializacao de um semaforo */
 
 void tarefa_5(void)
 {
@@ -194,8 +194,8 @@ void tarefa_6(void)
 #define TAM_BUFFER 10
 uint8_t buffer[TAM_BUFFER]; /* declaracao de um buffer (vetor) ou fila circular */
 
-semaforo_t SemaforoCheio = {0,0}; /* declaracao e inicializacao de um semaforo */
-semaforo_t SemaforoVazio = {TAM_BUFFER,0}; /* declaracao e inicializacao de um semaforo */
+semaforo_t SemaforoCheio = {0, {0}}; /* declaracao e inicializacao de um semaforo */
+semaforo_t SemaforoVazio = {TAM_BUFFER, {0}}; /* declaracao e inicializacao de um semaforo */
 
 void tarefa_7(void)
 {
@@ -224,21 +224,7 @@ void tarefa_8(void)
 		
 	for(;;)
 	{
-		volatile uint8_t contador;
-		
-		do{
-			REG_ATOMICA_INICIO();			
-				contador = SemaforoCheio.contador;			
-			REG_ATOMICA_FIM();
-			
-			if (contador == 0)
-			{
-				TarefaEspera(100);
-			}
-				
-		} while (!contador);
-		
-		SemaforoAguarda(&SemaforoCheio);
+		SemaforoAguarda(&SemaforoCheio);	/* espera na fila do semaforo, sem consultar o contador */
 		
 		valor = buffer[f];
 		f = (f+1) % TAM_BUFFER;	
@@ -0,0 +1,249 @@
+/*
+ * rastro_json.c
+ *
+ * Decodifica uma copia do anel do rastro do kernel (rastro_t, cfg_RASTRO=1)
+ * para o formato JSON de eventos do Chrome (chrome://tracing ou Perfetto):
+ *  - processo "CPU": uma linha por tarefa com os intervalos em que ela
+ *    executou (de uma troca de contexto a seguinte) e os semaforos pedidos
+ *    e liberados; a linha "interrupcoes" tem as rotinas de interrupcao e as
+ *    marcas de tempo
+ *  - processo "Esperas": os intervalos em que cada tarefa ficou fora da fila
+ *    de prontas (bloqueada/suspensa)
+ *
+ * A copia e o rastro_t inteiro, tirado da memoria, por exemplo:
+ *   (gdb) dump binary value rastro.bin rastro
+ * ou o rastro.bin da porta POSIX (Ctrl+C com -Dcfg_RASTRO=1).
+ * A ordem dos bytes e little endian, como no Cortex-M0 e no PC.
+ *
+ * Compilar e usar (na pasta rtos):
+ *   gcc -O2 ferramentas/rastro_json.c -o rastro_json
+ *   ./rastro_json rastro.bin > rastro.json
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* os mesmos codigos do rtos.h */
+#define RASTRO_EV_TROCA			1
+#define RASTRO_EV_PRONTA		2
+#define RASTRO_EV_BLOQUEIA		3
+#define RASTRO_EV_SEM_AGUARDA	4
+#define RASTRO_EV_SEM_LIBERA	5
+#define RASTRO_EV_MARCA			6
+#define RASTRO_EV_ISR_ENTRA		7
+#define RASTRO_EV_ISR_SAI		8
+
+#define RASTRO_MARCADOR		0x52545352UL
+#define TAM_CABECALHO		16
+#define TAM_REGISTRO		8
+#define MAX_TAREFAS			256
+
+#define PID_CPU				1
+#define PID_ESPERAS			2
+
+static char nomes[MAX_TAREFAS][32];
+static double inicio_execucao[MAX_TAREFAS];		/* < 0: nao esta executando */
+static double inicio_espera[MAX_TAREFAS];		/* < 0: nao esta esperando */
+static int primeiro_evento = 1;
+
+static uint32_t le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void separador(void)
+{
+	printf(primeiro_evento ? "\n" : ",\n");
+	primeiro_evento = 0;
+}
+
+static void nome_linha(int pid, int tid, const char *nome)
+{
+	separador();
+	printf("{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+	       pid, tid, nome);
+}
+
+static void intervalo(int pid, int tid, const char *nome, double inicio, double fim)
+{
+	separador();
+	printf("{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}",
+	       pid, tid, nome, inicio, fim - inicio);
+}
+
+static void instante(int tid, const char *nome, unsigned valor, double t)
+{
+	separador();
+	printf("{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"args\":{\"valor\":\"0x%04x\"}}",
+	       PID_CPU, tid, nome, t, valor);
+}
+
+static void isr(char fase, unsigned excecao, double t)
+{
+	separador();
+	printf("{\"ph\":\"%c\",\"pid\":%d,\"tid\":0,\"name\":\"%s %u\",\"ts\":%.3f}",
+	       fase, PID_CPU, excecao == 15 ? "SysTick" : "excecao", excecao, t);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *arquivo;
+	uint8_t cabecalho[TAM_CABECALHO];
+	uint8_t *resto;
+	uint32_t frequencia, escritos, validos, primeiro, i;
+	uint16_t registros;
+	uint8_t tarefas, tam_nome;
+	size_t tam_resto;
+	const uint8_t *anel;
+	double t = 0, escala;
+	unsigned tarefa;
+
+	if(argc != 2)
+	{
+		fprintf(stderr, "uso: %s rastro.bin > rastro.json\n", argv[0]);
+		return 1;
+	}
+	arquivo = fopen(argv[1], "rb");
+	if(arquivo == NULL)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	if(fread(cabecalho, 1, TAM_CABECALHO, arquivo) != TAM_CABECALHO || le32(cabecalho) != RASTRO_MARCADOR)
+	{
+		fprintf(stderr, "%s: nao comeca com um rastro_t\n", argv[1]);
+		return 1;
+	}
+	frequencia = le32(cabecalho + 4);
+	escritos = le32(cabecalho + 8);
+	registros = le16(cabecalho + 12);
+	tarefas = cabecalho[14];
+	tam_nome = cabecalho[15];
+	if(frequencia == 0 || registros == 0 || (registros & (registros - 1)) != 0)
+	{
+		fprintf(stderr, "%s: cabecalho invalido\n", argv[1]);
+		return 1;
+	}
+
+	tam_resto = (size_t)tarefas * tam_nome + (size_t)registros * TAM_REGISTRO;
+	resto = malloc(tam_resto);
+	if(resto == NULL || fread(resto, 1, tam_resto, arquivo) != tam_resto)
+	{
+		fprintf(stderr, "%s: copia incompleta (%zu bytes esperados apos o cabecalho)\n", argv[1], tam_resto);
+		return 1;
+	}
+	fclose(arquivo);
+
+	/* nomes das tarefas; o indice 0 fica para as interrupcoes */
+	for(tarefa = 0; tarefa < MAX_TAREFAS; tarefa++)
+	{
+		inicio_execucao[tarefa] = -1;
+		inicio_espera[tarefa] = -1;
+		if(tarefa > 0 && tarefa < tarefas && resto[tarefa * tam_nome] != '\0')
+		{
+			memcpy(nomes[tarefa], &resto[tarefa * tam_nome], tam_nome);
+			nomes[tarefa][tam_nome < sizeof(nomes[0]) ? tam_nome : sizeof(nomes[0]) - 1] = '\0';
+		}else
+		{
+			snprintf(nomes[tarefa], sizeof(nomes[0]), "tarefa %u", tarefa);
+		}
+	}
+	anel = resto + (size_t)tarefas * tam_nome;
+
+	/* o anel deu a volta: o mais antigo e o seguinte ao mais novo */
+	validos = escritos < registros ? escritos : registros;
+	primeiro = escritos < registros ? 0 : escritos & (registros - 1u);
+	escala = 1e6 / frequencia;		/* ciclos para microssegundos */
+
+	printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	separador();
+	printf("{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"CPU\"}}", PID_CPU);
+	separador();
+	printf("{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"Esperas\"}}", PID_ESPERAS);
+	nome_linha(PID_CPU, 0, "interrupcoes");
+	for(tarefa = 1; tarefa < tarefas; tarefa++)
+	{
+		nome_linha(PID_CPU, (int)tarefa, nomes[tarefa]);
+		nome_linha(PID_ESPERAS, (int)tarefa, nomes[tarefa]);
+	}
+
+	for(i = 0; i < validos; i++)
+	{
+		const uint8_t *r = &anel[((primeiro + i) & (registros - 1u)) * TAM_REGISTRO];
+		uint8_t evento = r[4];
+		uint8_t alvo = r[5];
+		uint16_t dado = le16(r + 6);
+
+		/* o delta do mais antigo e em relacao a um registro ja sobrescrito */
+		if(i > 0)
+		{
+			t += le32(r) * escala;
+		}
+
+		switch(evento)
+		{
+			case RASTRO_EV_TROCA:
+				if(dado < MAX_TAREFAS && inicio_execucao[dado] >= 0)
+				{
+					intervalo(PID_CPU, dado, nomes[dado], inicio_execucao[dado], t);
+					inicio_execucao[dado] = -1;
+				}
+				inicio_execucao[alvo] = t;
+				break;
+			case RASTRO_EV_BLOQUEIA:
+				inicio_espera[alvo] = t;
+				break;
+			case RASTRO_EV_PRONTA:
+				if(inicio_espera[alvo] >= 0)
+				{
+					intervalo(PID_ESPERAS, alvo, "espera", inicio_espera[alvo], t);
+					inicio_espera[alvo] = -1;
+				}
+				break;
+			case RASTRO_EV_SEM_AGUARDA:
+				instante(alvo, "aguarda semaforo", dado, t);
+				break;
+			case RASTRO_EV_SEM_LIBERA:
+				instante(alvo, "libera semaforo", dado, t);
+				break;
+			case RASTRO_EV_MARCA:
+				instante(0, "marca", dado, t);
+				break;
+			case RASTRO_EV_ISR_ENTRA:
+				isr('B', dado, t);
+				break;
+			case RASTRO_EV_ISR_SAI:
+				isr('E', dado, t);
+				break;
+			default:
+				fprintf(stderr, "registro %u: evento desconhecido %u\n", (unsigned)i, evento);
+				break;
+		}
+	}
+
+	/* fecha o que ainda estava aberto no fim da copia */
+	for(tarefa = 1; tarefa < MAX_TAREFAS; tarefa++)
+	{
+		if(inicio_execucao[tarefa] >= 0)
+		{
+			intervalo(PID_CPU, (int)tarefa, nomes[tarefa], inicio_execucao[tarefa], t);
+		}
+		if(inicio_espera[tarefa] >= 0)
+		{
+			intervalo(PID_ESPERAS, (int)tarefa, "espera", inicio_espera[tarefa], t);
+		}
+	}
+	printf("\n]}\n");
+
+	fprintf(stderr, "%u registros em %.3f ms (%u perdidos pela volta do anel)\n",
+	        (unsigned)validos, t / 1000.0, (unsigned)(escritos - validos));
+	free(resto);
+	return 0;
+}
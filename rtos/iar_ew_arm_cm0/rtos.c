@@ -3,68 +3,437 @@
  *
  */ 
 
+#include <string.h>
 #include "rtos.h"
 
 /* variaveis do sistema multitarefas */
 uint8_t 	   tarefa_atual, proxima_tarefa;
 tcb_t   	   TCB[NUMERO_DE_TAREFAS+1];
 stackptr_t	   ponteiro_de_pilha;
-prioridade_t       Prioridades[PRIORIDADE_MAXIMA+1];   /* vetor com as prioridades das tarefas */
-uint32_t	   SP;
+prioridade_t   Prioridades[PRIORIDADE_MAXIMA+1];   /* primeira tarefa da fila de prontas de cada prioridade */
+uint32_t	   mapa_prontas;   /* bit p em 1: a tarefa de prioridade p esta pronta */
+sp_t		   SP;
 
-/* variavel auxiliar para guardar o numero de marcas de tempo */
-static tick_t contador_marcas = 0;
+#if PRIORIDADE_MAXIMA > 31
+#error "PRIORIDADE_MAXIMA deve ser no maximo 31 (uma prioridade por bit de mapa_prontas)"
+#endif
+
+#if cfg_CONTA_TROCAS
+uint32_t	   trocas_pedidas;
+uint32_t	   trocas_necessarias;
+uint32_t	   trocas_realizadas;
+#endif
+
+#if cfg_MEDE_TROCA_CONTEXTO
+uint32_t	   ciclos_troca_ultimo;
+uint32_t	   ciclos_troca_maximo;
+#endif
+
+/* variavel auxiliar para guardar o numero de marcas de tempo: os 32 bits
+   baixos do contador de 64 bits; marcas_alto conta as voltas */
+static volatile tick_t contador_marcas = 0;
+static volatile uint32_t marcas_alto = 0;
+
+#if cfg_CONTA_TEMPO_CPU
+/* contador livre quando a tarefa atual recebeu o processador */
+static uint32_t inicio_execucao;
+
+/* contador livre e tempo da ociosa na chamada anterior de CargaCPU */
+static uint32_t instante_carga;
+static uint64_t ociosa_carga;
+#endif
+
+#if cfg_RASTRO
+#if (cfg_RASTRO_REGISTROS & (cfg_RASTRO_REGISTROS - 1)) != 0
+#error "cfg_RASTRO_REGISTROS deve ser potencia de 2"
+#endif
+
+rastro_t	   rastro = {.marcador = RASTRO_MARCADOR, .frequencia = FREQUENCIA_CONTADOR_LIVRE,
+						 .registros = cfg_RASTRO_REGISTROS, .tarefas = NUMERO_DE_TAREFAS+1,
+						 .tam_nome = RASTRO_TAM_NOME};
+
+/* contador livre no registro anterior */
+static uint32_t rastro_instante;
+
+/* grava um registro no anel, sobrescrevendo o mais antigo. Pode ser chamada
+   de qualquer lugar, com ou sem as interrupcoes desabilitadas: o Cortex-M0
+   nao tem LDREX/STREX, entao a reserva do registro e feita com o PRIMASK
+   guardado e restaurado em poucas instrucoes */
+void RastroRegistra(uint8_t evento, uint8_t tarefa, uint16_t dado)
+{
+	uint32_t estado, agora;
+	rastro_registro_t *registro;
+	
+	REG_ATOMICA_SALVA(estado);
+	agora = LE_CONTADOR_LIVRE();
+	registro = &rastro.anel[rastro.escritos & (cfg_RASTRO_REGISTROS - 1)];
+	registro->delta = agora - rastro_instante;
+	registro->evento = evento;
+	registro->tarefa = tarefa;
+	registro->dado = dado;
+	rastro_instante = agora;
+	rastro.escritos++;
+	REG_ATOMICA_RESTAURA(estado);
+}
+#endif
 
 static uint8_t numero_tarefas = 0;
 
+/* primeira tarefa da fila de tempo (a proxima a despertar) */
+static uint8_t fila_tempo = 0;
+
+#if cfg_FATIA_TEMPO > 0
+/* marcas que ainda restam para a tarefa atual no rodizio */
+static tick_t fatia_restante = cfg_FATIA_TEMPO;
+#endif
+
 /* codigo independente de hardware */
+
+/* indice do bit 1 mais significativo de 'mapa' (mapa != 0) */
+#if defined(__GNUC__) && defined(__ARM_FEATURE_CLZ)
+#define maior_bit(mapa)		((uint8_t)(31 - __builtin_clz(mapa)))
+#else
+/* sem instrucao CLZ (Cortex-M0): espalha o bit mais alto para a direita
+   e usa a multiplicacao por uma sequencia de De Bruijn como indice da tabela */
+static const uint8_t tabela_de_bruijn[32] =
+{
+	0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+	8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+};
+
+static inline uint8_t maior_bit(uint32_t mapa)
+{
+	mapa |= mapa >> 1;
+	mapa |= mapa >> 2;
+	mapa |= mapa >> 4;
+	mapa |= mapa >> 8;
+	mapa |= mapa >> 16;
+	return tabela_de_bruijn[(uint32_t)(mapa * 0x07C4ACDDU) >> 27];
+}
+#endif
+
+/* mudam o estado da tarefa e a colocam/retiram da fila de prontas da sua
+   prioridade. Cada fila e uma lista circular duplamente encadeada pelos
+   campos proxima/anterior do TCB (indice 0 = nenhuma tarefa), com a
+   primeira tarefa em Prioridades[]. A tarefa entra no fim da fila; o bit
+   da prioridade no mapa fica em 1 enquanto a fila nao estiver vazia.
+   Chamadas com as interrupcoes desabilitadas */
+static inline void tarefa_pronta(uint8_t tarefa)
+{
+	prioridade_t prioridade = TCB[tarefa].prioridade;
+	uint8_t primeira = Prioridades[prioridade];
+	
+	if(TCB[tarefa].estado == PRONTA)
+	{
+		return;		/* ja esta na fila */
+	}
+	TCB[tarefa].estado = PRONTA;
+	RASTRO(RASTRO_EV_PRONTA, tarefa, 0);
+	
+	if(primeira == 0)
+	{
+		TCB[tarefa].proxima = tarefa;
+		TCB[tarefa].anterior = tarefa;
+		Prioridades[prioridade] = tarefa;
+		mapa_prontas |= (1UL << prioridade);
+	}else
+	{
+		uint8_t ultima = TCB[primeira].anterior;
+		TCB[tarefa].proxima = primeira;
+		TCB[tarefa].anterior = ultima;
+		TCB[ultima].proxima = tarefa;
+		TCB[primeira].anterior = tarefa;
+	}
+}
+
+static inline void tarefa_bloqueada(uint8_t tarefa)
+{
+	prioridade_t prioridade = TCB[tarefa].prioridade;
+	
+	if(TCB[tarefa].estado != PRONTA)
+	{
+		return;		/* nao esta na fila */
+	}
+	TCB[tarefa].estado = ESPERA;
+	RASTRO(RASTRO_EV_BLOQUEIA, tarefa, 0);
+	
+	if(TCB[tarefa].proxima == tarefa)
+	{
+		/* era a unica pronta desta prioridade */
+		Prioridades[prioridade] = 0;
+		mapa_prontas &= ~(1UL << prioridade);
+	}else
+	{
+		TCB[TCB[tarefa].anterior].proxima = TCB[tarefa].proxima;
+		TCB[TCB[tarefa].proxima].anterior = TCB[tarefa].anterior;
+		if(Prioridades[prioridade] == tarefa)
+		{
+			Prioridades[prioridade] = TCB[tarefa].proxima;
+		}
+	}
+}
+
+/* fila de tempo: lista das tarefas em espera por tempo, em ordem de
+   despertar. Cada tarefa guarda em tempo_espera so as marcas que faltam
+   depois da anterior na fila (lista delta), entao a marca de tempo
+   decrementa apenas a primeira. A insercao percorre a fila; tarefas com o
+   mesmo tempo despertam na ordem em que entraram.
+   Chamadas com as interrupcoes desabilitadas */
+static void fila_tempo_insere(uint8_t tarefa, tick_t marcas)
+{
+	uint8_t anterior = 0;
+	uint8_t seguinte = fila_tempo;
+	
+	while(seguinte != 0 && TCB[seguinte].tempo_espera <= marcas)
+	{
+		marcas -= TCB[seguinte].tempo_espera;
+		anterior = seguinte;
+		seguinte = TCB[seguinte].proxima_tempo;
+	}
+	
+	TCB[tarefa].tempo_espera = marcas;
+	TCB[tarefa].anterior_tempo = anterior;
+	TCB[tarefa].proxima_tempo = seguinte;
+	
+	if(seguinte != 0)
+	{
+		TCB[seguinte].tempo_espera -= marcas;
+		TCB[seguinte].anterior_tempo = tarefa;
+	}
+	if(anterior != 0)
+	{
+		TCB[anterior].proxima_tempo = tarefa;
+	}else
+	{
+		fila_tempo = tarefa;
+	}
+}
+
+static inline uint8_t fila_tempo_contem(uint8_t tarefa)
+{
+	return (fila_tempo == tarefa || TCB[tarefa].anterior_tempo != 0);
+}
+
+static void fila_tempo_retira(uint8_t tarefa)
+{
+	uint8_t anterior = TCB[tarefa].anterior_tempo;
+	uint8_t seguinte = TCB[tarefa].proxima_tempo;
+	
+	if(seguinte != 0)
+	{
+		/* a seguinte herda as marcas que faltavam para esta */
+		TCB[seguinte].tempo_espera += TCB[tarefa].tempo_espera;
+		TCB[seguinte].anterior_tempo = anterior;
+	}
+	if(anterior != 0)
+	{
+		TCB[anterior].proxima_tempo = seguinte;
+	}else
+	{
+		fila_tempo = seguinte;
+	}
+	
+	TCB[tarefa].tempo_espera = 0;
+	TCB[tarefa].anterior_tempo = 0;
+	TCB[tarefa].proxima_tempo = 0;
+}
+
+/* fila de espera de um objeto: lista duplamente encadeada pelos campos
+   proxima_espera/anterior_espera do TCB, da maior para a menor prioridade
+   (mesma prioridade: ordem de chegada). A primeira e a que recebe o objeto.
+   Chamadas com as interrupcoes desabilitadas */
+static void fila_espera_insere(fila_espera_t *fila, uint8_t tarefa)
+{
+	uint8_t anterior = 0;
+	uint8_t seguinte = fila->primeira;
+	
+	while(seguinte != 0 && TCB[seguinte].prioridade >= TCB[tarefa].prioridade)
+	{
+		anterior = seguinte;
+		seguinte = TCB[seguinte].proxima_espera;
+	}
+	
+	TCB[tarefa].fila = fila;
+	TCB[tarefa].anterior_espera = anterior;
+	TCB[tarefa].proxima_espera = seguinte;
+	
+	if(seguinte != 0)
+	{
+		TCB[seguinte].anterior_espera = tarefa;
+	}
+	if(anterior != 0)
+	{
+		TCB[anterior].proxima_espera = tarefa;
+	}else
+	{
+		fila->primeira = tarefa;
+	}
+}
+
+static void fila_espera_retira(uint8_t tarefa)
+{
+	uint8_t anterior = TCB[tarefa].anterior_espera;
+	uint8_t seguinte = TCB[tarefa].proxima_espera;
+	
+	if(seguinte != 0)
+	{
+		TCB[seguinte].anterior_espera = anterior;
+	}
+	if(anterior != 0)
+	{
+		TCB[anterior].proxima_espera = seguinte;
+	}else
+	{
+		TCB[tarefa].fila->primeira = seguinte;
+	}
+	
+	TCB[tarefa].fila = 0;
+	TCB[tarefa].anterior_espera = 0;
+	TCB[tarefa].proxima_espera = 0;
+}
+
+/* bloqueia a tarefa atual na fila por ate 'marcas' (MARCAS_INFINITAS: sem limite) */
+static void fila_espera_bloqueia(fila_espera_t *fila, tick_t marcas)
+{
+	tarefa_bloqueada(tarefa_atual);
+	fila_espera_insere(fila, tarefa_atual);
+	TCB[tarefa_atual].tempo_esgotado = 0;
+	if(marcas != MARCAS_INFINITAS)
+	{
+		fila_tempo_insere(tarefa_atual, marcas);
+	}
+}
+
+/* tira a tarefa da fila de espera (e da de tempo) e a coloca nas prontas */
+static void fila_espera_desbloqueia(uint8_t tarefa)
+{
+	fila_espera_retira(tarefa);
+	if(fila_tempo_contem(tarefa))
+	{
+		fila_tempo_retira(tarefa);
+	}
+	tarefa_pronta(tarefa);
+}
+
+/* entrega o objeto a primeira da fila, em tempo constante; retorna a tarefa ou 0 */
+static uint8_t fila_espera_acorda(fila_espera_t *fila)
+{
+	uint8_t tarefa = fila->primeira;
+	
+	if(tarefa != 0)
+	{
+		fila_espera_desbloqueia(tarefa);
+	}
+	return tarefa;
+}
+
+/* espera em 'fila' ate ser acordada ou ate passarem 'marcas' desde 'inicio'
+   (MARCAS_INFINITAS: sem limite). Retorna 0 se o tempo acabou. Chamada e
+   retorna com as interrupcoes desabilitadas */
+static uint8_t fila_espera_ate(fila_espera_t *fila, tick_t inicio, tick_t marcas)
+{
+	tick_t decorridas = (tick_t)(contador_marcas - inicio);
+	
+	if(marcas != MARCAS_INFINITAS)
+	{
+		if(decorridas >= marcas)
+		{
+			return 0;
+		}
+		marcas -= decorridas;
+	}
+	
+	fila_espera_bloqueia(fila, marcas);
+	TROCA_CONTEXTO();		/* so retorna quando ficar pronta novamente */
+	REG_ATOMICA_INICIO();
+	return !TCB[tarefa_atual].tempo_esgotado;
+}
+
+/* a primeira da fila de tempo e as seguintes com zero marcas a mais
+   vao para a fila de prontas para executar */
+static void fila_tempo_desperta(void)
+{
+	uint8_t tarefa;
+	
+	while(fila_tempo != 0 && TCB[fila_tempo].tempo_espera == 0)
+	{
+		tarefa = fila_tempo;
+		fila_tempo = TCB[tarefa].proxima_tempo;
+		if(fila_tempo != 0)
+		{
+			TCB[fila_tempo].anterior_tempo = 0;
+		}
+		TCB[tarefa].proxima_tempo = 0;
+		
+		/* tempo esgotado esperando um objeto: sai da fila de espera */
+		if(TCB[tarefa].fila != 0)
+		{
+			fila_espera_retira(tarefa);
+			TCB[tarefa].tempo_esgotado = 1;
+		}
+		
+		/* coloca a tarefa na fila de prontas para executar */
+		tarefa_pronta(tarefa);
+	}
+}
+
 /* funcao para realizar o escalonamento de tarefas por prioridades 
    que retorna a proxima tarefa que sera executada, isto e, aquela que
-   tem a maior prioridade e que esta pronta para executar */
+   tem a maior prioridade e que esta pronta para executar.
+   Tempo constante: a maior prioridade pronta sai direto do mapa de bits,
+   sem percorrer o vetor de prioridades */
    
 uint8_t escalonador(void)
 {
-    
-	uint8_t prioridade;
-	uint8_t tarefa_selecionada = 0;
-    
-	/* lao comeca pela maior prioridade ate encontrar 
-	uma tarefa em estado de pronta para executar  */	
-    for (prioridade=PRIORIDADE_MAXIMA;prioridade>0;prioridade--)
-    { 
-      if(Prioridades[prioridade] != 0)
-      {        
-          tarefa_selecionada = Prioridades[prioridade];
-          if(TCB[tarefa_selecionada].estado == PRONTA)
-          {    
-            /* retorna aquela que tem a maior prioridade e que esta pronta para executar */		
-            return tarefa_selecionada;    
-          }
-      }
-    } 
-    
-	/* caso nenhuma esteja pronta para executar, retorna a de menor prioridade, 
+	/* entre as prontas de mesma prioridade, executa a primeira da fila.
+	 caso nenhuma esteja pronta para executar, retorna a de menor prioridade (0), 
 	 a qual sempre deve estar pronta para executar */
-    if(prioridade == 0) 
-    {
-    	tarefa_selecionada = Prioridades[prioridade];
-    }
-	
-    return tarefa_selecionada;
+	return Prioridades[maior_bit(mapa_prontas | 1UL)];
 }
  
 
 
+/* depois de uma tarefa ficar pronta ou bloquear outra: so vale pagar a
+   troca de contexto (salvar e restaurar R4-R11) se a tarefa atual deixou
+   de ser a primeira da maior prioridade pronta */
+static inline uint8_t preempcao_necessaria(void)
+{
+	uint8_t necessaria = (escalonador() != tarefa_atual);
+	
+#if cfg_CONTA_TROCAS
+	trocas_pedidas++;
+	trocas_necessarias += necessaria;
+#endif
+	return necessaria;
+}
+
 /*********************************************/
-void CriaTarefa(tarefa_t p, const char * nome,
+/* retorna o numero da tarefa criada, ou 0 (nenhuma tarefa) se a pilha for
+   menor que TAM_MINIMO_PILHA, a prioridade maior que PRIORIDADE_MAXIMA ou
+   ja houver NUMERO_DE_TAREFAS tarefas */
+uint8_t CriaTarefa(tarefa_t p, const char * nome,
 stackptr_t pilha, uint16_t tamanho, prioridade_t prioridade)
 {
 	
-	if(tamanho < TAM_MINIMO_PILHA)
+	if(tamanho < TAM_MINIMO_PILHA || prioridade > PRIORIDADE_MAXIMA ||
+	   numero_tarefas >= NUMERO_DE_TAREFAS)
 	{
-		return;
+		return 0;
 	}
 	
+#if cfg_VERIFICA_PILHA
+	{
+		/* pinta a pilha toda; CriaContexto escreve o contexto inicial por cima */
+		uint16_t i;
+		for(i = 0; i < tamanho; i++)
+		{
+			pilha[i] = PADRAO_PILHA;
+		}
+		TCB[numero_tarefas + 1].pilha = pilha;
+		TCB[numero_tarefas + 1].tamanho_pilha = tamanho;
+	}
+#endif
+	
 	pilha = CriaContexto(p, pilha + tamanho);
 	
 	/* incrementa o numero de tarefas instaladas */
@@ -72,32 +441,52 @@ stackptr_t pilha, uint16_t tamanho, prioridade_t prioridade)
 
 	/* guardar os dados no bloco de controle da tarefa (TCB) */
 	TCB[numero_tarefas].nome = nome;
+#if cfg_RASTRO
+	strncpy(rastro.nomes[numero_tarefas], nome, RASTRO_TAM_NOME);	/* sem o \0 se ocupar tudo */
+#endif
 	TCB[numero_tarefas].stack_pointer = (stackptr_t)(pilha);
-	TCB[numero_tarefas].estado = PRONTA;
 	TCB[numero_tarefas].prioridade = prioridade;
+	TCB[numero_tarefas].prioridade_base = prioridade;
 	TCB[numero_tarefas].tempo_espera = 0;
+	TCB[numero_tarefas].estado = ESPERA;
 	  
-	/* guardar o numero da tarefa (TCB) no vetor de prioridades das tarefas */
-	Prioridades[prioridade]=numero_tarefas;
-
+	/* colocar a tarefa no fim da fila de prontas da sua prioridade */
+	tarefa_pronta(numero_tarefas);
+	
+	return numero_tarefas;
 }
 
 
 
-/* Servios do gerenciador de tarefas */
+/* Servicos do gerenciador de tarefas */
 void TarefaSuspende(uint8_t id_tarefa)
 {
 	REG_ATOMICA_INICIO();
-	TCB[id_tarefa].estado = ESPERA; /* tarefa  colocada em espera */
-	TrocaContexto(); 		   		/* tarefa atual solicita troca de contexto */
+	tarefa_bloqueada(id_tarefa); /* tarefa colocada em espera */
+	if(preempcao_necessaria())
+	{
+		TrocaContexto(); 		   		/* tarefa atual solicita troca de contexto */
+	}
 	REG_ATOMICA_FIM();
 }
 
 void TarefaContinua(uint8_t id_tarefa)
 {
 	REG_ATOMICA_INICIO();
-	TCB[id_tarefa].estado = PRONTA;			/* tarefa  colocada na fila de prontas */
-	TrocaContexto(); 		   				/* tarefa atual solicita troca de contexto */
+	if(fila_tempo_contem(id_tarefa))
+	{
+		fila_tempo_retira(id_tarefa);	/* deixa de esperar pelo tempo */
+	}
+	if(TCB[id_tarefa].fila != 0)
+	{
+		fila_espera_retira(id_tarefa);	/* desiste do semaforo */
+		TCB[id_tarefa].tempo_esgotado = 1;
+	}
+	tarefa_pronta(id_tarefa);			/* tarefa colocada na fila de prontas */
+	if(preempcao_necessaria())
+	{
+		TrocaContexto(); 		   				/* tarefa continuada passou a atual */
+	}
 	REG_ATOMICA_FIM();
 }
 
@@ -106,20 +495,249 @@ void TarefaEspera(tick_t qtas_marcas)
 	if(qtas_marcas > 0)  //** so valores maiores que 0 */
 	{
 		REG_ATOMICA_INICIO();			/* bloqueia interrupcoes */
-		TCB[tarefa_atual].tempo_espera = qtas_marcas;	/* o contador de marcas da tarefa  iniciado com o valor recebido */
-		TCB[tarefa_atual].estado = ESPERA;				/* tarefa  colocada na fila de espera */
+		fila_tempo_insere(tarefa_atual, qtas_marcas);	/* tarefa colocada na fila de tempo */
+		tarefa_bloqueada(tarefa_atual);				/* tarefa colocada na fila de espera */
 		TrocaContexto(); 	 /* tarefa atual solicita troca de contexto, so retorna quando ficar pronta novamente */
 		REG_ATOMICA_FIM();   /* desbloqueia interrupcoes */
 	}
 }
 
+/* contador de 64 bits; chamada com as interrupcoes desabilitadas */
+static inline uint64_t marcas_atuais(void)
+{
+	return ((uint64_t)marcas_alto << 32) | contador_marcas;
+}
+
+/* espera ate a marca absoluta 'despertar' (contada como em MarcasDeTempo).
+   A comparacao e em 64 bits e nao sofre com a volta do contador; esperas
+   maiores que um tick_t sao feitas em partes. Como TarefaEspera, termina
+   antes com TarefaContinua, em qualquer uma das partes. Retorna 0, sem
+   esperar, se 'despertar' ja passou, e 1 se esperou (ate o fim ou ate
+   TarefaContinua) */
+uint8_t TarefaEsperaAte(uint64_t despertar)
+{
+	uint64_t inicio, falta;
+	tick_t parte;
+	
+	REG_ATOMICA_INICIO();
+	if(despertar <= marcas_atuais())
+	{
+		REG_ATOMICA_FIM();
+		return 0;
+	}
+	do
+	{
+		inicio = marcas_atuais();
+		falta = despertar - inicio;
+		parte = (falta >= MARCAS_INFINITAS) ? MARCAS_INFINITAS - 1 : (tick_t)falta;
+		fila_tempo_insere(tarefa_atual, parte);
+		tarefa_bloqueada(tarefa_atual);
+		TrocaContexto();	/* so retorna quando ficar pronta novamente */
+		REG_ATOMICA_INICIO();
+		/* pronta antes do fim da parte: foi TarefaContinua, nao a fila de tempo */
+	}while(despertar > marcas_atuais() && marcas_atuais() - inicio >= parte);
+	REG_ATOMICA_FIM();
+	return 1;
+}
+
+/* para tarefas periodicas sem deriva: a proxima ativacao e sempre a
+   anterior mais 'periodo', nao importa quanto a tarefa executou. Iniciar
+   '*proxima' com MarcasDeTempo(). Retorna 0 se a ativacao ja tinha passado
+   (a tarefa atrasou); a fase e mantida e as seguintes nao esperam ate
+   alcanca-la */
+uint8_t TarefaPeriodica(uint64_t* proxima, tick_t periodo)
+{
+	*proxima += periodo;
+	return TarefaEsperaAte(*proxima);
+}
+
+/* marcas de tempo desde o inicio, em 64 bits, sem desabilitar as
+   interrupcoes: le a parte alta antes e depois da baixa e repete se uma
+   marca deu a volta no meio. Numa interrupcao de prioridade maior que a do
+   SysTick a leitura pode ficar uma volta atras */
+uint64_t MarcasDeTempo(void)
+{
+	uint32_t alto;
+	tick_t baixo;
+	
+	do
+	{
+		alto = marcas_alto;
+		baixo = contador_marcas;
+	}while(alto != marcas_alto);
+	
+	return ((uint64_t)alto << 32) | baixo;
+}
+
+/* instante em ciclos do contador da marca de tempo (o SysTick) desde o
+   inicio, com resolucao menor que uma marca: as marcas completas vezes o
+   periodo mais o valor atual do contador. Uma marca pendente e contada
+   (chamada com as interrupcoes desabilitadas). Fora do sono sem marcas */
+uint64_t InstanteEmCiclos(void)
+{
+	uint64_t marcas;
+	uint32_t periodo, ciclos;
+	
+	do
+	{
+		marcas = MarcasDeTempo();
+		periodo = PERIODO_CONTADOR_CICLOS();
+		ciclos = periodo - 1 - LE_CONTADOR_CICLOS();
+		if(MARCA_PENDENTE())
+		{
+			ciclos = 2 * periodo - 1 - LE_CONTADOR_CICLOS();
+		}
+	}while(marcas != MarcasDeTempo());
+	
+	return marcas * periodo + ciclos;
+}
+
+/* maior uso da pilha da tarefa desde a criacao, em palavras: conta do fim
+   da pilha as palavras que ainda tem o padrao pintado em CriaTarefa */
+uint16_t TarefaPilhaUsada(uint8_t id_tarefa)
+{
+#if cfg_VERIFICA_PILHA
+	uint16_t livres = 0;
+	const stackptr_t pilha = TCB[id_tarefa].pilha;
+	
+	if(id_tarefa == 0 || id_tarefa > numero_tarefas)
+	{
+		return 0;
+	}
+	while(livres < TCB[id_tarefa].tamanho_pilha && pilha[livres] == PADRAO_PILHA)
+	{
+		livres++;
+	}
+	return TCB[id_tarefa].tamanho_pilha - livres;
+#else
+	(void)id_tarefa;
+	return 0;
+#endif
+}
+
+/* preenche ate 'maximo' linhas com nome, tamanho e maior uso da pilha de
+   cada tarefa, na ordem de criacao; retorna o numero de linhas */
+uint8_t RelatorioPilhas(uso_pilha_t* relatorio, uint8_t maximo)
+{
+	uint8_t tarefa;
+	
+	for(tarefa = 1; tarefa <= numero_tarefas && tarefa <= maximo; tarefa++)
+	{
+		relatorio[tarefa - 1].nome = TCB[tarefa].nome;
+#if cfg_VERIFICA_PILHA
+		relatorio[tarefa - 1].tamanho = TCB[tarefa].tamanho_pilha;
+#else
+		relatorio[tarefa - 1].tamanho = 0;
+#endif
+		relatorio[tarefa - 1].maximo_usado = TarefaPilhaUsada(tarefa);
+	}
+	return tarefa - 1;
+}
+
+#if cfg_CONTA_TEMPO_CPU
+/* ciclos da tarefa atual desde que recebeu o processador */
+static inline uint32_t execucao_atual(void)
+{
+	return LE_CONTADOR_LIVRE() - inicio_execucao;
+}
+#endif
+
+/* copia de uma vez (interrupcoes desabilitadas) o tempo de processador de
+   ate 'maximo' tarefas, na ordem de criacao; a tarefa atual inclui a
+   execucao em andamento. Retorna o numero de tarefas copiadas */
+uint8_t EstatisticasTarefas(estatistica_tarefa_t* copia, uint8_t maximo)
+{
+	uint8_t tarefa;
+	
+	REG_ATOMICA_INICIO();
+	for(tarefa = 1; tarefa <= numero_tarefas && tarefa <= maximo; tarefa++)
+	{
+		copia[tarefa - 1].nome = TCB[tarefa].nome;
+		copia[tarefa - 1].prioridade = TCB[tarefa].prioridade_base;
+#if cfg_CONTA_TEMPO_CPU
+		copia[tarefa - 1].ciclos = TCB[tarefa].ciclos;
+		copia[tarefa - 1].execucoes = TCB[tarefa].execucoes;
+		copia[tarefa - 1].maior_execucao = TCB[tarefa].maior_execucao;
+		if(tarefa == tarefa_atual)
+		{
+			uint32_t decorrido = execucao_atual();
+			copia[tarefa - 1].ciclos += decorrido;
+			if(decorrido > copia[tarefa - 1].maior_execucao)
+			{
+				copia[tarefa - 1].maior_execucao = decorrido;
+			}
+		}
+#else
+		copia[tarefa - 1].ciclos = 0;
+		copia[tarefa - 1].execucoes = 0;
+		copia[tarefa - 1].maior_execucao = 0;
+#endif
+	}
+	REG_ATOMICA_FIM();
+	return tarefa - 1;
+}
+
+/* carga do processador, em decimos de por cento, desde a chamada anterior:
+   o tempo fora das tarefas de prioridade 0 (a ociosa). A primeira chamada
+   mede desde IniciaMultitarefas; o intervalo entre chamadas deve caber no
+   contador livre de 32 bits (cerca de 89 s a 48 MHz) */
+uint16_t CargaCPU(void)
+{
+#if cfg_CONTA_TEMPO_CPU
+	uint32_t agora, total;
+	uint64_t ociosa = 0;
+	uint32_t ociosa_intervalo;
+	uint8_t tarefa;
+	
+	REG_ATOMICA_INICIO();
+	agora = LE_CONTADOR_LIVRE();
+	for(tarefa = 1; tarefa <= numero_tarefas; tarefa++)
+	{
+		if(TCB[tarefa].prioridade_base == 0)
+		{
+			ociosa += TCB[tarefa].ciclos;
+			if(tarefa == tarefa_atual)
+			{
+				ociosa += agora - inicio_execucao;
+			}
+		}
+	}
+	total = agora - instante_carga;
+	ociosa_intervalo = (uint32_t)(ociosa - ociosa_carga);
+	instante_carga = agora;
+	ociosa_carga = ociosa;
+	REG_ATOMICA_FIM();
+	
+	if(total == 0 || ociosa_intervalo >= total)
+	{
+		return 0;
+	}
+	return (uint16_t)(1000 - (uint16_t)(((uint64_t)ociosa_intervalo * 1000) / total));
+#else
+	return 0;
+#endif
+}
+
 /* Exemplo de tarefa ociosa */
 void tarefa_ociosa(void)
 {
 	
 	for(;;)
 	{		
-		#if 1
+		#if cfg_MARCA_TEMPO_LIVRE
+			tick_t marcas;
+			
+			REG_ATOMICA_INICIO();
+			/* sozinha na fila de prontas: dorme ate a proxima tarefa despertar */
+			marcas = MarcasAteDespertar();
+			if((mapa_prontas & ~1UL) == 0 && TCB[tarefa_atual].proxima == tarefa_atual &&
+				marcas >= cfg_MARCAS_MINIMAS_SONO)
+			{
+				DormeSemMarcas(marcas);
+			}
+			TrocaContexto();				/* tarefa atual solicita troca de contexto */
+			REG_ATOMICA_FIM();
+		#else
 			REG_ATOMICA_INICIO();
 			TrocaContexto();				/* tarefa atual solicita troca de contexto */
 			REG_ATOMICA_FIM();
@@ -132,86 +750,753 @@ void IniciaMultitarefas(void)
 {
 	tarefa_atual = escalonador();
 	ponteiro_de_pilha = TCB[tarefa_atual].stack_pointer;
-	SP = (SP_TYPECAST) ponteiro_de_pilha;
+	SP = (sp_t)ponteiro_de_pilha;
+#if cfg_CONTA_TEMPO_CPU
+	inicio_execucao = LE_CONTADOR_LIVRE();
+	instante_carga = inicio_execucao;
+	TCB[tarefa_atual].execucoes = 1;
+#endif
 	GERA_INTERRUPCAO_SW();
 }
 
 void TrocaContextoDasTarefas(void)
 {
+#if cfg_MEDE_TROCA_CONTEXTO
+	uint32_t inicio = LE_CONTADOR_CICLOS();
+#endif
 	
 	/* guarda o valor antigo do stack pointer */
-	TCB[tarefa_atual].stack_pointer = (stackptr_t) SP;
+	TCB[tarefa_atual].stack_pointer = (stackptr_t)SP;
+	
+#if cfg_VERIFICA_PILHA
+	/* a tarefa que sai passou do fim da pilha? */
+	if(TCB[tarefa_atual].pilha != 0 && *TCB[tarefa_atual].pilha != PADRAO_PILHA)
+	{
+		ESTOURO_DE_PILHA(tarefa_atual);
+	}
+#endif
 		
 	/* executa o escalonador */
 	proxima_tarefa = escalonador();
+	
+#if cfg_CONTA_TROCAS
+	trocas_realizadas += (proxima_tarefa != tarefa_atual);
+#endif
+
+#if cfg_RASTRO
+	if(proxima_tarefa != tarefa_atual)
+	{
+		RASTRO(RASTRO_EV_TROCA, proxima_tarefa, tarefa_atual);
+	}
+#endif
+
+#if cfg_CONTA_TEMPO_CPU
+	/* a tarefa que sai cedeu o processador: fecha a execucao dela. Se o
+	   escalonador manteve a mesma tarefa, a execucao continua */
+	if(proxima_tarefa != tarefa_atual)
+	{
+		uint32_t agora = LE_CONTADOR_LIVRE();
+		uint32_t decorrido = agora - inicio_execucao;
+		
+		TCB[tarefa_atual].ciclos += decorrido;
+		if(decorrido > TCB[tarefa_atual].maior_execucao)
+		{
+			TCB[tarefa_atual].maior_execucao = decorrido;
+		}
+		TCB[proxima_tarefa].execucoes++;
+		inicio_execucao = agora;
+	}
+#endif
 		
+#if cfg_FATIA_TEMPO > 0
+	/* outra tarefa comeca com uma fatia de tempo inteira */
+	if(proxima_tarefa != tarefa_atual)
+	{
+		fatia_restante = cfg_FATIA_TEMPO;
+	}
+#endif
+	
 	/* seleciona a nova tarefa */
 	tarefa_atual = proxima_tarefa;
 		
 	/* coloca um novo valor no stack pointer */
 	ponteiro_de_pilha = TCB[tarefa_atual].stack_pointer;
 		
-	SP = (SP_TYPECAST)ponteiro_de_pilha;
+	SP = (sp_t)ponteiro_de_pilha;
 
+#if cfg_MEDE_TROCA_CONTEXTO
+	{
+		/* o contador e decrescente e pode ter recarregado no meio */
+		uint32_t fim = LE_CONTADOR_CICLOS();
+		ciclos_troca_ultimo = (inicio >= fim) ? (inicio - fim) : (inicio + PERIODO_CONTADOR_CICLOS() - fim);
+		if(ciclos_troca_ultimo > ciclos_troca_maximo)
+		{
+			ciclos_troca_maximo = ciclos_troca_ultimo;
+		}
+	}
+#endif
 }
-void ExecutaMarcaDeTempo(void)
+/* retorna 1 quando a tarefa atual deve ceder o processador (fim da fatia de tempo) */
+uint8_t ExecutaMarcaDeTempo(void)
 {
 	
-	uint8_t tarefa = 0;
+	uint8_t troca = 0;
 		
-	++contador_marcas; /* incrementa contador de marcas de tempo */
+	if(++contador_marcas == 0) /* incrementa contador de marcas de tempo */
+	{
+		marcas_alto++;
+	}
+	RASTRO(RASTRO_EV_MARCA, tarefa_atual, contador_marcas);
 	
-	/* laco para decrementar tempo de espera das tarefas 
-	 * e coloca-las na fila de prontas para executar  */	
-	for (tarefa=numero_tarefas;tarefa > 0;tarefa--)
-	{ 
-	  
-		if(TCB[tarefa].tempo_espera > 0 ) /* se esta esperando algum tempo */
-		{	
-			TCB[tarefa].tempo_espera--; /* decrementa tempo de espera */
-			
-			if(TCB[tarefa].tempo_espera == 0 )
-			{
-				/* coloca a tarefa na fila de prontas para executar */	
-				TCB[tarefa].estado = PRONTA;	        				
-			}
+	/* so a primeira da fila de tempo e decrementada */
+	if(fila_tempo != 0)
+	{
+		TCB[fila_tempo].tempo_espera--;
+		fila_tempo_desperta();
+	}
+	
+#if cfg_FATIA_TEMPO > 0
+	/* rodizio: so gasta a fatia se ha outra pronta na mesma prioridade */
+	uint8_t tarefa = tarefa_atual;
+	if(TCB[tarefa].estado == PRONTA && TCB[tarefa].proxima != tarefa)
+	{
+		if(--fatia_restante == 0)
+		{
+			/* a tarefa atual vai para o fim da fila */
+			Prioridades[TCB[tarefa].prioridade] = TCB[tarefa].proxima;
+			fatia_restante = cfg_FATIA_TEMPO;
+			troca = 1;
 		}
-	 }
+	}
+#endif
+	
+	return troca;
+}
+
+/* Servicos para o modo sem marcas de tempo (ver tarefa_ociosa) */
+
+/* marcas ate a primeira tarefa da fila de tempo despertar */
+tick_t MarcasAteDespertar(void)
+{
+	if(fila_tempo == 0)
+	{
+		return MARCAS_INFINITAS;
+	}
+	return TCB[fila_tempo].tempo_espera;
+}
+
+/* conta 'marcas' que passaram sem interrupcao do temporizador, como se
+   ExecutaMarcaDeTempo tivesse sido chamada a cada uma: as tarefas despertam
+   na mesma marca em que despertariam com o temporizador ligado */
+void CompensaMarcasDeTempo(tick_t marcas)
+{
+	tick_t anterior = contador_marcas;
+	
+	contador_marcas = anterior + marcas;
+	if(contador_marcas < anterior)
+	{
+		marcas_alto++;
+	}
+	
+	while(marcas > 0 && fila_tempo != 0)
+	{
+		if(TCB[fila_tempo].tempo_espera > marcas)
+		{
+			TCB[fila_tempo].tempo_espera -= marcas;
+			break;
+		}
+		marcas -= TCB[fila_tempo].tempo_espera;
+		TCB[fila_tempo].tempo_espera = 0;
+		fila_tempo_desperta();
+	}
 }
 
 /* Servicos de semaforos */
 void SemaforoAguarda(semaforo_t* sem)
 {
+	(void)SemaforoAguardaTempo(sem, MARCAS_INFINITAS);
+}
+
+/* espera o semaforo por ate 'marcas' marcas de tempo (0: nao espera,
+   MARCAS_INFINITAS: sem limite). Retorna 1 se recebeu o semaforo */
+uint8_t SemaforoAguardaTempo(semaforo_t* sem, tick_t marcas)
+{
+	uint8_t recebeu = 1;
 	
 	REG_ATOMICA_INICIO();
+	RASTRO(RASTRO_EV_SEM_AGUARDA, tarefa_atual, (uintptr_t)sem);
 	
 	if(sem->contador > 0)
 	{
 		sem->contador--;
+	}else if(marcas == 0)
+	{
+		recebeu = 0;
 	}else
 	{
-		TCB[tarefa_atual].estado = ESPERA;		/* tarefa colocada na fila de espera */
-		sem->tarefaEsperando = tarefa_atual;   	/* tarefa colocada na espera do semaforo */
-		TROCA_CONTEXTO();						/* solicita troca de contexto */
+		fila_espera_bloqueia(&sem->espera, marcas);	/* tarefa colocada na fila de espera do semaforo */
+		TROCA_CONTEXTO();							/* solicita troca de contexto, so retorna quando ficar pronta novamente */
+		recebeu = !TCB[tarefa_atual].tempo_esgotado;
 	}
 	
 	REG_ATOMICA_FIM();
+	return recebeu;
 }
 
 
 void SemaforoLibera(semaforo_t* sem)
 {
 	REG_ATOMICA_INICIO();
+	RASTRO(RASTRO_EV_SEM_LIBERA, tarefa_atual, (uintptr_t)sem);
 	
-	if(sem->tarefaEsperando > 0)
-	{	/* tem alguma tarefa aguardando ? */
-		TCB[sem->tarefaEsperando].estado = PRONTA;		/* tarefa colocada na fila de pronta */
-		sem->tarefaEsperando = 0;				/* tarefa retirada da espera do semaforo */
-	}else
+	/* tem alguma tarefa aguardando ? a de maior prioridade recebe o semaforo */
+	if(fila_espera_acorda(&sem->espera) == 0)
 	{
 		sem->contador++;
 	}
-	TROCA_CONTEXTO();
+	if(preempcao_necessaria())
+	{
+		TROCA_CONTEXTO();			/* a tarefa acordada passou a atual */
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+/* versao para rotinas de interrupcao: so pede a troca de contexto quando a
+   tarefa acordada tem prioridade maior que a interrompida */
+void SemaforoLiberaISR(semaforo_t* sem)
+{
+	REG_ATOMICA_INICIO();
+	RASTRO(RASTRO_EV_SEM_LIBERA, 0, (uintptr_t)sem);
+	
+	if(fila_espera_acorda(&sem->espera) == 0)
+	{
+		sem->contador++;
+	}
+	if(preempcao_necessaria())
+	{
+		SOLICITA_TROCA_CONTEXTO_ISR();
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+
+/* Servicos de mutex */
+
+/* muda a prioridade efetiva da tarefa, mantendo-a na posicao certa da
+   fila de prontas ou da fila de espera em que estiver */
+static void muda_prioridade(uint8_t tarefa, prioridade_t prioridade)
+{
+	fila_espera_t *fila = TCB[tarefa].fila;
+	
+	if(TCB[tarefa].estado == PRONTA)
+	{
+		tarefa_bloqueada(tarefa);
+		TCB[tarefa].prioridade = prioridade;
+		tarefa_pronta(tarefa);
+	}else if(fila != 0)
+	{
+		fila_espera_retira(tarefa);
+		TCB[tarefa].prioridade = prioridade;
+		fila_espera_insere(fila, tarefa);
+	}else
+	{
+		TCB[tarefa].prioridade = prioridade;
+	}
+}
+
+/* heranca transitiva: o dono do mutex sobe para 'prioridade' e, se ele
+   tambem esta bloqueado em um mutex, o dono deste sobe tambem, ate o fim
+   da cadeia */
+static void herda_prioridade(mutex_t* mtx, prioridade_t prioridade)
+{
+	uint8_t dono = mtx->dono;
+	
+	while(dono != 0 && TCB[dono].prioridade < prioridade)
+	{
+		muda_prioridade(dono, prioridade);
+		
+		mtx = TCB[dono].mutex_esperado;
+		if(mtx == 0 || TCB[dono].fila != &mtx->espera)
+		{
+			break;
+		}
+		dono = mtx->dono;
+	}
+}
+
+static void mutex_entrega(mutex_t* mtx, uint8_t tarefa)
+{
+	mtx->dono = tarefa;
+	mtx->contagem = 1;
+	mtx->proximo = TCB[tarefa].mutexes;
+	TCB[tarefa].mutexes = mtx;
+}
+
+void MutexAguarda(mutex_t* mtx)
+{
+	REG_ATOMICA_INICIO();
+	
+	if(mtx->dono == tarefa_atual)
+	{
+		mtx->contagem++;		/* travamento recursivo */
+	}
+	
+	while(mtx->dono != tarefa_atual)
+	{
+		if(mtx->dono == 0)
+		{
+			mutex_entrega(mtx, tarefa_atual);
+		}else
+		{
+			/* o dono herda a prioridade de quem espera */
+			TCB[tarefa_atual].mutex_esperado = mtx;
+			fila_espera_bloqueia(&mtx->espera, MARCAS_INFINITAS);
+			herda_prioridade(mtx, TCB[tarefa_atual].prioridade);
+			TROCA_CONTEXTO();	/* so retorna quando ficar pronta novamente */
+			
+			/* recebeu o mutex de MutexLibera, ou foi retirada da fila
+			   (TarefaContinua) e tenta de novo */
+			REG_ATOMICA_INICIO();
+			TCB[tarefa_atual].mutex_esperado = 0;
+		}
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+void MutexLibera(mutex_t* mtx)
+{
+	mutex_t **m;
+	prioridade_t prioridade;
+	uint8_t tarefa;
+	
+	REG_ATOMICA_INICIO();
+	
+	if(mtx->dono == tarefa_atual && --mtx->contagem == 0)
+	{
+		/* retira o mutex da lista do dono */
+		for(m = &TCB[tarefa_atual].mutexes; *m != mtx; m = &(*m)->proximo)
+		{
+		}
+		*m = mtx->proximo;
+		
+		/* volta a prioridade base, ou a herdada de outro mutex que ainda tem */
+		prioridade = TCB[tarefa_atual].prioridade_base;
+		for(m = &TCB[tarefa_atual].mutexes; *m != 0; m = &(*m)->proximo)
+		{
+			tarefa = (*m)->espera.primeira;
+			if(tarefa != 0 && TCB[tarefa].prioridade > prioridade)
+			{
+				prioridade = TCB[tarefa].prioridade;
+			}
+		}
+		if(prioridade != TCB[tarefa_atual].prioridade)
+		{
+			muda_prioridade(tarefa_atual, prioridade);
+		}
+		
+		/* a primeira da fila (a de maior prioridade) recebe o mutex */
+		mtx->dono = 0;
+		tarefa = fila_espera_acorda(&mtx->espera);
+		if(tarefa != 0)
+		{
+			mutex_entrega(mtx, tarefa);
+		}
+		
+		if(preempcao_necessaria())
+		{
+			TROCA_CONTEXTO();
+		}
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+
+/* Servicos de filas de mensagens */
+
+/* a fila usa 'quantidade' mensagens de 'tamanho' bytes em 'memoria' */
+void FilaInicia(fila_mensagens_t* fila, void* memoria, uint16_t tamanho, uint8_t quantidade)
+{
+	fila->memoria = (uint8_t *)memoria;
+	fila->tamanho = tamanho;
+	fila->quantidade = quantidade;
+	fila->cabeca = 0;
+	fila->prontas = 0;
+	fila->reservadas = 0;
+	fila->espera_envio.primeira = 0;
+	fila->espera_recebe.primeira = 0;
+}
+
+/* endereco da posicao 'indice' contada a partir do inicio da memoria,
+   com 'indice' menor que duas vezes a quantidade */
+static inline uint8_t *fila_posicao(fila_mensagens_t* fila, uint16_t indice)
+{
+	if(indice >= fila->quantidade)
+	{
+		indice -= fila->quantidade;
+	}
+	return &fila->memoria[indice * fila->tamanho];
+}
+
+/* reserva a proxima posicao livre, esperando por ate 'marcas' (0: nao espera);
+   retorna a posicao, onde a mensagem e escrita diretamente, ou 0 se o tempo
+   acabou. As posicoes sao confirmadas (FilaConfirma) na ordem da reserva */
+void* FilaReserva(fila_mensagens_t* fila, tick_t marcas)
+{
+	tick_t inicio = contador_marcas;
+	uint8_t *posicao = 0;
+	
+	REG_ATOMICA_INICIO();
+	
+	while(fila->prontas + fila->reservadas == fila->quantidade)
+	{
+		if(!fila_espera_ate(&fila->espera_envio, inicio, marcas))
+		{
+			REG_ATOMICA_FIM();
+			return 0;
+		}
+	}
+	posicao = fila_posicao(fila, (uint16_t)fila->cabeca + fila->prontas + fila->reservadas);
+	fila->reservadas++;
+	
+	REG_ATOMICA_FIM();
+	return posicao;
+}
+
+/* a primeira posicao reservada passa a ser uma mensagem pronta */
+static uint8_t fila_confirma(fila_mensagens_t* fila)
+{
+	fila->reservadas--;
+	fila->prontas++;
+	(void)fila_espera_acorda(&fila->espera_recebe);
+	return preempcao_necessaria();
+}
+
+void FilaConfirma(fila_mensagens_t* fila)
+{
+	REG_ATOMICA_INICIO();
+	
+	if(fila->reservadas > 0 && fila_confirma(fila))
+	{
+		TROCA_CONTEXTO();
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+/* envio com copia: reserva, copia e confirma. Retorna 0 se o tempo acabou */
+uint8_t FilaEnvia(fila_mensagens_t* fila, const void* mensagem, tick_t marcas)
+{
+	void *posicao = FilaReserva(fila, marcas);
+	
+	if(posicao == 0)
+	{
+		return 0;
+	}
+	memcpy(posicao, mensagem, fila->tamanho);
+	FilaConfirma(fila);
+	return 1;
+}
+
+/* versao para rotinas de interrupcao: nao espera; retorna 0 se a fila esta
+   cheia ou se uma tarefa tem posicao reservada ainda nao confirmada (a
+   mensagem passaria a frente da reservada, que ainda esta sendo escrita) */
+uint8_t FilaEnviaISR(fila_mensagens_t* fila, const void* mensagem)
+{
+	uint8_t enviou = 0;
+	
+	REG_ATOMICA_INICIO();
+	
+	if(fila->reservadas == 0 && fila->prontas < fila->quantidade)
+	{
+		memcpy(fila_posicao(fila, (uint16_t)fila->cabeca + fila->prontas), mensagem, fila->tamanho);
+		fila->reservadas = 1;
+		if(fila_confirma(fila))
+		{
+			SOLICITA_TROCA_CONTEXTO_ISR();
+		}
+		enviou = 1;
+	}
+	
+	REG_ATOMICA_FIM();
+	return enviou;
+}
+
+/* recebe ate 'maximo' mensagens de uma vez, esperando por ate 'marcas' pela
+   primeira; retorna quantas foram copiadas para 'mensagens' (0: tempo acabou) */
+uint8_t FilaRecebeVarias(fila_mensagens_t* fila, void* mensagens, uint8_t maximo, tick_t marcas)
+{
+	tick_t inicio = contador_marcas;
+	uint8_t *destino = (uint8_t *)mensagens;
+	uint8_t recebidas = 0;
+	
+	REG_ATOMICA_INICIO();
+	
+	while(fila->prontas == 0)
+	{
+		if(!fila_espera_ate(&fila->espera_recebe, inicio, marcas))
+		{
+			REG_ATOMICA_FIM();
+			return 0;
+		}
+	}
+	
+	while(recebidas < maximo && fila->prontas > 0)
+	{
+		memcpy(destino, fila_posicao(fila, fila->cabeca), fila->tamanho);
+		destino += fila->tamanho;
+		fila->cabeca = (fila->cabeca + 1 == fila->quantidade) ? 0 : fila->cabeca + 1;
+		fila->prontas--;
+		recebidas++;
+		
+		/* uma posicao livre para quem espera enviar */
+		(void)fila_espera_acorda(&fila->espera_envio);
+	}
+	
+	if(preempcao_necessaria())
+	{
+		TROCA_CONTEXTO();
+	}
+	
+	REG_ATOMICA_FIM();
+	return recebidas;
+}
+
+uint8_t FilaRecebe(fila_mensagens_t* fila, void* mensagem, tick_t marcas)
+{
+	return FilaRecebeVarias(fila, mensagem, 1, marcas);
+}
+
+
+/* Servicos de grupos de eventos */
+
+static inline uint8_t eventos_satisfeitos(uint32_t sinalizados, uint32_t esperados, uint8_t opcoes)
+{
+	if(opcoes & EVENTOS_TODOS)
+	{
+		return (sinalizados & esperados) == esperados;
+	}
+	return (sinalizados & esperados) != 0;
+}
+
+/* espera por qualquer um ou por todos (EVENTOS_TODOS) os 'bits' por ate
+   'marcas' (0: nao espera); com EVENTOS_LIMPA os bits esperados sao limpos
+   ao receber. Retorna os bits sinalizados no momento em que a espera foi
+   satisfeita, ou 0 se o tempo acabou */
+uint32_t EventosAguarda(eventos_t* ev, uint32_t bits, uint8_t opcoes, tick_t marcas)
+{
+	uint32_t recebidos = 0;
+	
+	if(bits == 0)
+	{
+		return 0;
+	}
+	
+	REG_ATOMICA_INICIO();
+	
+	if(eventos_satisfeitos(ev->bits, bits, opcoes))
+	{
+		recebidos = ev->bits;
+		if(opcoes & EVENTOS_LIMPA)
+		{
+			ev->bits &= ~bits;
+		}
+	}else if(marcas != 0)
+	{
+		TCB[tarefa_atual].eventos = bits;
+		TCB[tarefa_atual].opcoes_eventos = opcoes;
+		fila_espera_bloqueia(&ev->espera, marcas);
+		TROCA_CONTEXTO();		/* so retorna quando ficar pronta novamente */
+		REG_ATOMICA_INICIO();
+		
+		/* EventosSinaliza deixa no TCB os bits recebidos */
+		if(!TCB[tarefa_atual].tempo_esgotado)
+		{
+			recebidos = TCB[tarefa_atual].eventos;
+		}
+	}
+	
+	REG_ATOMICA_FIM();
+	return recebidos;
+}
+
+/* sinaliza os bits e acorda, em uma passada pela fila, todas as tarefas
+   satisfeitas; os bits que elas pediram para limpar sao limpos no fim,
+   para que todas as que esperam o mesmo bit o recebam. Retorna 1 se uma
+   tarefa acordada passou a atual */
+static uint8_t eventos_sinaliza(eventos_t* ev, uint32_t bits)
+{
+	uint32_t limpar = 0;
+	uint8_t tarefa = ev->espera.primeira;
+	uint8_t seguinte;
+	
+	ev->bits |= bits;
+	
+	while(tarefa != 0)
+	{
+		seguinte = TCB[tarefa].proxima_espera;
+		if(eventos_satisfeitos(ev->bits, TCB[tarefa].eventos, TCB[tarefa].opcoes_eventos))
+		{
+			if(TCB[tarefa].opcoes_eventos & EVENTOS_LIMPA)
+			{
+				limpar |= TCB[tarefa].eventos;
+			}
+			TCB[tarefa].eventos = ev->bits;
+			fila_espera_desbloqueia(tarefa);
+		}
+		tarefa = seguinte;
+	}
+	
+	ev->bits &= ~limpar;
+	return preempcao_necessaria();
+}
+
+void EventosSinaliza(eventos_t* ev, uint32_t bits)
+{
+	REG_ATOMICA_INICIO();
+	
+	if(eventos_sinaliza(ev, bits))
+	{
+		TROCA_CONTEXTO();
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+/* versao para rotinas de interrupcao */
+void EventosSinalizaISR(eventos_t* ev, uint32_t bits)
+{
+	REG_ATOMICA_INICIO();
+	
+	if(eventos_sinaliza(ev, bits))
+	{
+		SOLICITA_TROCA_CONTEXTO_ISR();
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+void EventosLimpa(eventos_t* ev, uint32_t bits)
+{
+	REG_ATOMICA_INICIO();
+	ev->bits &= ~bits;
+	REG_ATOMICA_FIM();
+}
+
+
+/* Servicos de pools de blocos de tamanho fixo */
+
+/* divide 'memoria' (declarada com POOL_AREA) em 'quantidade' blocos de
+   'tamanho' bytes e encadeia todos na lista de livres */
+void PoolCria(pool_t* pool, void* memoria, uint16_t tamanho, uint8_t quantidade)
+{
+	uint8_t i;
+	uint8_t *bloco;
+	
+	pool->tamanho = (uint16_t)(POOL_PALAVRAS(tamanho) * sizeof(void *));
+	pool->memoria = (uint8_t *)memoria;
+	pool->quantidade = quantidade;
+	pool->livres = quantidade;
+	pool->minimo_livres = quantidade;
+	pool->falhas = 0;
+	pool->espera.primeira = 0;
+	pool->livre = 0;
+	
+	/* do ultimo para o primeiro, para que os blocos saiam em ordem */
+	for(i = quantidade; i > 0; i--)
+	{
+		bloco = &pool->memoria[(uint16_t)(i - 1) * pool->tamanho];
+		*(void **)bloco = pool->livre;
+		pool->livre = bloco;
+	}
+}
+
+/* retira o primeiro bloco da lista de livres, em tempo constante; 0 se vazia */
+static void *pool_retira(pool_t* pool)
+{
+	void *bloco = pool->livre;
+	
+	if(bloco != 0)
+	{
+		pool->livre = *(void **)bloco;
+		pool->livres--;
+		if(pool->livres < pool->minimo_livres)
+		{
+			pool->minimo_livres = pool->livres;
+		}
+	}else
+	{
+		pool->falhas++;
+	}
+	return bloco;
+}
+
+/* devolve o bloco a lista de livres e acorda a primeira tarefa que espera */
+static uint8_t pool_devolve(pool_t* pool, void* bloco)
+{
+	*(void **)bloco = pool->livre;
+	pool->livre = bloco;
+	pool->livres++;
+	(void)fila_espera_acorda(&pool->espera);
+	return preempcao_necessaria();
+}
+
+/* aloca um bloco, esperando por ate 'marcas' (0: nao espera) que outra
+   tarefa libere um; retorna o bloco ou 0 se o tempo acabou */
+void* PoolAloca(pool_t* pool, tick_t marcas)
+{
+	tick_t inicio = contador_marcas;
+	void *bloco;
+	
+	REG_ATOMICA_INICIO();
+	
+	while((bloco = pool_retira(pool)) == 0)
+	{
+		if(!fila_espera_ate(&pool->espera, inicio, marcas))
+		{
+			break;
+		}
+	}
+	
+	REG_ATOMICA_FIM();
+	return bloco;
+}
+
+/* versao para rotinas de interrupcao: nao espera */
+void* PoolAlocaISR(pool_t* pool)
+{
+	void *bloco;
+	
+	REG_ATOMICA_INICIO();
+	bloco = pool_retira(pool);
+	REG_ATOMICA_FIM();
+	return bloco;
+}
+
+void PoolLibera(pool_t* pool, void* bloco)
+{
+	REG_ATOMICA_INICIO();
+	
+	if(pool_devolve(pool, bloco))
+	{
+		TROCA_CONTEXTO();
+	}
+	
+	REG_ATOMICA_FIM();
+}
+
+/* versao para rotinas de interrupcao */
+void PoolLiberaISR(pool_t* pool, void* bloco)
+{
+	REG_ATOMICA_INICIO();
+	
+	if(pool_devolve(pool, bloco))
+	{
+		SOLICITA_TROCA_CONTEXTO_ISR();
+	}
 	
 	REG_ATOMICA_FIM();
 }
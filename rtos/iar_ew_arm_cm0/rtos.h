@@ -14,10 +14,64 @@
 /* macros de configuracao */
 
 /* numero de tarefas */
+#ifndef NUMERO_DE_TAREFAS
 #define NUMERO_DE_TAREFAS	3
+#endif
 
-/* nmero de prioridades/tarefas */
+/* nmero de prioridades/tarefas (no maximo 31, um bit de mapa_prontas cada) */
+#ifndef PRIORIDADE_MAXIMA
 #define PRIORIDADE_MAXIMA   4
+#endif
+
+/* fatia de tempo (em marcas) para o rodizio entre tarefas de mesma prioridade; 0 desliga */
+#define cfg_FATIA_TEMPO  0
+
+/* 1 para a tarefa ociosa dormir sem marcas de tempo ate a proxima tarefa
+   despertar (economia de energia); so dorme se faltarem pelo menos
+   cfg_MARCAS_MINIMAS_SONO marcas */
+#define cfg_MARCA_TEMPO_LIVRE     0
+#define cfg_MARCAS_MINIMAS_SONO   2
+
+/* 1 para medir os ciclos gastos na troca de contexto (ver TrocaContextoDasTarefas) */
+#define cfg_MEDE_TROCA_CONTEXTO  0
+
+/* 1 para pintar as pilhas em CriaTarefa (uso maximo com TarefaPilhaUsada e
+   RelatorioPilhas) e conferir a guarda no fim de cada pilha a cada troca */
+#ifndef cfg_VERIFICA_PILHA
+#define cfg_VERIFICA_PILHA  1
+#endif
+
+/* padrao das pilhas pintadas; a primeira palavra (fim da pilha) e a guarda */
+#define PADRAO_PILHA	0xA5A5A5A5UL
+
+/* acao quando a guarda de uma pilha foi sobrescrita: trava no PendSV,
+   sem trocar mais de tarefa, para o depurador mostrar 'tarefa' */
+#ifndef ESTOURO_DE_PILHA
+#define ESTOURO_DE_PILHA(tarefa)	for(;;){}
+#endif
+
+/* 1 para acumular o tempo de processador de cada tarefa, o numero de vezes
+   que recebeu o processador e a maior execucao sem ceder (EstatisticasTarefas,
+   CargaCPU); usa o contador livre da porta (LE_CONTADOR_LIVRE) */
+#ifndef cfg_CONTA_TEMPO_CPU
+#define cfg_CONTA_TEMPO_CPU  1
+#endif
+
+/* 1 para registrar os eventos do kernel (trocas de contexto, tarefas
+   prontas/bloqueadas, semaforos, marcas de tempo e interrupcoes) no anel
+   binario 'rastro', lido no PC com ferramentas/rastro_json.c. O anel tem
+   cfg_RASTRO_REGISTROS registros de 8 bytes (potencia de 2) */
+#ifndef cfg_RASTRO
+#define cfg_RASTRO  0
+#endif
+#ifndef cfg_RASTRO_REGISTROS
+#define cfg_RASTRO_REGISTROS  256
+#endif
+
+/* 1 para contar as trocas de contexto pedidas, necessarias e realizadas */
+#ifndef cfg_CONTA_TROCAS
+#define cfg_CONTA_TROCAS  0
+#endif
 
 /* frequencia de clock da CPU */
 #define cfg_CPU_CLOCK_HZ 	48000000
@@ -28,7 +82,28 @@
 typedef  void (*tarefa_t)(void);
 typedef enum {PRONTA, ESPERA} estado_tarefa_t;
 typedef uint8_t	  prioridade_t;
-typedef uint16_t  tick_t;
+typedef uint32_t  tick_t;		/* intervalos em marcas; o instante absoluto tem 64 bits (MarcasDeTempo) */
+
+/* nenhuma tarefa esperando tempo */
+#define MARCAS_INFINITAS	((tick_t)0xFFFFFFFFUL)
+
+/* marca de tempo pendente (SysTick recarregou e a interrupcao nao foi
+   tratada), para InstanteEmCiclos; a porta que nao sabe responde 0 */
+#ifndef MARCA_PENDENTE
+#define MARCA_PENDENTE()	0
+#endif
+
+/**
+* \struct fila_espera_t
+* Fila de tarefas bloqueadas em um objeto (semaforo), em ordem de prioridade
+*/
+
+typedef struct
+{
+	uint8_t		primeira;		///< Tarefa de maior prioridade esperando (0 = nenhuma)
+} fila_espera_t;
+
+typedef struct mutex_s mutex_t;
 
 /**
 * \struct tcb_t
@@ -40,8 +115,30 @@ typedef struct
 	const char		*nome;
 	stackptr_t 	stack_pointer;
 	estado_tarefa_t estado;
-	prioridade_t 	prioridade;
-	uint16_t		tempo_espera;
+	prioridade_t 	prioridade;		/* prioridade efetiva (base ou herdada) */
+	prioridade_t	prioridade_base;
+	tick_t			tempo_espera;	/* marcas a mais que a anterior na fila de tempo */
+	uint8_t			proxima;		/* lista circular de prontas da mesma prioridade */
+	uint8_t			anterior;
+	uint8_t			proxima_tempo;	/* fila de tempo, em ordem de despertar */
+	uint8_t			anterior_tempo;
+	fila_espera_t	*fila;			/* fila de espera em que esta bloqueada (ou 0) */
+	uint8_t			proxima_espera;	/* fila de espera, em ordem de prioridade */
+	uint8_t			anterior_espera;
+	uint8_t			tempo_esgotado;	/* 1: saiu da fila de espera sem receber o objeto */
+	mutex_t			*mutexes;		/* mutexes que a tarefa tem */
+	mutex_t			*mutex_esperado;	/* mutex em cuja fila esta bloqueada (ou 0) */
+	uint32_t		eventos;		/* bits esperados; ao acordar, os bits recebidos */
+	uint8_t			opcoes_eventos;	/* EVENTOS_TODOS, EVENTOS_LIMPA */
+#if cfg_VERIFICA_PILHA
+	stackptr_t		pilha;			/* inicio (fim da pilha, endereco mais baixo) */
+	uint16_t		tamanho_pilha;	/* em palavras */
+#endif
+#if cfg_CONTA_TEMPO_CPU
+	uint64_t		ciclos;			/* tempo de processador acumulado */
+	uint32_t		execucoes;		/* vezes que recebeu o processador */
+	uint32_t		maior_execucao;	/* mais longa execucao sem ceder, em ciclos */
+#endif
 }tcb_t;
 
 extern  uint8_t		tarefa_atual;
@@ -49,6 +146,18 @@ extern  uint8_t		proxima_tarefa;
 extern  tcb_t		TCB[NUMERO_DE_TAREFAS+1];
 extern  stackptr_t	ponteiro_de_pilha;
 extern  prioridade_t Prioridades[PRIORIDADE_MAXIMA+1];
+extern  uint32_t	mapa_prontas;
+
+#if cfg_CONTA_TROCAS
+extern  uint32_t	trocas_pedidas;			/* pontos em que uma tarefa ficou pronta */
+extern  uint32_t	trocas_necessarias;		/* ... e passou a tarefa atual */
+extern  uint32_t	trocas_realizadas;		/* PendSV que mudaram de tarefa */
+#endif
+
+#if cfg_MEDE_TROCA_CONTEXTO
+extern  uint32_t	ciclos_troca_ultimo;
+extern  uint32_t	ciclos_troca_maximo;
+#endif
 
 /**
 * \struct semaforo_t
@@ -58,24 +167,214 @@ extern  prioridade_t Prioridades[PRIORIDADE_MAXIMA+1];
 typedef struct 
 {
 	uint8_t     contador;            ///< Contador do semaforo
-	uint8_t 	tarefaEsperando;        ///< Tarefa esperando
+	fila_espera_t	espera;          ///< Tarefas esperando
 } semaforo_t;
 
+/**
+* \struct mutex_t
+* Estrutura de controle do mutex (exclusao mutua com heranca de prioridade)
+*/
+
+struct mutex_s
+{
+	uint8_t			dono;			///< Tarefa que tem o mutex (0 = livre)
+	uint8_t			contagem;		///< Travamentos recursivos do dono
+	fila_espera_t	espera;			///< Tarefas esperando
+	mutex_t			*proximo;		///< Proximo mutex do mesmo dono
+};
+
+/**
+* \struct fila_mensagens_t
+* Fila de mensagens de tamanho fixo, guardadas em uma area estatica
+* (quantidade * tamanho bytes) fornecida em FilaInicia
+*/
+
+typedef struct
+{
+	uint8_t			*memoria;		///< Area das mensagens
+	uint16_t		tamanho;		///< Bytes por mensagem
+	uint8_t			quantidade;		///< Numero de posicoes
+	uint8_t			cabeca;			///< Posicao da proxima mensagem a receber
+	uint8_t			prontas;		///< Mensagens confirmadas esperando leitura
+	uint8_t			reservadas;		///< Posicoes reservadas ainda nao confirmadas
+	fila_espera_t	espera_envio;	///< Tarefas esperando posicao livre
+	fila_espera_t	espera_recebe;	///< Tarefas esperando mensagem
+} fila_mensagens_t;
+
+/**
+* \struct eventos_t
+* Grupo de 32 bits de eventos
+*/
+
+typedef struct
+{
+	uint32_t		bits;			///< Eventos sinalizados
+	fila_espera_t	espera;			///< Tarefas esperando
+} eventos_t;
+
+/* opcoes de EventosAguarda */
+#define EVENTOS_QUALQUER	0x00	///< Basta um dos bits esperados
+#define EVENTOS_TODOS		0x01	///< Todos os bits esperados
+#define EVENTOS_LIMPA		0x02	///< Limpa os bits esperados ao receber
+
+/**
+* \struct pool_t
+* Conjunto de blocos de tamanho fixo sobre uma area estatica, sem malloc.
+* Os blocos livres formam uma lista encadeada pelo inicio de cada bloco;
+* um bloco pode ser passado entre tarefas por uma fila de mensagens de
+* ponteiros (tamanho sizeof(void*)), sem copiar o conteudo
+*/
+
+typedef struct
+{
+	void			*livre;			///< Primeiro bloco livre (0 = nenhum)
+	uint8_t			*memoria;		///< Area dos blocos
+	uint16_t		tamanho;		///< Bytes por bloco, arredondado para ponteiros
+	uint8_t			quantidade;		///< Numero de blocos
+	uint8_t			livres;			///< Blocos livres agora
+	uint8_t			minimo_livres;	///< Menor numero de livres ja visto (marca d'agua)
+	uint16_t		falhas;			///< Pedidos que nao encontraram bloco livre
+	fila_espera_t	espera;			///< Tarefas esperando bloco livre
+} pool_t;
+
+/* palavras de ponteiro por bloco de 'tamanho' bytes */
+#define POOL_PALAVRAS(tamanho)	(((tamanho) + sizeof(void *) - 1) / sizeof(void *))
+
+/* declara a area estatica de um pool, alinhada para os ponteiros da lista */
+#define POOL_AREA(nome, tamanho, quantidade)	void *nome[(quantidade) * POOL_PALAVRAS(tamanho)]
+
+/**
+* \struct uso_pilha_t
+* Linha do relatorio de uso das pilhas (RelatorioPilhas)
+*/
+
+typedef struct
+{
+	const char		*nome;			///< Nome da tarefa
+	uint16_t		tamanho;		///< Tamanho da pilha em palavras
+	uint16_t		maximo_usado;	///< Maior uso ja visto, em palavras
+} uso_pilha_t;
+
+/**
+* \struct estatistica_tarefa_t
+* Copia do tempo de processador de uma tarefa (EstatisticasTarefas)
+*/
+
+typedef struct
+{
+	const char		*nome;			///< Nome da tarefa
+	prioridade_t	prioridade;		///< Prioridade base
+	uint64_t		ciclos;			///< Tempo de processador acumulado, em ciclos do contador livre
+	uint32_t		execucoes;		///< Vezes que recebeu o processador
+	uint32_t		maior_execucao;	///< Mais longa execucao sem ceder, em ciclos
+} estatistica_tarefa_t;
+
+/* eventos do rastro; 'tarefa' e 'dado' de cada um */
+#define RASTRO_EV_TROCA			1	/* a que entra; a que sai */
+#define RASTRO_EV_PRONTA		2	/* a que ficou pronta; 0 */
+#define RASTRO_EV_BLOQUEIA		3	/* a que saiu das prontas; 0 */
+#define RASTRO_EV_SEM_AGUARDA	4	/* a que pede; 16 bits baixos do endereco do semaforo */
+#define RASTRO_EV_SEM_LIBERA	5	/* a que libera (0 numa interrupcao); idem */
+#define RASTRO_EV_MARCA			6	/* a atual; contador de marcas */
+#define RASTRO_EV_ISR_ENTRA		7	/* a interrompida; numero da excecao */
+#define RASTRO_EV_ISR_SAI		8	/* idem */
+
+/* inicio do anel, para achar o rastro numa copia da memoria */
+#define RASTRO_MARCADOR		0x52545352UL	/* "RSTR" */
+#define RASTRO_TAM_NOME		16
+
+/**
+* \struct rastro_registro_t
+* Registro de 8 bytes do rastro
+*/
+
+typedef struct
+{
+	uint32_t		delta;			///< Ciclos do contador livre desde o registro anterior
+	uint8_t			evento;			///< RASTRO_EV_*
+	uint8_t			tarefa;
+	uint16_t		dado;
+} rastro_registro_t;
+
+/**
+* \struct rastro_t
+* Anel do rastro, copiado inteiro (depurador ou serial) para o PC
+*/
+
+typedef struct
+{
+	uint32_t		marcador;		///< RASTRO_MARCADOR
+	uint32_t		frequencia;		///< Hz do contador livre
+	uint32_t		escritos;		///< Total de registros escritos; o mais novo e anel[(escritos - 1) % registros]
+	uint16_t		registros;		///< cfg_RASTRO_REGISTROS
+	uint8_t			tarefas;		///< Linhas de 'nomes' (NUMERO_DE_TAREFAS + 1)
+	uint8_t			tam_nome;		///< RASTRO_TAM_NOME
+	char			nomes[NUMERO_DE_TAREFAS+1][RASTRO_TAM_NOME];
+	rastro_registro_t anel[cfg_RASTRO_REGISTROS];
+} rastro_t;
+
+#if cfg_RASTRO
+extern  rastro_t	rastro;
+void RastroRegistra(uint8_t evento, uint8_t tarefa, uint16_t dado);
+#define RASTRO(evento, tarefa, dado)	RastroRegistra((evento), (tarefa), (uint16_t)(dado))
+#else
+#define RASTRO(evento, tarefa, dado)
+#endif
+
+/* para as rotinas de interrupcao da aplicacao, no inicio e no fim */
+#define RASTRO_ISR_ENTRA(excecao)	RASTRO(RASTRO_EV_ISR_ENTRA, tarefa_atual, excecao)
+#define RASTRO_ISR_SAI(excecao)		RASTRO(RASTRO_EV_ISR_SAI, tarefa_atual, excecao)
+
 
 void tarefa_ociosa(void);
 uint8_t escalonador(void);
 
 void TrocaContextoDasTarefas(void);
 uint32_t * CriaContexto(tarefa_t endereco_tarefa, uint32_t* ptr_pilha);
-void CriaTarefa(tarefa_t p, const char * nome, stackptr_t pilha, uint16_t tamanho, prioridade_t prioridade);
+uint8_t CriaTarefa(tarefa_t p, const char * nome, stackptr_t pilha, uint16_t tamanho, prioridade_t prioridade);
 void IniciaMultitarefas(void);
 void ConfiguraMarcaTempo(void);
-void ExecutaMarcaDeTempo(void);
+uint8_t ExecutaMarcaDeTempo(void);
+tick_t MarcasAteDespertar(void);
+void CompensaMarcasDeTempo(tick_t marcas);
+void DormeSemMarcas(tick_t marcas);
 
 void TarefaSuspende(uint8_t id_tarefa);
 void TarefaContinua(uint8_t id_tarefa);
-void TarefaEspera(tick_t qtas_marcas);		
+void TarefaEspera(tick_t qtas_marcas);
+uint8_t TarefaEsperaAte(uint64_t despertar);
+uint8_t TarefaPeriodica(uint64_t* proxima, tick_t periodo);
+uint64_t MarcasDeTempo(void);
+uint64_t InstanteEmCiclos(void);
+uint16_t TarefaPilhaUsada(uint8_t id_tarefa);
+uint8_t RelatorioPilhas(uso_pilha_t* relatorio, uint8_t maximo);		
+uint8_t EstatisticasTarefas(estatistica_tarefa_t* copia, uint8_t maximo);
+uint16_t CargaCPU(void);
 
 void SemaforoAguarda(semaforo_t* sem);
+uint8_t SemaforoAguardaTempo(semaforo_t* sem, tick_t marcas);
 void SemaforoLibera(semaforo_t* sem);
+void SemaforoLiberaISR(semaforo_t* sem);
+
+void MutexAguarda(mutex_t* mtx);
+void MutexLibera(mutex_t* mtx);
+
+void FilaInicia(fila_mensagens_t* fila, void* memoria, uint16_t tamanho, uint8_t quantidade);
+void* FilaReserva(fila_mensagens_t* fila, tick_t marcas);
+void FilaConfirma(fila_mensagens_t* fila);
+uint8_t FilaEnvia(fila_mensagens_t* fila, const void* mensagem, tick_t marcas);
+uint8_t FilaEnviaISR(fila_mensagens_t* fila, const void* mensagem);
+uint8_t FilaRecebe(fila_mensagens_t* fila, void* mensagem, tick_t marcas);
+uint8_t FilaRecebeVarias(fila_mensagens_t* fila, void* mensagens, uint8_t maximo, tick_t marcas);
+
+uint32_t EventosAguarda(eventos_t* ev, uint32_t bits, uint8_t opcoes, tick_t marcas);
+void EventosSinaliza(eventos_t* ev, uint32_t bits);
+void EventosSinalizaISR(eventos_t* ev, uint32_t bits);
+void EventosLimpa(eventos_t* ev, uint32_t bits);
+
+void PoolCria(pool_t* pool, void* memoria, uint16_t tamanho, uint8_t quantidade);
+void* PoolAloca(pool_t* pool, tick_t marcas);
+void* PoolAlocaISR(pool_t* pool);
+void PoolLibera(pool_t* pool, void* bloco);
+void PoolLiberaISR(pool_t* pool, void* bloco);
 #endif /* MULTITAREFAS_H_ */
\ No newline at end of file
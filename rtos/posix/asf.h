@@ -0,0 +1,22 @@
+/*
+ * asf.h
+ *
+ * Substituto do asf.h do Atmel Software Framework para a porta POSIX:
+ * inclui o cpu-port.h desta pasta antes do rtos.h e simula o pouco do
+ * ASF que as tarefas de exemplo usam (o LED).
+ */
+
+#ifndef ASF_H
+#define ASF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu-port.h"
+
+#define LED_0_PIN		0
+#define LED_0_ACTIVE	false
+
+void system_init(void);
+void port_pin_set_output_level(const uint8_t gpio_pin, const bool level);
+
+#endif /* ASF_H */
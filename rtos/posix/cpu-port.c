@@ -0,0 +1,347 @@
+/*
+ * cpu_port.c
+ *
+ * Porta do sistema multitarefas para Linux (POSIX): o rtos.c do as_sam_d21
+ * roda sem alteracoes como um processo comum.
+ *  - cada tarefa e um ucontext_t com pilha propria (TAM_PILHA_HOSPEDEIRO)
+ *  - o SysTick e um temporizador de intervalo (setitimer) que gera SIGALRM
+ *    a cada marca de tempo
+ *  - CPSID/CPSIE sao uma variavel: uma marca que chega com as interrupcoes
+ *    desabilitadas fica pendente e e tratada em REG_ATOMICA_FIM, como no ARM
+ *  - o PendSV pendente (porta_troca_pendente) executa quando as interrupcoes
+ *    sao habilitadas: chama TrocaContextoDasTarefas() e troca de ucontext_t
+ *
+ * Compilar as tarefas de exemplo (na pasta rtos):
+ *   gcc -O2 -Wall -I posix -I as_sam_d21/src \
+ *       as_sam_d21/src/main.c as_sam_d21/src/rtos.c posix/cpu-port.c -o rtos_posix
+ *   ./rtos_posix      # Ctrl+C mostra marcas, trocas de contexto e mudancas do LED
+ * Com -Dcfg_RASTRO=1, o Ctrl+C tambem grava o anel do rastro em rastro.bin,
+ * para ferramentas/rastro_json.
+ *
+ * A pasta posix vem antes no -I: o <asf.h> dela inclui este cpu-port.h, e
+ * o do ARM, incluido depois pelo rtos.h, fica vazio pelo guarda. O SP do
+ * rtos.c e um sp_t, do tamanho de um ponteiro do PC (uintptr_t), e so o
+ * TCB o usa: esta porta troca de tarefa pelo numero (tarefa_atual), nao
+ * pela pilha.
+ */
+
+#include <asf.h>
+#include "cpu-port.h"
+#include "rtos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ucontext.h>
+#include <sys/time.h>
+
+volatile sig_atomic_t porta_interrupcoes_desabilitadas = 0;
+volatile sig_atomic_t porta_troca_pendente = 0;
+
+static volatile sig_atomic_t marca_pendente = 0;
+static volatile sig_atomic_t iniciado = 0;
+
+static ucontext_t contexto_principal;
+static ucontext_t contextos[NUMERO_DE_TAREFAS+1];
+static tarefa_t funcoes[NUMERO_DE_TAREFAS+1];
+static uint8_t pilhas[NUMERO_DE_TAREFAS+1][TAM_PILHA_HOSPEDEIRO];
+static uint8_t contextos_criados = 0;
+
+/* estatisticas mostradas com Ctrl+C */
+static volatile uint32_t marcas_tratadas = 0;
+static volatile uint32_t trocas_de_contexto = 0;
+static volatile uint32_t mudancas_led = 0;
+static bool nivel_led = false;
+
+static uint64_t agora_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t ultima_marca_ns;
+
+/* toda tarefa comeca aqui, com as interrupcoes habilitadas, como apos o
+   retorno de excecao que a inicia no ARM */
+static void inicio_tarefa(int tarefa)
+{
+	PortaHabilitaInterrupcoes();
+	funcoes[tarefa]();
+
+	/* uma tarefa nao deve retornar */
+	fprintf(stderr, "rtos: tarefa %d retornou\n", tarefa);
+	abort();
+}
+
+/* cria o contexto da tarefa; a ordem de criacao e a mesma dos TCBs */
+stackptr_t CriaContexto(tarefa_t endereco_tarefa, stackptr_t ptr_pilha)
+{
+	uint8_t tarefa = ++contextos_criados;
+
+	if(tarefa > NUMERO_DE_TAREFAS)
+	{
+		fprintf(stderr, "rtos: mais de NUMERO_DE_TAREFAS (%d) tarefas\n", NUMERO_DE_TAREFAS);
+		abort();
+	}
+
+	funcoes[tarefa] = endereco_tarefa;
+	getcontext(&contextos[tarefa]);
+	contextos[tarefa].uc_stack.ss_sp = pilhas[tarefa];
+	contextos[tarefa].uc_stack.ss_size = TAM_PILHA_HOSPEDEIRO;
+	contextos[tarefa].uc_link = 0;
+	makecontext(&contextos[tarefa], (void (*)(void))inicio_tarefa, 1, (int)tarefa);
+
+	return ptr_pilha;
+}
+
+/* PendSV: o kernel escolhe a proxima tarefa e a porta troca de contexto.
+   Retorna quando a tarefa que chamou volta a executar */
+static void pendsv(void)
+{
+	uint8_t anterior = tarefa_atual;
+
+	porta_troca_pendente = 0;
+	TrocaContextoDasTarefas();
+	trocas_de_contexto++;
+
+	if(tarefa_atual != anterior)
+	{
+		swapcontext(&contextos[anterior], &contextos[tarefa_atual]);
+	}
+}
+
+/* corpo do SysTick_Handler do ARM */
+static void trata_marca(void)
+{
+	RASTRO_ISR_ENTRA(EXCECAO_SYSTICK);
+	marca_pendente = 0;
+	marcas_tratadas++;
+	ultima_marca_ns = agora_ns();
+
+	if(ExecutaMarcaDeTempo())
+	{
+		SOLICITA_TROCA_CONTEXTO_ISR();	/* fim da fatia de tempo */
+	}
+	RASTRO_ISR_SAI(EXCECAO_SYSTICK);
+}
+
+/* CPSIE I: executa a marca e o PendSV que ficaram pendentes. O laco
+   repete se uma marca chegar enquanto isso */
+void PortaHabilitaInterrupcoes(void)
+{
+	for(;;)
+	{
+		porta_interrupcoes_desabilitadas = 0;
+		if(!iniciado || (!marca_pendente && !porta_troca_pendente))
+		{
+			return;
+		}
+
+		porta_interrupcoes_desabilitadas = 1;
+		if(marca_pendente)
+		{
+			trata_marca();
+		}
+		if(porta_troca_pendente)
+		{
+			pendsv();
+		}
+	}
+}
+
+/* SIGALRM: interrupcao do SysTick. A troca de contexto pode acontecer
+   dentro do tratador; ele termina quando a tarefa interrompida voltar */
+static void sinal_marca(int sinal)
+{
+	(void)sinal;
+
+	if(!iniciado)
+	{
+		return;
+	}
+	if(porta_interrupcoes_desabilitadas)
+	{
+		marca_pendente = 1;		/* tratada em REG_ATOMICA_FIM */
+		return;
+	}
+
+	porta_interrupcoes_desabilitadas = 1;
+	trata_marca();
+	PortaHabilitaInterrupcoes();
+}
+
+static void sinal_estatisticas(int sinal)
+{
+	char texto[128];
+	int n;
+
+	(void)sinal;
+	n = snprintf(texto, sizeof(texto), "\nmarcas %u, trocas de contexto %u, mudancas do LED %u\n",
+	             marcas_tratadas, trocas_de_contexto, mudancas_led);
+	(void)write(STDOUT_FILENO, texto, (size_t)n);
+#if cfg_RASTRO
+	{
+		int arquivo = open("rastro.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(arquivo >= 0)
+		{
+			(void)write(arquivo, &rastro, sizeof(rastro));
+			close(arquivo);
+		}
+	}
+#endif
+	_exit(0);
+}
+
+static void programa_temporizador(uint64_t primeira_ns, uint64_t periodo_ns)
+{
+	struct itimerval t;
+
+	t.it_value.tv_sec = (time_t)(primeira_ns / 1000000000ULL);
+	t.it_value.tv_usec = (suseconds_t)((primeira_ns % 1000000000ULL) / 1000);
+	t.it_interval.tv_sec = (time_t)(periodo_ns / 1000000000ULL);
+	t.it_interval.tv_usec = (suseconds_t)((periodo_ns % 1000000000ULL) / 1000);
+	if(primeira_ns > 0 && t.it_value.tv_sec == 0 && t.it_value.tv_usec == 0)
+	{
+		t.it_value.tv_usec = 1;		/* zero desligaria o temporizador */
+	}
+	setitimer(ITIMER_REAL, &t, 0);
+}
+
+/* Codigo dependente de hardware usado para
+ * configuracao da marca de tempo do sistema multitarefas */
+void ConfiguraMarcaTempo(void)
+{
+	struct sigaction acao;
+
+	memset(&acao, 0, sizeof(acao));
+	acao.sa_handler = sinal_marca;
+	acao.sa_flags = SA_RESTART;
+	sigemptyset(&acao.sa_mask);
+	sigaction(SIGALRM, &acao, 0);
+
+	acao.sa_handler = sinal_estatisticas;
+	sigaction(SIGINT, &acao, 0);
+	setvbuf(stdout, 0, _IOLBF, 0);	/* printf das tarefas aparece linha a linha */
+
+	ultima_marca_ns = agora_ns();
+	programa_temporizador(PERIODO_CONTADOR_CICLOS(), PERIODO_CONTADOR_CICLOS());
+}
+
+/* SVC: inicia a primeira tarefa. Retorna so depois de PortaEncerra() */
+void PortaIniciaPrimeiraTarefa(void)
+{
+	porta_interrupcoes_desabilitadas = 1;
+	porta_troca_pendente = 0;
+	iniciado = 1;
+	swapcontext(&contexto_principal, &contextos[tarefa_atual]);
+}
+
+/* para o temporizador e volta para quem chamou IniciaMultitarefas() (so no PC) */
+void PortaEncerra(void)
+{
+	programa_temporizador(0, 0);
+	iniciado = 0;
+	porta_interrupcoes_desabilitadas = 0;
+	swapcontext(&contextos[tarefa_atual], &contexto_principal);
+}
+
+uint32_t PortaLeContadorCiclos(void)
+{
+	uint64_t decorrido = agora_ns() - ultima_marca_ns;
+	uint32_t periodo = PERIODO_CONTADOR_CICLOS();
+
+	return periodo - 1 - (uint32_t)(decorrido % periodo);
+}
+
+uint32_t PortaLeContadorLivre(void)
+{
+	return (uint32_t)agora_ns();
+}
+
+int PortaMarcaPendente(void)
+{
+	return marca_pendente;
+}
+
+/* WFI: espera um sinal; chamada com as interrupcoes desabilitadas, a marca
+   que chegar fica pendente */
+void PortaAguardaInterrupcao(void)
+{
+	sigset_t vazia;
+
+	sigemptyset(&vazia);
+	sigsuspend(&vazia);
+}
+
+#if cfg_MARCA_TEMPO_LIVRE
+/* Codigo dependente de hardware usado pela tarefa ociosa no modo sem marcas
+ * de tempo: o temporizador e reprogramado para um unico intervalo que
+ * termina na marca em que a proxima tarefa desperta e o processo dorme.
+ * Chamada com as interrupcoes desabilitadas */
+void DormeSemMarcas(tick_t marcas)
+{
+	uint64_t periodo = PERIODO_CONTADOR_CICLOS();
+	uint64_t decorrido;
+	sigset_t alarme, anterior;
+	tick_t completas;
+
+	/* marca pendente: deixa REG_ATOMICA_FIM trata-la */
+	if(marca_pendente)
+	{
+		return;
+	}
+
+	/* SIGALRM bloqueado entre programar e dormir, para nao perder o despertar */
+	sigemptyset(&alarme);
+	sigaddset(&alarme, SIGALRM);
+	sigprocmask(SIG_BLOCK, &alarme, &anterior);
+
+	decorrido = agora_ns() - ultima_marca_ns;
+	if(decorrido < (uint64_t)marcas * periodo)
+	{
+		programa_temporizador((uint64_t)marcas * periodo - decorrido, 0);
+		PortaAguardaInterrupcao();
+	}else
+	{
+		marca_pendente = 1;
+	}
+	sigprocmask(SIG_SETMASK, &anterior, 0);
+
+	if(marca_pendente)
+	{
+		/* intervalo completo: a marca pendente conta a ultima */
+		completas = marcas - 1;
+		ultima_marca_ns += (uint64_t)marcas * periodo;
+	}else
+	{
+		/* acordou antes por outro sinal: conta so as marcas que ja passaram */
+		completas = (tick_t)((agora_ns() - ultima_marca_ns) / periodo);
+		ultima_marca_ns += (uint64_t)completas * periodo;
+	}
+
+	/* termina a marca atual e volta ao periodo normal */
+	decorrido = agora_ns() - ultima_marca_ns;
+	programa_temporizador(decorrido < periodo ? periodo - decorrido : 1000, periodo);
+
+	CompensaMarcasDeTempo(completas);
+}
+#endif
+
+/* substitutos do ASF para as tarefas de exemplo */
+void system_init(void)
+{
+}
+
+void port_pin_set_output_level(const uint8_t gpio_pin, const bool level)
+{
+	(void)gpio_pin;
+	if(level != nivel_led)
+	{
+		nivel_led = level;
+		mudancas_led++;
+	}
+}
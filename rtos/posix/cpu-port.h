@@ -0,0 +1,75 @@
+/*
+ * cpu_port.h
+ *
+ * Porta do sistema multitarefas para Linux (POSIX), para simulacao e
+ * medidas no PC. Substitui o cpu-port.h do ARM: o mesmo guarda CPU_PORT_H_
+ * faz o do as_sam_d21/src ser ignorado quando este e incluido antes (pelo
+ * asf.h desta pasta). Ver cpu-port.c para a compilacao.
+ */
+
+
+#ifndef CPU_PORT_H_
+#define CPU_PORT_H_
+
+#include "stdint.h"
+#include <signal.h>
+
+/* o TCB guarda o ponteiro de pilha como no ARM, mas a porta nao o usa:
+   cada tarefa roda em um contexto (ucontext_t) com pilha propria */
+#define TAM_MINIMO_PILHA  (16)
+
+/* tipo do ponteiro de pilha */
+typedef uint32_t* stackptr_t;
+
+/* tipo do SP do rtos.c: no PC guarda um ponteiro de 64 bits */
+typedef uintptr_t sp_t;
+
+/* pilha de verdade de cada tarefa no PC (a libc precisa de muito mais que no ARM) */
+#ifndef TAM_PILHA_HOSPEDEIRO
+#define TAM_PILHA_HOSPEDEIRO	(64 * 1024)
+#endif
+
+/* mascara de interrupcoes (PRIMASK) e PendSV simulados */
+extern volatile sig_atomic_t porta_interrupcoes_desabilitadas;
+extern volatile sig_atomic_t porta_troca_pendente;
+
+void PortaHabilitaInterrupcoes(void);
+void PortaIniciaPrimeiraTarefa(void);
+void PortaAguardaInterrupcao(void);
+void PortaEncerra(void);
+uint32_t PortaLeContadorCiclos(void);
+uint32_t PortaLeContadorLivre(void);
+int PortaMarcaPendente(void);
+
+/* macros dependentes de hardware */
+#define REG_ATOMICA_INICIO()  	  porta_interrupcoes_desabilitadas = 1;
+#define REG_ATOMICA_FIM()  		  PortaHabilitaInterrupcoes();
+
+/* regiao atomica que pode estar dentro de outra */
+#define REG_ATOMICA_SALVA(estado)	  estado = porta_interrupcoes_desabilitadas; porta_interrupcoes_desabilitadas = 1;
+#define REG_ATOMICA_RESTAURA(estado)  if(!(estado)) { PortaHabilitaInterrupcoes(); }
+
+/* como no ARM: pede o PendSV e habilita as interrupcoes, o que o executa */
+#define TROCA_CONTEXTO()		porta_troca_pendente = 1; PortaHabilitaInterrupcoes();
+#define TrocaContexto()		    TROCA_CONTEXTO()
+#define SOLICITA_TROCA_CONTEXTO_ISR()	porta_troca_pendente = 1
+
+#define GERA_INTERRUPCAO_SW()	PortaIniciaPrimeiraTarefa();
+
+/* contador de ciclos: nanossegundos que faltam para a proxima marca (decrescente, como o SysTick) */
+#define LE_CONTADOR_CICLOS()	PortaLeContadorCiclos()
+#define PERIODO_CONTADOR_CICLOS()	(1000000000UL / cfg_MARCA_TEMPO_HZ)
+#define MARCA_PENDENTE()			PortaMarcaPendente()
+
+/* contador livre (tempo de processador das tarefas): o relogio monotonico em ns */
+#define LE_CONTADOR_LIVRE()		PortaLeContadorLivre()
+#define FREQUENCIA_CONTADOR_LIVRE	1000000000UL
+
+/* o SIGALRM aparece no rastro com o numero de excecao do SysTick */
+#define EXCECAO_SYSTICK			15
+
+/* dorme ate a proxima interrupcao (sinal) */
+#define AGUARDA_INTERRUPCAO()	PortaAguardaInterrupcao();
+
+
+#endif /* CPU_PORT_H_ */